@@ -19,6 +19,19 @@
 #ICONV_CFLAGS =
 #ICONV_LIBS   = -liconv
 #
+# Do you wish to use libdeflate to compress PDF content streams and
+# bitmaps, and to decompress PDF streams?  It is much faster than
+# zlib, and supports compression levels up to 12.  If so, uncomment
+# the following lines (ipebench measures the difference):
+#
+#IPE_USE_LIBDEFLATE = -DIPE_USE_LIBDEFLATE
+#LIBDEFLATE_CFLAGS  =
+#LIBDEFLATE_LIBS    = -ldeflate
+#
+# Other streams are compressed and decompressed by zlib.  To use
+# zlib-ng instead, build it in zlib compatible mode, and set
+# ZLIB_CFLAGS and ZLIB_LIBS below accordingly.
+#
 # ------------------------------------------------------------------
 # Include and linking options for libraries
 # ------------------------------------------------------------------
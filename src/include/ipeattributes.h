@@ -235,8 +235,15 @@ namespace ipe {
     // int getIndex(String str) const;
   private:
     Repository();
+    int add(String str);
+    int find(String str, uint hash) const;
+    void rehash(int size);
+    static uint hashString(String str);
     static Repository *singleton;
     std::vector<String> iStrings;
+    //! Open hash table of indices into iStrings (-1 for empty slots).
+    std::vector<int> iTable;
+    mutable ReadWriteLock iLock;
   };
 
   // --------------------------------------------------------------------
@@ -125,6 +125,7 @@ namespace ipe {
     int find(const char *rhs) const;
     void erase();
     void append(const String &rhs);
+    void append(const char *data, int len);
     void append(char ch);
     bool operator==(const String &rhs) const;
     bool operator<(const String &rhs) const;
@@ -168,12 +169,27 @@ namespace ipe {
 
   class Lex {
   public:
+    //! A token, referring to the characters inside the Lex's string.
+    /*! The token remains valid as long as the Lex exists. */
+    struct Token {
+      //! First character of the token (not zero-terminated).
+      const char *iData;
+      //! Number of characters in the token.
+      int iSize;
+      //! Does the token consist exactly of the characters of \a s?
+      inline bool operator==(const char *s) const {
+	return (int(strlen(s)) == iSize && memcmp(iData, s, iSize) == 0); }
+    };
+
     explicit Lex(String str);
 
     String token();
     String nextToken();
+    Token tokenView();
+    Token nextTokenView();
     int getInt();
     int getHexByte();
+    void getHexBytes(char *out, int length);
     Fixed getFixed();
     unsigned long int getHexNumber();
     double getDouble();
@@ -204,6 +220,11 @@ namespace ipe {
     inline bool eos() const {
       return (iPos == iString.size()); }
 
+    static const char *parseInt(const char *p, const char *fin, int &val);
+    static const char *parseFixed(const char *p, const char *fin, Fixed &val);
+    static const char *parseDouble(const char *p, const char *fin,
+				   double &val);
+
   private:
     String iString;
     int iPos;
@@ -233,6 +254,9 @@ namespace ipe {
     //! Return pointer to buffer data (const version).
     inline const char *data() const { return iImp->iData; }
 
+    static unsigned long long hash64(const char *data, int size,
+				     unsigned long long seed = 0);
+
   private:
     struct Imp {
       int iRefCount;
@@ -268,6 +292,9 @@ namespace ipe {
     Stream &operator<<(double d);
     void putHexByte(char b);
     void putXmlString(String s);
+
+    static int formatInt(char *buf, int i);
+    static int formatDouble(char *buf, double d);
   };
 
   /*! \class ipe::TellStream
@@ -304,6 +331,23 @@ namespace ipe {
     std::FILE *iFile;
   };
 
+  class BufferedStream : public TellStream {
+  public:
+    explicit BufferedStream(TellStream &stream, int size = 0x10000);
+    virtual ~BufferedStream();
+    virtual void putChar(char ch);
+    virtual void putString(String s);
+    virtual void putCString(const char *s);
+    virtual void putRaw(const char *data, int size);
+    virtual long tell() const;
+    virtual void close();
+    void flush();
+  private:
+    TellStream &iStream;
+    Buffer iBuffer;
+    int iN;
+  };
+
   // --------------------------------------------------------------------
 
   class DataSource {
@@ -311,12 +355,14 @@ namespace ipe {
     virtual ~DataSource() = 0;
     //! Get one more character, or EOF.
     virtual int getChar() = 0;
+    virtual int getBlock(const char *&data, char *buffer, int size);
   };
 
   class FileSource : public DataSource {
   public:
     FileSource(std::FILE *file);
     virtual int getChar();
+    virtual int getBlock(const char *&data, char *buffer, int size);
   private:
     std::FILE *iFile;
   };
@@ -325,11 +371,83 @@ namespace ipe {
   public:
     BufferSource(const Buffer &buffer);
     virtual int getChar();
+    virtual int getBlock(const char *&data, char *buffer, int size);
   private:
     const Buffer &iBuffer;
     int iPos;
   };
 
+  class MappedFileSource : public DataSource {
+  public:
+    explicit MappedFileSource(const char *fname);
+    virtual ~MappedFileSource();
+    virtual int getChar();
+    virtual int getBlock(const char *&data, char *buffer, int size);
+    //! Has the file been opened successfully?
+    inline bool isOpen() const { return iData != 0; }
+    //! Is the file mapped into memory (rather than read)?
+    inline bool isMapped() const { return iMapped; }
+    //! Return pointer to the entire file contents.
+    inline const char *data() const { return iData; }
+    //! Return size of the file.
+    inline int size() const { return iSize; }
+    //! Return current reading position.
+    inline int position() const { return iPos; }
+    //! Set reading position.
+    inline void setPosition(int pos) { iPos = pos; }
+  private:
+    // disable copying
+    MappedFileSource(const MappedFileSource &rhs);
+    MappedFileSource &operator=(const MappedFileSource &rhs);
+  private:
+    const char *iData;
+    int iSize;
+    int iPos;
+    void *iHandle;
+    bool iMapped;
+  };
+
+  // --------------------------------------------------------------------
+
+  class ReadWriteLock {
+  public:
+    ReadWriteLock();
+    ~ReadWriteLock();
+    void lockRead();
+    void unlockRead();
+    void lockWrite();
+    void unlockWrite();
+  private:
+    // disable copying
+    ReadWriteLock(const ReadWriteLock &rhs);
+    ReadWriteLock &operator=(const ReadWriteLock &rhs);
+  private:
+    void *iHandle;
+  };
+
+  class Thread {
+  public:
+    Thread();
+    virtual ~Thread();
+    bool start();
+    void wait();
+    static int idealCount();
+  protected:
+    //! The code executed by the thread.
+    virtual void run() = 0;
+  private:
+#ifdef WIN32
+    static unsigned long __stdcall entry(void *thread);
+#else
+    static void *entry(void *thread);
+#endif
+    // disable copying
+    Thread(const Thread &rhs);
+    Thread &operator=(const Thread &rhs);
+  private:
+    void *iHandle;
+  };
+
   // --------------------------------------------------------------------
 
   class Platform {
@@ -345,6 +463,7 @@ namespace ipe {
     static char pathSeparator();
     static String currentDirectory();
     static String latexDirectory();
+    static String cacheDirectory();
     static String fontmapFile();
     static bool fileExists(String fname);
     static String readFile(String fname);
@@ -35,6 +35,8 @@
 #include "ipebase.h"
 #include "ipexml.h"
 
+#include <atomic>
+
 // --------------------------------------------------------------------
 
 namespace ipe {
@@ -81,6 +83,8 @@ namespace ipe {
     inline int objNum() const;
     inline void setObjNum(int objNum) const;
 
+    inline unsigned long long hash() const;
+
     inline MRenderData *renderData() const;
     void setRenderData(MRenderData *data) const;
 
@@ -92,11 +96,11 @@ namespace ipe {
 
   private:
     int init(const XmlAttributes &attr);
-    void computeChecksum();
+    void computeHash();
 
   private:
     struct Imp {
-      int iRefCount;
+      std::atomic<int> iRefCount;    // bitmaps are shared between threads
       TColorSpace iColorSpace;
       int iBitsPerComponent;
       int iWidth;
@@ -105,7 +109,7 @@ namespace ipe {
       int iColorKey;
       Buffer iData;
       TFilter iFilter;
-      int iChecksum;
+      unsigned long long iHash;
       mutable int iObjNum;           // Object number (e.g. in PDF file)
       mutable MRenderData *iRender;  // cached pixmap to render it fast
     };
@@ -187,6 +191,13 @@ namespace ipe {
     return iImp->iRender;
   }
 
+  //! Return 64-bit hash of the bitmap contents.
+  /*! Bitmaps that are equal() have the same hash. */
+  inline unsigned long long Bitmap::hash() const
+  {
+    return iImp->iHash;
+  }
+
   //! Two bitmaps are equal if they share the same data.
   inline bool Bitmap::operator==(const Bitmap &rhs) const
   {
@@ -200,16 +211,23 @@ namespace ipe {
   }
 
   //! Less operator, to be able to sort bitmaps.
-  /*! The checksum is used, when it is equal, the shared address.
+  /*! The hash is used, when it is equal, the shared address.
     This guarantees that bitmaps that are == (share their implementation)
     are next to each other, and blocks of them are next to blocks that
     are identical in contents. */
   inline bool Bitmap::operator<(const Bitmap &rhs) const
   {
-    return (iImp->iChecksum < rhs.iImp->iChecksum ||
-	    (iImp->iChecksum == rhs.iImp->iChecksum && iImp < rhs.iImp));
+    return (iImp->iHash < rhs.iImp->iHash ||
+	    (iImp->iHash == rhs.iImp->iHash && iImp < rhs.iImp));
   }
 
+  //! Hash function for unordered containers of bitmaps.
+  /*! Bitmaps that are == have the same hash. */
+  struct BitmapHash {
+    size_t operator()(const Bitmap &bitmap) const {
+      return size_t(bitmap.hash()); }
+  };
+
 } // namespace
 
 // --------------------------------------------------------------------
@@ -43,6 +43,7 @@
 namespace ipe {
 
   class BitmapFinder;
+  class CharacterFinder;
 
   class Document {
   public:
@@ -69,6 +70,7 @@ namespace ipe {
       EPdf,  //!< Save as PDF
       EEps,  //!< Save as Encapsulated Postscript
       EIpe5,  //!< Ancient Ipe format
+      EBinary, //!< Binary snapshot (for caches, not for interchange)
       EUnknown //!< Unknown file format
     };
 
@@ -79,6 +81,18 @@ namespace ipe {
       ENoZip = 2,      //!< Do not compress streams
       EMarkedView = 4, //!< Create marked views only
       ENoColor = 8,    //!< No color commands in EPS output
+      EAppend = 16,    //!< Append changes to an existing PDF file
+      ELayerForms = 32, //!< Paint layers shared by views only once (PDF)
+      EThreads = 0x100, //!< Unit of the number of threads for PDF pages
+      EThreadsMask = 0xff00, //!< Number of threads (0 means default)
+      ECompress = 0x10000, //!< Unit of the compression level (1 to 12)
+      ECompressMask = 0xf0000, //!< Compression level (0 means default)
+    };
+
+    //! Options for loading Ipe documents
+    enum {
+      ELoadNormal = 0, //!< Parse the entire document
+      ELoadLazy = 1,   //!< Parse pages only when they are used
     };
 
     //! Errors that can happen while loading documents
@@ -96,30 +110,43 @@ namespace ipe {
     static TFormat fileFormat(DataSource &source);
     static TFormat formatFromFilename(String fn);
 
-    static Document *load(DataSource &source, TFormat format, int &reason);
+    static Document *load(DataSource &source, TFormat format, int &reason,
+			  uint flags = ELoadNormal);
 
-    static Document *load(const char *fname, int &reason);
-    static Document *loadWithErrorReport(const char *fname);
+    static Document *load(const char *fname, int &reason,
+			  uint flags = ELoadNormal);
+    static Document *loadWithErrorReport(const char *fname,
+					 uint flags = ELoadNormal);
 
     bool save(TellStream &stream, TFormat format, uint flags) const;
-    bool save(const char *fname, TFormat format, uint flags) const;
+    bool save(const char *fname, TFormat format, uint flags,
+	      double maxGarbage = 0.5) const;
     bool exportPages(const char *fname, uint flags,
 		     int fromPage, int toPage) const;
     bool exportView(const char *fname, TFormat format,
 		    uint flags, int pno, int vno) const;
 
     void saveAsXml(Stream &stream, bool usePdfBitmaps = false) const;
+    void saveAsDeflatedXml(Stream &stream, int compressLevel) const;
 
     //! Return number of pages of document.
     int countPages() const { return int(iPages.size()); }
     int countTotalViews() const;
 
     //! Return page (const version).
-    /*! The first page is no 0. */
-    const Page *page(int no) const { return iPages[no]; }
+    /*! The first page is no 0.  For documents loaded with ELoadLazy,
+      this parses the page when it is first used, and is then not
+      thread-safe. */
+    const Page *page(int no) const {
+      return iPages[no] ? iPages[no] : materialize(no); }
     //! Return page.
     /*! The first page is no 0. */
-    Page *page(int no) { return iPages[no]; }
+    Page *page(int no) {
+      return iPages[no] ? iPages[no] : materialize(no); }
+    //! Has page \a no been parsed already?
+    bool isMaterialized(int no) const { return iPages[no] != 0; }
+    void materializeAll() const;
+    int brokenPage(int fromPage = 0, int toPage = -1) const;
 
     Page *set(int no, Page *page);
     void insert(int no, Page *page);
@@ -145,25 +172,39 @@ namespace ipe {
     bool hasTilings() const;
     bool hasGradients() const;
 
-    void findBitmaps(BitmapFinder &bm) const;
+    void findBitmaps(BitmapFinder &bm, int fromPage = 0,
+		     int toPage = -1) const;
+    void findCharacters(CharacterFinder &cf, int fromPage = 0,
+			int toPage = -1) const;
     bool checkStyle(AttributeSeq &seq) const;
 
     //! Error codes returned by RunLatex.
     enum { ErrNone, ErrNoText, ErrNoDir, ErrWritingSource,
 	   ErrOldPdfLatex, ErrRunLatex, ErrLatex, ErrLatexOutput,
 	   ErrNoIconv };
-    int runLatex(String &logFile);
-    int runLatex();
+    int runLatex(String &logFile, int fromPage = 0, int toPage = -1);
+    int runLatex(int fromPage = 0, int toPage = -1);
 
   private:
     // disable assignment
     Document &operator=(const Document &rhs);
+    Page *materialize(int no) const;
+    void addUnparsedPage(String xml);
+    void saveXmlHead(Stream &stream, bool usePdfBitmaps) const;
 
   private:
-    std::vector<Page *> iPages;
+    //! Pages, zero for pages that have not been parsed yet.
+    mutable std::vector<Page *> iPages;
+    //! XML text of pages not yet parsed (empty if loaded normally).
+    /*! The text is kept for pages that could not be parsed. */
+    mutable std::vector<String> iPageXml;
+    //! Bitmaps used by pages not yet parsed, with their id in the file.
+    std::vector<std::pair<int, Bitmap> > iBitmaps;
     Cascade *iCascade;
     SProperties iProperties;
     FontPool *iFontPool;
+
+    friend class ImlParser;
   };
 
 } // namespace
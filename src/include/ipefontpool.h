@@ -67,6 +67,8 @@ namespace ipe {
     bool iStandardFont;
     //! The width of each character in font units.
     int iWidth[0x100];
+
+    bool subset(const std::vector<bool> &used, Font &result) const;
   };
 
   //! A list of fonts used by a Document. \relates Font
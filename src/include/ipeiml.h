@@ -46,7 +46,7 @@ namespace ipe {
     enum Errors { ESuccess = 0, EVersionTooOld, EVersionTooRecent,
 		  ESyntaxError };
     explicit ImlParser(DataSource &source);
-    int parseDocument(Document &doc);
+    int parseDocument(Document &doc, bool lazy = false);
     bool parsePage(Page &page);
     Object *parseObject(String tag, Page *page = 0,
 			int *currentLayer = 0);
@@ -57,8 +57,14 @@ namespace ipe {
     virtual Buffer pdfStream(int objNum);
     bool parseBitmap();
     bool parseFontmap(String *stdNames, String *paths);
+    static Page *parsePageText(const String &text,
+			       const std::vector<std::pair<int, Bitmap> >
+			       &bitmaps, int &errorPos);
   private:
-    std::vector<Bitmap> iBitmaps;
+    bool parsePages(Document &doc, String &tag);
+  private:
+    std::vector<std::pair<int, Bitmap> > iBitmaps;
+    XmlAttributes iAttributes;
   };
 
 } // namespace
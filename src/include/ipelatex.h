@@ -50,11 +50,13 @@ namespace ipe {
     ~Latex();
 
     int scanObject(const Object *obj);
-    int scanPage(Page *page);
+    int scanPage(const Page *page);
     int createLatexSource(Stream &stream, String preamble);
     bool readPdf(DataSource &source);
     bool updateTextObjects();
     FontPool *takeFontPool();
+    //! Has the rendering of a text in a symbol changed?
+    inline bool symbolsChanged() const { return iSymbolsChanged; }
 
   private:
     bool getXForm(const PdfObj *xform);
@@ -65,6 +67,10 @@ namespace ipe {
     struct SText {
       const Text *iText;
       Attribute iSize;
+      //! Page containing the text (0 for symbols).
+      const Page *iPage;
+      //! Index of object containing the text (-1 for the page title).
+      int iObject;
     };
 
     typedef std::list<SText> TextList;
@@ -86,6 +92,8 @@ namespace ipe {
     //! Maps /F<n> to object number;
     std::map<int, int> iFontObjects;
 
+    bool iSymbolsChanged;
+
     friend class ipe::TextCollectingVisitor;
   };
 
@@ -33,6 +33,7 @@
 #define IPEPAGE_H
 
 #include "ipetext.h"
+#include "ipebitmap.h"
 
 // --------------------------------------------------------------------
 
@@ -45,10 +46,13 @@ namespace ipe {
   class Page {
   public:
     explicit Page();
+    Page(const Page &rhs);
+    Page &operator=(const Page &rhs);
 
     static Page *basic();
 
     void saveAsXml(Stream &stream) const;
+    String deflatedXml(int compressLevel) const;
     void saveAsIpePage(Stream &stream) const;
     void saveSelection(Stream &stream) const;
 
@@ -124,6 +128,7 @@ namespace ipe {
     inline int count() const { return int(iObjects.size()); }
 
     //! Return object at index \a i.
+    /*! If you modify the object, you must call invalidateBBox(). */
     inline Object *object(int i) { return iObjects[i].iObject; }
     //! Return object at index \a i (const version).
     inline const Object *object(int i) const { return iObjects[i].iObject; }
@@ -136,7 +141,8 @@ namespace ipe {
     //! Set selection status of object at index \a i.
     inline void setSelect(int i, TSelect sel) { iObjects[i].iSelect = sel; }
     //! Set layer of object at index \a i.
-    inline void setLayerOf(int i, int layer) { iObjects[i].iLayer = layer; }
+    inline void setLayerOf(int i, int layer) {
+      iObjects[i].iLayer = layer; dropCache(); }
 
     Rect pageBBox(const Cascade *sheet) const;
     Rect viewBBox(const Cascade *sheet, int view) const;
@@ -147,6 +153,7 @@ namespace ipe {
     void snapVtx(int i, const Vector &mouse, Vector &pos, double &bound) const;
     void snapBnd(int i, const Vector &mouse, Vector &pos, double &bound) const;
     void invalidateBBox(int i) const;
+    void invalidateRendering(int i) const;
 
     void insert(int i, TSelect sel, int layer, Object *obj);
     void append(TSelect sel, int layer, Object *obj);
@@ -160,7 +167,14 @@ namespace ipe {
     void deselectAll();
     void ensurePrimarySelection();
 
+    String cachedView(int view, String key) const;
+    void setCachedView(int view, String key, String data) const;
+
   private:
+    void dropCache() const;
+    void updateXmlCache() const;
+    void saveXmlUncached(Stream &stream) const;
+
     enum { ELocked = 0x01, ENoSnapping = 0x02 };
 
     struct SLayer {
@@ -181,6 +195,10 @@ namespace ipe {
       Attribute iEffect;
       String iActive;
       bool iMarked;
+      //! Key of the cached output of this view.
+      mutable String iCacheKey;
+      //! Cached output of this view (see cachedView()).
+      mutable String iCache;
     };
     typedef std::vector<SView> ViewSeq;
 
@@ -207,6 +225,15 @@ namespace ipe {
     ObjSeq iObjects;
     String iNotes;
     bool iMarked;
+
+    //! Cached XML representation (empty if page changed).
+    mutable String iXmlCache;
+    //! Bitmaps used in iXmlCache, with the object number saved there.
+    mutable std::vector<std::pair<Bitmap, int> > iXmlBitmaps;
+    //! iXmlCache compressed by DeflateStream::deflatePiece (or empty).
+    mutable String iXmlDeflated;
+    //! Compression level of iXmlDeflated.
+    mutable int iXmlDeflatedLevel;
   };
 
 } // namespace
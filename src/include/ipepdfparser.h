@@ -93,12 +93,17 @@ namespace ipe {
 
   class PdfString : public PdfObj {
   public:
-    explicit PdfString(const String &val) : iValue(val) { /* nothing */ }
+    explicit PdfString(const String &val, bool binary = false)
+      : iValue(val), iBinary(binary) { /* nothing */ }
     virtual const PdfString *string() const;
     virtual void write(Stream &stream) const;
+    //! Return value of string (the hex digits if it is binary).
     inline String value() const { return iValue; }
+    //! Is this a binary string written as <hex>?  It is not decoded.
+    inline bool binary() const { return iBinary; }
   private:
     String iValue;
+    bool iBinary;
   };
 
   class PdfName : public PdfObj {
@@ -147,7 +152,7 @@ namespace ipe {
     inline String key(int index) const { return iItems[index].iKey; }
     inline Buffer stream() const { return iStream; }
     bool deflated() const;
-    // Buffer Inflate() const;
+    Buffer inflate() const;
   private:
     struct Item {
       String iKey;
@@ -168,13 +173,16 @@ namespace ipe {
     TToken iType;
     //! The string representing this token.
     String iString;
+    //! Is this an undecoded binary string written as <hex>?
+    bool iBinary;
   };
 
   class PdfParser {
   public:
-    PdfParser(DataSource &source);
+    PdfParser(DataSource &source, const PdfFile *file = 0);
 
-    inline void getChar() { iCh = iSource.getChar(); ++iPos; }
+    inline void getChar() {
+      iCh = (iP < iFin || fillBuffer()) ? uchar(*iP++) : EOF; ++iPos; }
     inline bool eos() const { return (iCh == EOF); }
     inline PdfToken token() const { return iTok; }
 
@@ -185,15 +193,22 @@ namespace ipe {
     void skipXRef();
 
   private:
+    bool fillBuffer();
+    void getBytes(char *p, int n);
     void skipWhiteSpace();
     PdfArray *makeArray();
     PdfDict *makeDict();
 
   private:
     DataSource &iSource;
+    //! File for looking up indirect stream lengths, or 0.
+    const PdfFile *iFile;
     int iPos;
     int iCh;
     PdfToken iTok;
+    const char *iP;   // next character in current block
+    const char *iFin; // end of current block
+    Buffer iBuffer;   // for sources that cannot provide their own block
   };
 
   class PdfFile {
@@ -201,12 +216,47 @@ namespace ipe {
     PdfFile();
     ~PdfFile();
     bool parse(DataSource &source);
+    bool parse(const char *data, int size);
     const PdfObj *object(int num) const;
     const PdfDict *catalog() const;
+    //! Return the trailer dictionary.
+    inline const PdfDict *trailer() const { return iTrailer; }
     const PdfDict *page() const;
+    int objectOffset(int num) const;
+    int generation(int num) const;
+    //! Return the size of the cross-reference table.
+    inline int countObjects() const { return int(iXRef.size()); }
+    //! Return offset of the most recent cross-reference table.
+    inline int lastXRef() const { return iLastXRef; }
+    //! Return file contents (if read using parse(const char *, int)).
+    inline const char *data() const { return iData; }
+    //! Return size of file contents.
+    inline int size() const { return iSize; }
   private:
-    std::map<int, const PdfObj *> iObjects;
+    bool readXRef(int offset, int &prev);
+    bool readXRefStream(const PdfDict *dict);
+    bool readObjectStream(int num) const;
+    void clear();
+  private:
+    //! Cross-reference entry of an object.
+    struct XRef {
+      //! 0 if free, 1 if at file offset, 2 if compressed, -1 if unknown.
+      int iType;
+      //! File offset, or number of the object stream containing it.
+      int iOffset;
+      //! Generation number (the next one to use, if free).
+      int iGen;
+    };
+    mutable std::map<int, const PdfObj *> iObjects;
     const PdfDict *iTrailer;
+    //! File contents for random access (not owned), or 0.
+    const char *iData;
+    //! Size of file contents.
+    int iSize;
+    //! Offset of the most recent cross-reference table, or -1.
+    int iLastXRef;
+    //! Cross-reference entries of all objects.
+    std::vector<XRef> iXRef;
   };
 
 } // namespace
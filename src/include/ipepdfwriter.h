@@ -37,11 +37,16 @@
 #include "ipedoc.h"
 #include "ipeimage.h"
 #include "ipefontpool.h"
+#include "ipeutils.h"
+
+#include <unordered_map>
 
 // --------------------------------------------------------------------
 
 namespace ipe {
 
+  class PdfFile;
+
   class PdfPainter : public Painter {
   public:
     PdfPainter(const Cascade *style, Stream &stream);
@@ -83,26 +88,96 @@ namespace ipe {
   public:
     PdfWriter(TellStream &stream, const Document *doc,
 	      const FontPool *pool,
-	      bool markedView, int fromPage, int toPage, int compression);
+	      bool markedView, int fromPage, int toPage, int compression,
+	      const PdfFile *previous = 0);
     ~PdfWriter();
 
-    void createPages();
+    void createPages(int threads = 1, bool layerForms = false);
     void createPageView(int page, int view);
     void createBookmarks();
-    void createXmlStream(String xmldata, bool preCompressed);
+    Stream &startXmlStream();
+    void finishXmlStream();
+    void createXmlStream(String deflated);
     void createTrailer();
+    double garbage() const;
 
   private:
+    //! A layer form drawn by a view instead of some of its objects.
+    struct FormUse {
+      //! Obj id of form XObject.
+      int iNum;
+      //! The form shows the objects iFirst to iLast - 1 of the page.
+      int iFirst;
+      int iLast;
+    };
+    //! A page view whose objects are being created.
+    struct View {
+      int iPage;
+      int iView;
+      //! Bitmaps used by the view.
+      BitmapFinder iBitmaps;
+      //! Bitmaps that are embedded just before the view.
+      std::vector<Bitmap> iEmbed;
+      //! Obj id of content stream.
+      int iContentsNum;
+      //! Obj id of page object.
+      int iPageNum;
+      //! Cache key of the content stream, see Page::cachedView.
+      String iKey;
+      //! Content stream, empty if it still needs to be painted.
+      String iData;
+      //! Layer forms it draws instead of some of the objects.
+      std::vector<FormUse> iForms;
+    };
+    //! Consecutive objects shown in the same views of a page.
+    struct LayerForm {
+      int iPage;
+      //! The objects iFirst to iLast - 1 of the page.
+      int iFirst;
+      int iLast;
+      //! Bitmaps used by the objects.
+      BitmapFinder iBitmaps;
+      //! Bitmaps that are embedded just before the form.
+      std::vector<Bitmap> iEmbed;
+      //! Obj id of form XObject.
+      int iNum;
+      //! Content stream of the form, compressed if necessary.
+      String iData;
+    };
+    class ViewPainter;
+    class UpdateStream;
+
     int startObject(int objnum = -1);
+    int nextObjNum();
+    int generation(int num) const;
+    String ref(int num) const;
     void createStream(const char *data, int size, bool preCompressed);
+    Stream &startStream();
+    void finishStream();
     void writeString(String text);
     void embedBitmap(Bitmap bitmap);
-    void paintView(Stream &stream, int pno, int view);
+    void paintView(Stream &stream, int pno, int view,
+		   const std::vector<FormUse> &forms) const;
+    void paintContents(View &view) const;
+    void findLayerForms(int page, std::vector<View> &views, int first,
+			std::vector<LayerForm> &forms);
+    void writeForm(const LayerForm &form);
+    void prepareView(View &view);
+    void writeView(const View &view);
+    void allocateBitmaps(const BitmapFinder &bm, std::vector<Bitmap> &embed);
     void embedBitmaps(const BitmapFinder &bm);
-    void createResources(const BitmapFinder &bm);
+    void createResources(const BitmapFinder &bm,
+			 const std::vector<FormUse> *forms = 0);
+    void createResourceDict(const BitmapFinder &bm,
+			    const std::vector<FormUse> *forms);
     void embedFonts(const FontPool *pool);
+    void createUpdateXRef(int catalogobj, int infoobj);
 
   private:
+    //! Previous version of the file being updated, or 0.
+    const PdfFile *iPrevious;
+    //! Filters out the objects unchanged from iPrevious, or 0.
+    UpdateStream *iUpdate;
     TellStream &iStream;
     const Document *iDoc;
     //! Show only last view of each page?
@@ -113,7 +188,7 @@ namespace ipe {
     int iResourceNum;
     //! Obj id of outline dictionary.
     int iBookmarks;
-    //! Compression level (0..9).
+    //! Compression level (0..12).
     int iCompressLevel;
     //! Obj id of font for page numbers.
     int iPageNumberFont;
@@ -121,14 +196,27 @@ namespace ipe {
     int iExtGState;
     //! Obj id of dictionary with pattern definitions.
     int iPatternNum;
+    //! Obj id of resource dictionary of forms without bitmaps.
+    int iFormResources;
     // Export only those pages
     int iFromPage;
     int iToPage;
 
-    std::vector<Bitmap> iBitmaps;
+    //! Bitmaps with object numbers, indexed by their hash.
+    std::unordered_multimap<unsigned long long, Bitmap> iBitmaps;
     //! Next unused PDF object number.
     int iObjNum;
 
+    //! Data of the stream being written (see startStream()).
+    String iStreamData;
+    //! Writes to iStreamData, or 0 if no stream is being written.
+    StringStream *iStreamBuffer;
+    //! Compresses the data of that stream, or 0.
+    DeflateStream *iDeflate;
+
+    //! Describes the context of the page streams, see Page::cachedView.
+    String iCacheKey;
+
     //! Object numbers of gradients, indexed by attribute name
     std::map<int, int> iGradients;
     //! Object numbers of symbols, indexed by attribute name
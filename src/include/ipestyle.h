@@ -85,6 +85,7 @@ namespace ipe {
     StyleSheet();
 
     static StyleSheet *standard();
+    static StyleSheet *load(String fname, int &errorPos);
 
     void addSymbol(Attribute name, const Symbol &symbol);
     const Symbol *findSymbol(Attribute sym) const;
@@ -143,6 +144,13 @@ namespace ipe {
     //! Return path fill rule.
     TFillRule fillRule() const { return iFillRule; }
 
+    //! Return modification stamp.
+    /*! The stamp changes whenever a definition is added to the style
+      sheet or one of its settings is changed.  Stamps are unique
+      across all style sheets, so sheets with the same stamp have the
+      same definitions (one is a copy of the other). */
+    inline int stamp() const { return iStamp; }
+
     //! Return name of style sheet.
     inline String name() const { return iName; }
     //! Set name of style sheet.
@@ -156,6 +164,7 @@ namespace ipe {
     typedef std::map<int, Attribute> Map;
 
     bool iStandard;
+    int iStamp;
     String iName;
     SymbolMap iSymbols;
     GradientMap iGradients;
@@ -188,6 +197,8 @@ namespace ipe {
     inline int count() const { return iSheets.size(); }
     //! Return StyleSheet at \a index.
     inline StyleSheet *sheet(int index) { return iSheets[index]; }
+    //! Return StyleSheet at \a index (const version).
+    inline const StyleSheet *sheet(int index) const { return iSheets[index]; }
 
     void insert(int index, StyleSheet *sheet);
     void remove(int index);
@@ -215,8 +226,30 @@ namespace ipe {
     int findDefinition(Kind kind, Attribute sym) const;
     void allCMaps(std::vector<String> &seq) const;
 
+    void resolve() const;
+
+  private:
+    //! Lookup tables built from the style sheets of the cascade.
+    struct Resolved {
+      //! Stamps of the style sheets when the tables were built.
+      std::vector<int> iStamps;
+      //! Resolved attributes, indexed by symbolic index.
+      std::vector<Attribute> iAttributes[EEffect + 1];
+      //! Result of lookup for a symbolic name that is not defined.
+      Attribute iNormal[EEffect + 1];
+      std::vector<const Symbol *> iSymbols;
+      std::vector<const Gradient *> iGradients;
+      std::vector<const Tiling *> iTilings;
+      std::vector<const Effect *> iEffects;
+      const Layout *iLayout;
+    };
+
+    const Resolved *resolved() const;
+    void invalidate();
+
   private:
     std::vector<StyleSheet *> iSheets;
+    mutable Resolved *iResolved;
   };
 
 } // namespace
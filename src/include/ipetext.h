@@ -116,13 +116,26 @@ namespace ipe {
     void setWidth(double width);
     void setText(String text);
 
+    class MRenderData {
+    public:
+      virtual ~MRenderData();
+    };
+
     struct XForm {
+      XForm();
+      ~XForm();
       unsigned long int iRefCount;
       Buffer iStream;
       Rect iBBox;
       int iDepth;
       std::vector<int> iFonts;
       double iStretch;
+      //! Stream prepared by a client for fast rendering (owned), or 0.
+      mutable MRenderData *iRender;
+    private:
+      // disable copying
+      XForm(const XForm &rhs);
+      XForm &operator=(const XForm &rhs);
     };
 
     bool isInternal() const { return iType == 0; }
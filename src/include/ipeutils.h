@@ -35,6 +35,9 @@
 #include "ipebitmap.h"
 #include "ipepainter.h"
 
+#include <set>
+#include <unordered_set>
+
 // --------------------------------------------------------------------
 
 namespace ipe {
@@ -49,6 +52,26 @@ namespace ipe {
     virtual void visitImage(const Image *obj);
   public:
     std::vector<Bitmap> iBitmaps;
+  private:
+    std::unordered_set<Bitmap, BitmapHash> iFound;
+  };
+
+  class CharacterFinder : public Visitor {
+  public:
+    CharacterFinder();
+    void scanPage(const Page *page);
+    bool complete(int font) const;
+
+    virtual void visitGroup(const Group *obj);
+    virtual void visitText(const Text *obj);
+  public:
+    //! Character codes used, indexed by the Pdflatex font number.
+    std::map<int, std::vector<bool> > iCodes;
+    //! Fonts used with strings whose codes were not found.
+    std::set<int> iIncomplete;
+    //! Is an XObject drawn inside a text object?
+    /*! Its fonts and codes are not known. */
+    bool iXObject;
   };
 
   class BBoxPainter : public Painter {
@@ -92,6 +115,7 @@ namespace ipe {
   public:
     Base64Stream(Stream &stream);
     virtual void putChar(char ch);
+    virtual void putRaw(const char *data, int size);
     virtual void close();
   private:
     Stream &iStream;
@@ -100,21 +124,57 @@ namespace ipe {
     int iCol;
   };
 
+  class Compression {
+  public:
+    class Filter {
+    public:
+      enum TStatus { EOk, EStreamEnd, EError };
+      virtual ~Filter();
+      //! Process input into the output buffer, and advance both.
+      virtual TStatus run(bool finish) = 0;
+    public:
+      const char *iNextIn;
+      int iAvailIn;
+      char *iNextOut;
+      int iAvailOut;
+    };
+
+    virtual ~Compression();
+    virtual const char *name() const = 0;
+    virtual Filter *deflater(int level) const = 0;
+    virtual Filter *inflater() const = 0;
+    virtual Buffer deflate(const char *data, int size,
+			   int &deflatedSize, int level) const;
+    virtual Buffer inflate(const char *data, int size) const;
+    virtual bool prefersBuffers() const;
+
+    static const Compression *backend();
+    static void setBackend(const Compression *backend);
+    static const Compression *zlib();
+    static const Compression *libdeflate();
+  };
+
   class DeflateStream : public Stream {
   public:
     DeflateStream(Stream &stream, int level);
     virtual ~DeflateStream();
     virtual void putChar(char ch);
+    virtual void putRaw(const char *data, int size);
     virtual void close();
 
     static Buffer deflate(const char *data, int size,
 			  int &deflatedSize, int compressLevel);
+    static String deflatePiece(const char *data, int size,
+			       int compressLevel);
+    static void writePieces(Stream &stream,
+			    const std::vector<String> &pieces);
 
   private:
-    struct Private;
+    void flushInput();
 
+  private:
     Stream &iStream;
-    Private *iPriv;
+    Compression::Filter *iFilter;
     int iN;
     Buffer iIn;
     Buffer iOut;
@@ -138,6 +198,7 @@ namespace ipe {
     Base64Source(DataSource &source);
     //! Get one more character, or EOF.
     virtual int getChar();
+    static int decode(const char *data, int size, char *out, int length);
   private:
     DataSource &iSource;
     bool  iEof;
@@ -152,15 +213,14 @@ namespace ipe {
     virtual ~InflateSource();
     //! Get one more character, or EOF.
     virtual int getChar();
+    virtual int getBlock(const char *&data, char *buffer, int size);
 
   private:
     void fillBuffer();
 
   private:
-    struct Private;
-
     DataSource &iSource;
-    Private *iPriv;
+    Compression::Filter *iFilter;
     char *iP;
     Buffer iIn;
     Buffer iOut;
@@ -34,38 +34,98 @@
 
 #include "ipebase.h"
 
+#include <iterator>
+#include <utility>
+
 // --------------------------------------------------------------------
 
 namespace ipe {
 
   class XmlAttributes {
   private:
-    typedef std::map<String, String> Map;
+    struct Entry;
   public:
-    //! Iterator for (key, value) pairs.
-    typedef Map::const_iterator const_iterator;
+    //! Iterator for (key, value) pairs, in order of the keys.
+    /*! Dereferencing yields a std::pair<String, String>, as for the
+      std::map that XmlAttributes used to be. */
+    class const_iterator {
+    public:
+      typedef std::forward_iterator_tag iterator_category;
+      typedef std::pair<String, String> value_type;
+      typedef std::ptrdiff_t difference_type;
+      typedef const value_type *pointer;
+      typedef const value_type &reference;
+
+      const_iterator() : iEntry(0) { /* nothing */ }
+      reference operator*() const { fill(); return iPair; }
+      pointer operator->() const { fill(); return &iPair; }
+      const_iterator &operator++() { ++iEntry; return *this; }
+      const_iterator operator++(int) {
+	const_iterator it = *this; ++iEntry; return it; }
+      bool operator==(const const_iterator &rhs) const {
+	return iEntry == rhs.iEntry; }
+      bool operator!=(const const_iterator &rhs) const {
+	return iEntry != rhs.iEntry; }
+
+    private:
+      explicit const_iterator(const Entry *entry) : iEntry(entry) { }
+      inline void fill() const;
+    private:
+      const Entry *iEntry;
+      mutable value_type iPair;
+      friend class XmlAttributes;
+    };
 
     //! Return const iterator for first attribute.
-    const_iterator begin() const { return iMap.begin(); }
+    const_iterator begin() const {
+      return const_iterator(iEntries.empty() ? 0 : &iEntries[0]); }
     //! Return const iterator for end of attributes.
-    const_iterator end() const { return iMap.end(); }
+    const_iterator end() const {
+      return const_iterator(iEntries.empty() ? 0 :
+			    &iEntries[0] + iEntries.size()); }
 
     XmlAttributes();
     void clear();
-    String operator[](String str) const;
-    bool has(String str) const;
-    bool has(String str, String &val) const;
+    String operator[](const char *key) const;
+    String operator[](String key) const;
+    bool has(const char *key) const;
+    bool has(String key) const;
+    bool has(const char *key, String &val) const;
+    bool has(String key, String &val) const;
     void add(String key, String val);
+    //! Return number of attributes.
+    inline int count() const { return iEntries.size(); }
+    //! Return key of attribute with index \a i.
+    inline String key(int i) const { return String(iEntries[i].iKey); }
+    //! Return value of attribute with index \a i.
+    inline String value(int i) const { return iEntries[i].iValue; }
     //! Set that the tag contains the final /.
     inline void setSlash() { iSlash = true; }
     //! Return whether tag contains the final /.
     inline bool slash() const { return iSlash; }
 
   private:
-    Map iMap;
+    int find(const char *key) const;
+
+  private:
+    struct Entry {
+      //! Zero-terminated key, in static table or in iOwnKeys.
+      const char *iKey;
+      String iValue;
+    };
+    //! Attributes, sorted by key.
+    std::vector<Entry> iEntries;
+    //! Keys that are not in the table of known keys.
+    std::vector<String> iOwnKeys;
     bool iSlash;
   };
 
+  inline void XmlAttributes::const_iterator::fill() const
+  {
+    iPair.first = String(iEntry->iKey);
+    iPair.second = iEntry->iValue;
+  }
+
   class XmlParser {
   public:
     XmlParser(DataSource &source);
@@ -76,23 +136,48 @@ namespace ipe {
     String parseToTag();
     bool parseAttributes(XmlAttributes &attr, bool qm = false);
     bool parsePCDATA(String tag, String &pcdata);
+    bool takeElement(String tag, String &text);
+
+    bool compile(Stream &stream);
+    //! Is the parser reading binary XML?
+    inline bool isBinary() const { return iBinary; }
 
     inline bool isTagChar(int ch) {
       return ('a' <= ch && ch <= 'z') || ('A' <= ch && ch <= 'Z')
 	|| ch == '-'; }
 
-    inline void getChar() { iCh = iSource.getChar(); ++iPos; }
+    inline void getChar() {
+      iCh = (iP < iFin || fillBuffer()) ? uchar(*iP++) : EOF; ++iPos; }
     inline bool eos() { return (iCh == EOF); }
     void skipWhitespace();
 
   protected:
     String parseToTagX();
+    String parseTagName();
+    bool fillBuffer();
+    void skipTo(const char *q);
+    void takeUntil(String &s, char stop);
+    void takeTagChars(String &s);
+
+  private:
+    String binaryToTag();
+    bool binaryAttributes(XmlAttributes &attr);
+    bool binaryPCDATA(String tag, String &pcdata);
+    int getNumber();
+    String getBytes(int n);
+    String getName();
 
   protected:
     DataSource &iSource;
     String iTopElement;
     int iCh;  // current character
     int iPos; // position in input stream
+    const char *iP;   // next character in current block
+    const char *iFin; // end of current block
+    Buffer iBuffer;   // for sources that cannot provide their own block
+    bool iBinary;     // reading binary XML
+    bool iPendingAttributes;  // binary: attributes of last tag not read
+    std::vector<String> iNames;  // binary: table of tag and key names
   };
 
 } // namespace
@@ -541,6 +541,7 @@ function MODEL:saveDocument(fname)
   if not fname then
     fname = self.file_name
   end
+  local inplace = (fname == self.file_name)
   local fm = formatFromFileName(fname)
   if not fm then
     self:warning("File not saved!",
@@ -593,7 +594,11 @@ function MODEL:saveDocument(fname)
   props.creator = config.version
   self.doc:setProperties(props)
 
-  if not self.doc:save(fname, fm) then
+  local flags = nil
+  if fm == "pdf" and inplace and prefs.pdf_update_garbage then
+    flags = { append=true, garbage=prefs.pdf_update_garbage }
+  end
+  if not self.doc:save(fname, fm, flags) then
     self:warning("File not saved!", "Error saving the document")
     return
   end
@@ -185,6 +185,15 @@ prefs.coordinates_format = "[%7.3f%s, %7.3f%s]"
 -- must be integers. -5 means "5:1", +5 means "1:5"
 prefs.scale_factors = { -100, -5, 10, 100, 1000, 10000 }
 
+-- Set this to a fraction (such as 0.5) to append only the changes
+-- when a PDF file is saved under its own name (an incremental
+-- update).  The file is then written completely once more than this
+-- fraction of it is no longer used.
+-- Older versions of Ipe cannot read the changes, and show the
+-- document as it was before them.  The default nil always writes
+-- the complete file.
+prefs.pdf_update_garbage = nil
+
 -- Auto-exporting when document is being saved
 -- if auto_export_only_if_exists is true, then the file will only
 -- be auto-exported if a file with the target name already exists
@@ -590,9 +590,9 @@ void Parser::writeAttr(const XmlAttributes &att, String s, String grs)
 
 void Parser::writeAttr(const XmlAttributes &att)
 {
-  for (XmlAttributes::const_iterator it = att.begin(); it != att.end(); ++it) {
-    String name = it->first;
-    String value = it->second;
+  for (int i = 0; i < att.count(); ++i) {
+    String name = att.key(i);
+    String value = att.value(i);
     iStream << " " << name << "=\"";
     iStream.putXmlString(value);
     iStream << "\"";
@@ -0,0 +1,356 @@
+// --------------------------------------------------------------------
+// ipebench
+// --------------------------------------------------------------------
+/*
+
+    This file is part of the extensible drawing editor Ipe.
+    Copyright (C) 1993-2014  Otfried Cheong
+
+    Ipe is free software; you can redistribute it and/or modify it
+    under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    As a special exception, you have permission to link Ipe with the
+    CGAL library and distribute executables, as long as you follow the
+    requirements of the Gnu General Public License in regard to all of
+    the software in the executable aside from CGAL.
+
+    Ipe is distributed in the hope that it will be useful, but WITHOUT
+    ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+    or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+    License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Ipe; if not, you can find it at
+    "http://www.gnu.org/copyleft/gpl.html", or write to the Free
+    Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+*/
+
+#include "ipedoc.h"
+#include "ipeutils.h"
+
+#include <chrono>
+#include <cstdlib>
+
+using namespace ipe;
+
+// Wall clock time in milliseconds.
+static double now()
+{
+  using namespace std::chrono;
+  return duration<double, std::milli>(steady_clock::now().time_since_epoch())
+    .count();
+}
+
+// A copy of the document, without the output cached by its pages.
+static Document *uncachedCopy(const Document *doc)
+{
+  Document *copy = new Document(*doc);
+  if (doc->fontPool())
+    copy->setFontPool(new FontPool(*doc->fontPool()));
+  return copy;
+}
+
+// Save the document as PDF in memory, and load it again.  Each run
+// saves an uncached copy.  Reports the best times of several runs.
+static void measure(const Document *doc, uint flags, int repeat,
+		    const char *label)
+{
+  double saveTime = 0.0;
+  double loadTime = 0.0;
+  int size = 0;
+  bool ok = true;
+  for (int r = 0; r < repeat; ++r) {
+    String data;
+    StringStream stream(data);
+    IpeAutoPtr<Document> copy(uncachedCopy(doc));
+    double t0 = now();
+    ok = copy->save(stream, Document::EPdf, flags) && ok;
+    double t1 = now();
+    Buffer buffer(data.data(), data.size());
+    BufferSource source(buffer);
+    int reason;
+    double t2 = now();
+    Document *loaded = Document::load(source, Document::EPdf, reason);
+    double t3 = now();
+    ok = (loaded != 0) && ok;
+    delete loaded;
+    if (r == 0 || t1 - t0 < saveTime)
+      saveTime = t1 - t0;
+    if (r == 0 || t3 - t2 < loadTime)
+      loadTime = t3 - t2;
+    size = data.size();
+  }
+  fprintf(stdout, "%6s %10.1f %12d %10.1f%s\n", label, saveTime, size,
+	  loadTime, ok ? "" : "  (failed)");
+}
+
+// Save the document in XML and as uncompressed PDF, to memory and to
+// a temporary file, and report the output rate of the writers.  Each
+// run saves an uncached copy, and the best time is used.
+static void measureWriters(const Document *doc, uint flags, int repeat)
+{
+  fprintf(stdout, "%6s %6s %12s %10s %8s\n", "writer", "target", "bytes",
+	  "ms", "MB/s");
+  Document::TFormat formats[2] = { Document::EXml, Document::EPdf };
+  const char *names[2] = { "xml", "pdf" };
+  for (int f = 0; f < 2; ++f) {
+    for (int target = 0; target < 2; ++target) {
+      double best = 0.0;
+      long size = 0;
+      bool ok = true;
+      for (int r = 0; r < repeat; ++r) {
+	double t0, t1;
+	IpeAutoPtr<Document> copy(uncachedCopy(doc));
+	if (target == 0) {
+	  String data;
+	  StringStream stream(data);
+	  t0 = now();
+	  ok = copy->save(stream, formats[f], flags | Document::ENoZip) && ok;
+	  t1 = now();
+	  size = data.size();
+	} else {
+	  std::FILE *fd = std::tmpfile();
+	  if (!fd) {
+	    ok = false;
+	    break;
+	  }
+	  FileStream stream(fd);
+	  t0 = now();
+	  ok = copy->save(stream, formats[f], flags | Document::ENoZip) && ok;
+	  std::fflush(fd);
+	  t1 = now();
+	  size = stream.tell();
+	  std::fclose(fd);
+	}
+	if (r == 0 || t1 - t0 < best)
+	  best = t1 - t0;
+      }
+      fprintf(stdout, "%6s %6s %12ld %10.1f %8.1f%s\n", names[f],
+	      target ? "file" : "memory", size, best,
+	      best > 0.0 ? size / best / 1000.0 : 0.0,
+	      ok ? "" : "  (failed)");
+    }
+  }
+}
+
+// The number formatting used by Stream before formatInt and
+// formatDouble, kept here as the reference for the numbers benchmark.
+static int sprintfInt(char *buf, int i)
+{
+  return std::sprintf(buf, "%d", i);
+}
+
+static int sprintfDouble(char *buf, double d)
+{
+  char *p = buf;
+  if (d < 0.0) {
+    *p++ = '-';
+    d = -d;
+  }
+  if (d >= 1e9) {
+    p += std::sprintf(p, "%g", d);
+  } else if (d < 1e-8) {
+    *p++ = '0';
+  } else {
+    int factor;
+    if (d > 1000.0)
+      factor = 100L;
+    else if (d > 100.0)
+      factor = 1000L;
+    else if (d > 10.0)
+      factor = 10000L;
+    else if (d > 1.0)
+      factor = 100000L;
+    else if (d > 0.1)
+      factor = 1000000L;
+    else if (d > 0.01)
+      factor = 10000000L;
+    else
+      factor = 100000000L;
+    double dd = trunc(d);
+    int intpart = int(dd + 0.5);
+    int v = int(factor * (d - dd) + 0.5);
+    if (v >= factor) {
+      ++intpart;
+      v -= factor;
+    }
+    p += std::sprintf(p, "%d", intpart);
+    int mask = factor / 10;
+    if (v != 0) {
+      *p++ = '.';
+      while (v != 0) {
+	*p++ = char('0' + v / mask);
+	v = (10 * v) % factor;
+      }
+    }
+  }
+  return p - buf;
+}
+
+// Format all numbers into one buffer, separated by spaces.  Returns
+// the best time of several runs, and the length of the text in \a len.
+template <class T>
+static double formatAll(const std::vector<T> &numbers, int (*format)(char *, T),
+			std::vector<char> &out, int repeat, int &len)
+{
+  double best = 0.0;
+  int count = int(numbers.size());
+  for (int r = 0; r < repeat; ++r) {
+    char *p = &out[0];
+    double t0 = now();
+    for (int i = 0; i < count; ++i) {
+      p += format(p, numbers[i]);
+      *p++ = ' ';
+    }
+    double t1 = now();
+    len = p - &out[0];
+    if (r == 0 || t1 - t0 < best)
+      best = t1 - t0;
+  }
+  return best;
+}
+
+template <class T>
+static void measureFormat(const char *label, const std::vector<T> &numbers,
+			  int (*format)(char *, T),
+			  int (*reference)(char *, T), int repeat)
+{
+  std::vector<char> out(32 * numbers.size());
+  std::vector<char> ref(32 * numbers.size());
+  int len, reflen;
+  double t = formatAll(numbers, format, out, repeat, len);
+  double tref = formatAll(numbers, reference, ref, repeat, reflen);
+  bool same = (len == reflen && !memcmp(&out[0], &ref[0], len));
+  double count = double(numbers.size());
+  fprintf(stdout, "%8s %10.1f %10.1f %12.1f %10.1f%s\n", label,
+	  count / t / 1000.0, len / t / 1000.0,
+	  count / tref / 1000.0, reflen / tref / 1000.0,
+	  same ? "" : "  (output differs)");
+}
+
+// Format integers and doubles like the coordinates written to XML and
+// PDF streams, with Stream's formatInt and formatDouble and with the
+// old sprintf-based code.  Reports millions of numbers per second and
+// MB per second for both.
+static void measureNumbers(int count, int repeat)
+{
+  std::vector<int> ints(count);
+  std::vector<double> doubles(count);
+  unsigned int seed = 12345;
+  for (int i = 0; i < count; ++i) {
+    seed = seed * 1103515245u + 12345u;
+    unsigned int r = seed >> 8;
+    ints[i] = int(r % 2000) - 1000;
+    // mostly page coordinates, some small and some negative values
+    double d = (r % 6000000) / 1000.0;
+    switch (r % 8) {
+    case 0: d = -d; break;
+    case 1: d /= 1000.0; break;
+    case 2: d = double(int(d)); break;
+    default: break;
+    }
+    doubles[i] = d;
+  }
+  fprintf(stdout, "\nFormatting %d numbers:\n", count);
+  fprintf(stdout, "%8s %10s %10s %12s %10s\n", "", "M/s", "MB/s",
+	  "sprintf M/s", "MB/s");
+  measureFormat<int>("int", ints, &Stream::formatInt, &sprintfInt, repeat);
+  measureFormat<double>("double", doubles, &Stream::formatDouble,
+			&sprintfDouble, repeat);
+}
+
+static void usage()
+{
+  fprintf(stderr,
+	  "Usage: ipebench <options> [ file ... ]\n"
+	  "Ipebench reports the output rate of the XML and PDF writers for\n"
+	  "each document.  It then saves the document as PDF at every\n"
+	  "compression level, and reports the time in milliseconds, the size\n"
+	  "of the output, and the time to load it again.\n"
+	  " -backend <name> : compression backend (zlib or libdeflate).\n"
+	  " -threads <n>    : number of threads creating PDF pages.\n"
+	  " -repeat <n>     : report the best of n runs (default 3).\n"
+	  " -numbers <n>    : report the rate of formatting n numbers.\n"
+	  );
+  exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+  Platform::initLib(IPELIB_VERSION);
+
+  if (argc < 2)
+    usage();
+
+  uint flags = Document::ESaveNormal;
+  int repeat = 3;
+  int numbers = 0;
+  int i = 1;
+  while (i < argc && argv[i][0] == '-') {
+    if (!strcmp(argv[i], "-backend") && i + 1 < argc) {
+      const Compression *backend = 0;
+      if (!strcmp(argv[i+1], "zlib"))
+	backend = Compression::zlib();
+      else if (!strcmp(argv[i+1], "libdeflate"))
+	backend = Compression::libdeflate();
+      if (!backend) {
+	fprintf(stderr, "Compression backend '%s' is not available.\n",
+		argv[i+1]);
+	exit(1);
+      }
+      Compression::setBackend(backend);
+    } else if (!strcmp(argv[i], "-threads") && i + 1 < argc) {
+      int n;
+      if (sscanf(argv[i+1], "%d", &n) != 1 || n < 1 || n > 255)
+	usage();
+      flags |= n * Document::EThreads;
+    } else if (!strcmp(argv[i], "-repeat") && i + 1 < argc) {
+      if (sscanf(argv[i+1], "%d", &repeat) != 1 || repeat < 1)
+	usage();
+    } else if (!strcmp(argv[i], "-numbers") && i + 1 < argc) {
+      if (sscanf(argv[i+1], "%d", &numbers) != 1 || numbers < 1)
+	usage();
+    } else
+      usage();
+    i += 2;
+  }
+  if (i == argc && !numbers)
+    usage();
+
+  if (numbers)
+    measureNumbers(numbers, repeat);
+  if (i == argc)
+    return 0;
+
+  fprintf(stdout, "Compression backend: %s\n",
+	  Compression::backend()->name());
+  for (; i < argc; ++i) {
+    Document *doc = Document::loadWithErrorReport(argv[i]);
+    if (!doc)
+      continue;
+    if (doc->runLatex()) {
+      fprintf(stderr, "Skipping %s.\n", argv[i]);
+      delete doc;
+      continue;
+    }
+    fprintf(stdout, "\n%s: %d pages, %d views\n", argv[i],
+	    doc->countPages(), doc->countTotalViews());
+    measureWriters(doc, flags, repeat);
+    fprintf(stdout, "\n");
+    fprintf(stdout, "%6s %10s %12s %10s\n", "level", "save ms", "bytes",
+	    "load ms");
+    measure(doc, flags | Document::ENoZip, repeat, "none");
+    for (int level = 1; level <= 12; ++level) {
+      char label[8];
+      sprintf(label, "%d", level);
+      measure(doc, flags | level * Document::ECompress, repeat, label);
+    }
+    delete doc;
+  }
+  return 0;
+}
+
+// --------------------------------------------------------------------
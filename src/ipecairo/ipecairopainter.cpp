@@ -341,6 +341,59 @@ void CairoPainter::doDrawBitmap(Bitmap bitmap)
   cairo_restore(iCairo);
 }
 
+// --------------------------------------------------------------------
+
+/* The content stream of an XForm, parsed into a list of instructions
+   with numeric operands.  Fonts and glyphs are resolved for the last
+   few Fonts objects used, so that a canvas and the thumbnails can
+   share the same text objects.  Instructions whose operands are
+   invalid are dropped, as executing them would have no effect. */
+class CairoPainter::CompiledXForm : public Text::MRenderData {
+public:
+  // the operators up to Ere have their operands in iNumbers
+  enum TOp { ECm, ETf, ETd, Erg, ERG, Eg, EG, Ek, EK, Ew, Em, El, Ere,
+	     Eq, EQ, ETJ, Esym, EBT };
+
+  struct Instr {
+    TOp iOp;
+    int iFirst;   // first operand in iNumbers, iStrings, or iChars
+    int iCount;   // number of elements in iChars (for TJ)
+    int iFont;    // font number (for Tf), -1 if not a Latex font
+  };
+
+  // an element of the array of a TJ operator
+  struct Char {
+    int iCode;       // character code, or -1 for a position adjustment
+    double iAdjust;  // the adjustment
+  };
+
+  // fonts and glyphs looked up in one Fonts object
+  struct Resolved {
+    int iStamp;                  // stamp of the Fonts, or 0 if unused
+    int iLastUse;                // value of iUses when last used
+    std::vector<Face *> iFaces;  // font for each Tf and TJ instruction
+    std::vector<int> iGlyphs;    // glyph index for each element of iChars
+    std::vector<int> iWidths;    // width for each element of iChars
+  };
+
+  enum { ESlots = 4 };
+
+  CompiledXForm(const Buffer &stream);
+  int resolve(Fonts *fonts);
+
+private:
+  void compile(String op, const std::vector<const PdfObj *> &args);
+  void addNumbers(TOp op, const std::vector<const PdfObj *> &args, int n);
+
+public:
+  std::vector<Instr> iCode;
+  std::vector<double> iNumbers;
+  std::vector<String> iStrings;
+  std::vector<Char> iChars;
+  Resolved iResolved[ESlots];
+  int iUses;
+};
+
 void CairoPainter::doDrawText(const Text *text)
 {
   // Current origin is lower left corner of text box
@@ -404,7 +457,10 @@ void CairoPainter::doDrawText(const Text *text)
     }
   } else {
     transform(Matrix(xf->iStretch, 0, 0, xf->iStretch, 0, 0));
-    execute(xf->iStream);
+    // the content stream is parsed only once
+    if (!xf->iRender)
+      xf->iRender = new CompiledXForm(xf->iStream);
+    execute(*static_cast<CompiledXForm *>(xf->iRender));
   }
 }
 
@@ -428,165 +484,270 @@ void CairoPainter::DimColor(QColor &col)
 
 // --------------------------------------------------------------------
 
-//! Clear PDF argument stack
-void CairoPainter::clearArgs()
-{
-  while (!iArgs.empty()) {
-    delete iArgs.back();
-    iArgs.pop_back();
-  }
-}
-
-void CairoPainter::execute(const Buffer &buffer)
+CairoPainter::CompiledXForm::CompiledXForm(const Buffer &stream)
 {
-  BufferSource source(buffer);
+  iUses = 0;
+  for (int i = 0; i < ESlots; ++i)
+    iResolved[i].iStamp = iResolved[i].iLastUse = 0;
+  BufferSource source(stream);
   PdfParser parser(source);
-  iFont = 0;
-  iFillRgb[0] = iFillRgb[1] = iFillRgb[2] = 0.0;
-  iStrokeRgb[0] = iStrokeRgb[1] = iStrokeRgb[2] = 0.0;
+  std::vector<const PdfObj *> args;
   while (!parser.eos()) {
     PdfToken tok = parser.token();
     if (tok.iType != PdfToken::EOp) {
       const PdfObj *obj = parser.getObject();
       if (!obj)
 	break; // no further parsing attempted
-      iArgs.push_back(obj);
+      args.push_back(obj);
     } else {
-      // its an operator, execute it
       String op = tok.iString;
       parser.getToken();
-      if (op == "cm")
-	opcm();
-      else if (op == "q")
-	opq();
-      else if (op == "Q")
-	opQ();
-      else if (op == "Tf")
-	opTf();
-      else if (op == "Td")
-	opTd();
-      else if (op == "TJ")
-	opTJ();
-      else if (op == "rg")
-	oprg(false);
-      else if (op == "RG")
-	oprg(true);
-      else if (op == "g")
-	opg(false);
-      else if (op == "G")
-	opg(true);
-      else if (op == "k")
-	opk(false);
-      else if (op == "K")
-	opk(true);
-      else if (op == "w")
-	opw();
-      else if (op == "m")
-	opm();
-      else if (op == "l")
-	opl();
-      else if (op == "re")
-	opre();
-      else if (op == "sym")
-	opsym();
-      else if (op == "BT")
-	opBT();
-      else if (op != "ET") {
-	String a;
-	for (uint i = 0; i < iArgs.size(); ++i)
-	  a += iArgs[i]->repr() + " ";
-	ipeDebug("op %s (%s)", op.z(), a.z());
-      }
-      clearArgs();
+      compile(op, args);
+      for (uint i = 0; i < args.size(); ++i)
+	delete args[i];
+      args.clear();
     }
   }
-  clearArgs();
+  for (uint i = 0; i < args.size(); ++i)
+    delete args[i];
 }
 
-void CairoPainter::opg(bool stroke)
+// Add instruction with n numeric operands.
+void CairoPainter::CompiledXForm::addNumbers(TOp op,
+					     const std::vector<const PdfObj *>
+					     &args, int n)
 {
-  if (iArgs.size() != 1 || !iArgs[0]->number())
+  if (int(args.size()) != n)
     return;
-  double gr = iArgs[0]->number()->value();
+  for (int i = 0; i < n; ++i) {
+    if (!args[i]->number())
+      return;
+  }
+  Instr in;
+  in.iOp = op;
+  in.iFirst = iNumbers.size();
+  in.iCount = 0;
+  in.iFont = -1;
+  for (int i = 0; i < n; ++i)
+    iNumbers.push_back(args[i]->number()->value());
+  iCode.push_back(in);
+}
+
+void CairoPainter::CompiledXForm::compile(String op,
+					  const std::vector<const PdfObj *>
+					  &args)
+{
+  static const struct { const char *iName; TOp iOp; int iArgs; } ops[] = {
+    { "cm", ECm, 6 }, { "q", Eq, 0 }, { "Q", EQ, 0 }, { "Td", ETd, 2 },
+    { "rg", Erg, 3 }, { "RG", ERG, 3 }, { "g", Eg, 1 }, { "G", EG, 1 },
+    { "k", Ek, 4 }, { "K", EK, 4 }, { "w", Ew, 1 }, { "m", Em, 2 },
+    { "l", El, 2 }, { "re", Ere, 4 } };
+
+  for (uint i = 0; i < sizeof(ops) / sizeof(ops[0]); ++i) {
+    if (op == ops[i].iName) {
+      addNumbers(ops[i].iOp, args, ops[i].iArgs);
+      return;
+    }
+  }
+
+  Instr in;
+  in.iFirst = 0;
+  in.iCount = 0;
+  in.iFont = -1;
+  if (op == "BT") {
+    in.iOp = EBT;
+    iCode.push_back(in);
+  } else if (op == "Tf") {
+    if (args.size() != 2 || !args[0]->name() || !args[1]->number())
+      return;
+    String name = args[0]->name()->value();
+    if (name[0] == 'F')
+      in.iFont = Lex(name.substr(1)).getInt();
+    in.iOp = ETf;
+    in.iFirst = iNumbers.size();
+    iNumbers.push_back(args[1]->number()->value());
+    iCode.push_back(in);
+  } else if (op == "TJ") {
+    if (args.size() != 1 || !args[0]->array())
+      return;
+    in.iOp = ETJ;
+    in.iFirst = iChars.size();
+    const PdfArray *arr = args[0]->array();
+    for (int i = 0; i < arr->count(); ++i) {
+      const PdfObj *obj = arr->obj(i, 0);
+      Char c;
+      c.iAdjust = 0.0;
+      if (obj->number()) {
+	c.iCode = -1;
+	c.iAdjust = obj->number()->value();
+	iChars.push_back(c);
+      } else if (obj->string()) {
+	String s = obj->string()->value();
+	for (int j = 0; j < s.size(); ++j) {
+	  c.iCode = uchar(s[j]);
+	  iChars.push_back(c);
+	}
+      }
+    }
+    in.iCount = iChars.size() - in.iFirst;
+    iCode.push_back(in);
+  } else if (op == "sym") {
+    if (args.size() != 5)
+      return;
+    for (int i = 0; i < 5; ++i) {
+      if (!args[i]->string())
+	return;
+    }
+    in.iOp = Esym;
+    in.iFirst = iStrings.size();
+    for (int i = 0; i < 5; ++i)
+      iStrings.push_back(args[i]->string()->value());
+    iCode.push_back(in);
+  } else if (op != "ET") {
+    String a;
+    for (uint i = 0; i < args.size(); ++i)
+      a += args[i]->repr() + " ";
+    ipeDebug("op %s (%s)", op.z(), a.z());
+  }
+}
+
+//! Look up the fonts and glyphs used in \a fonts.
+/*! Returns the slot of iResolved holding them.  If they are not
+  there yet, the slot used least recently is filled. */
+int CairoPainter::CompiledXForm::resolve(Fonts *fonts)
+{
+  ++iUses;
+  int slot = 0;
+  for (int k = 0; k < ESlots; ++k) {
+    if (iResolved[k].iStamp == fonts->stamp()) {
+      iResolved[k].iLastUse = iUses;
+      return k;
+    }
+    if (iResolved[k].iLastUse < iResolved[slot].iLastUse)
+      slot = k;
+  }
+  Resolved &res = iResolved[slot];
+  res.iStamp = fonts->stamp();
+  res.iLastUse = iUses;
+  res.iFaces.assign(iCode.size(), 0);
+  res.iGlyphs.assign(iChars.size(), 0);
+  res.iWidths.assign(iChars.size(), 0);
+  // the font in effect is the one set by the last Tf operator
+  Face *face = 0;
+  for (uint i = 0; i < iCode.size(); ++i) {
+    const Instr &in = iCode[i];
+    if (in.iOp == EBT) {
+      face = 0;
+    } else if (in.iOp == ETf) {
+      if (in.iFont >= 0)
+	face = fonts->getFace(in.iFont);
+      res.iFaces[i] = face;
+    } else if (in.iOp == ETJ) {
+      res.iFaces[i] = face;
+      for (int j = in.iFirst; face && j < in.iFirst + in.iCount; ++j) {
+	if (iChars[j].iCode >= 0) {
+	  res.iGlyphs[j] = face->getGlyph(iChars[j].iCode);
+	  res.iWidths[j] = face->width(iChars[j].iCode);
+	}
+      }
+    }
+  }
+  return slot;
+}
+
+void CairoPainter::execute(CompiledXForm &code)
+{
+  int slot = code.resolve(iFonts);
+  const CompiledXForm::Resolved &res = code.iResolved[slot];
+  iFont = 0;
+  iFillRgb[0] = iFillRgb[1] = iFillRgb[2] = 0.0;
+  iStrokeRgb[0] = iStrokeRgb[1] = iStrokeRgb[2] = 0.0;
+  const double *num = code.iNumbers.empty() ? 0 : &code.iNumbers[0];
+  for (uint i = 0; i < code.iCode.size(); ++i) {
+    const CompiledXForm::Instr &in = code.iCode[i];
+    // iFirst indexes iNumbers only for the numeric operators
+    const double *a = (in.iOp <= CompiledXForm::Ere) ? num + in.iFirst : 0;
+    switch (in.iOp) {
+    case CompiledXForm::ECm: opcm(a); break;
+    case CompiledXForm::Eq: opq(); break;
+    case CompiledXForm::EQ: opQ(); break;
+    case CompiledXForm::ETf: opTf(in.iFont >= 0, res.iFaces[i], a[0]); break;
+    case CompiledXForm::ETd: opTd(a); break;
+    case CompiledXForm::ETJ: opTJ(code, slot, i); break;
+    case CompiledXForm::Erg: oprg(false, a); break;
+    case CompiledXForm::ERG: oprg(true, a); break;
+    case CompiledXForm::Eg: opg(false, a); break;
+    case CompiledXForm::EG: opg(true, a); break;
+    case CompiledXForm::Ek: opk(false); break;
+    case CompiledXForm::EK: opk(true); break;
+    case CompiledXForm::Ew: opw(a); break;
+    case CompiledXForm::Em: opm(a); break;
+    case CompiledXForm::El: opl(a); break;
+    case CompiledXForm::Ere: opre(a); break;
+    case CompiledXForm::Esym: opsym(&code.iStrings[in.iFirst]); break;
+    case CompiledXForm::EBT: opBT(); break;
+    }
+  }
+}
+
+void CairoPainter::opg(bool stroke, const double *a)
+{
   if (stroke)
-    iStrokeRgb[0] = iStrokeRgb[1] = iStrokeRgb[2] = gr;
+    iStrokeRgb[0] = iStrokeRgb[1] = iStrokeRgb[2] = a[0];
   else
-    iFillRgb[0] = iFillRgb[1] = iFillRgb[2] = gr;
+    iFillRgb[0] = iFillRgb[1] = iFillRgb[2] = a[0];
 }
 
 
-void CairoPainter::oprg(bool stroke)
+void CairoPainter::oprg(bool stroke, const double *a)
 {
-  if (iArgs.size() != 3 || !iArgs[0]->number() || !iArgs[1]->number()
-      || !iArgs[2]->number())
-    return;
   double *col = (stroke ? iStrokeRgb : iFillRgb);
   for (int i = 0; i < 3; ++i)
-    col[i] = iArgs[i]->number()->value();
+    col[i] = a[i];
   // Dimcolor?
 }
 
 void CairoPainter::opk(bool stroke)
 {
-  if (iArgs.size() != 4 || !iArgs[0]->number() || !iArgs[1]->number()
-      || !iArgs[2]->number() || !iArgs[3]->number())
-    return;
   // ignore values, but use text object stroke color
   double *col = (stroke ? iStrokeRgb : iFillRgb);
   for (int i = 0; i < 3; ++i)
     col[i] = iTextRgb[i];
 }
 
-void CairoPainter::opcm()
+void CairoPainter::opcm(const double *a)
 {
-  if (iArgs.size() != 6)
-    return;
   Matrix m;
-  for (int i = 0; i < 6; ++i) {
-    if (!iArgs[i]->number())
-      return;
-    m.a[i] = iArgs[i]->number()->value();
-  }
+  for (int i = 0; i < 6; ++i)
+    m.a[i] = a[i];
   transform(m);
 }
 
-void CairoPainter::opw()
+void CairoPainter::opw(const double *a)
 {
-  if (iArgs.size() != 1 || !iArgs[0]->number())
-    return;
-  iLineWid = iArgs[0]->number()->value();
-
+  iLineWid = a[0];
 }
 
 void CairoPainter::opq()
 {
-  if (iArgs.size() != 0)
-    return;
   push();
   pushMatrix();
 }
 
 void CairoPainter::opQ()
 {
-  if (iArgs.size() != 0)
-    return;
   popMatrix();
   pop();
 }
 
-void CairoPainter::opm()
+void CairoPainter::opm(const double *a)
 {
-  if (iArgs.size() != 2 || !iArgs[0]->number() || !iArgs[1]->number())
-    return;
-  Vector t(iArgs[0]->number()->value(), iArgs[1]->number()->value());
-  iMoveTo = t;
+  iMoveTo = Vector(a[0], a[1]);
 }
 
-void CairoPainter::opl()
+void CairoPainter::opl(const double *a)
 {
-  if (iArgs.size() != 2 || !iArgs[0]->number() || !iArgs[1]->number())
-    return;
-  Vector t(iArgs[0]->number()->value(), iArgs[1]->number()->value());
+  Vector t(a[0], a[1]);
 
   cairo_set_source_rgb(iCairo, iStrokeRgb[0], iStrokeRgb[1], iStrokeRgb[2]);
   cairo_set_line_width(iCairo, iLineWid);
@@ -597,15 +758,8 @@ void CairoPainter::opl()
   cairo_stroke(iCairo);
 }
 
-void CairoPainter::opsym()
+void CairoPainter::opsym(const String *s)
 {
-  if (iArgs.size() != 5) return;
-  String s[5];
-  for (int i = 0; i < 5; ++i) {
-    if (!iArgs[i]->string())
-      return;
-    s[i] = iArgs[i]->string()->value();
-  }
   // ipeDebug("render Symbol %s, %s, %s, %s, %s",
   // s[0].z(), s[1].z(), s[2].z(), s[3].z(), s[4].z());
   const Symbol *symbol = cascade()->findSymbol(Attribute(true, s[0]));
@@ -625,13 +779,10 @@ void CairoPainter::opsym()
   }
 }
 
-void CairoPainter::opre()
+void CairoPainter::opre(const double *a)
 {
-  if (iArgs.size() != 4 || !iArgs[0]->number() || !iArgs[1]->number()
-      || !iArgs[2]->number() || !iArgs[3]->number())
-    return;
-  Vector t(iArgs[0]->number()->value(), iArgs[1]->number()->value());
-  Vector wh(iArgs[2]->number()->value(), iArgs[3]->number()->value());
+  Vector t(a[0], a[1]);
+  Vector wh(a[2], a[3]);
 
   cairo_set_source_rgb(iCairo, iFillRgb[0], iFillRgb[1], iFillRgb[2]);
   Vector t1 = matrix() * t;
@@ -646,48 +797,44 @@ void CairoPainter::opBT()
   iTextPos = iTextLinePos = Vector::ZERO;
 }
 
-void CairoPainter::opTf()
+void CairoPainter::opTf(bool valid, Face *font, double size)
 {
-  if (iArgs.size() != 2 || !iArgs[0]->name() || !iArgs[1]->number())
-    return;
-  String name = iArgs[0]->name()->value();
-  iFontSize = iArgs[1]->number()->value();
-  if (name[0] != 'F')
+  iFontSize = size;
+  if (!valid)
     return;
-  int font = Lex(name.substr(1)).getInt();
-  iFont = iFonts->getFace(font);
+  iFont = font;
   iFontMatrix = matrix().linear() * Linear(iFontSize, 0, 0, -iFontSize);
 }
 
-void CairoPainter::opTd()
+void CairoPainter::opTd(const double *a)
 {
-  if (iArgs.size() != 2 || !iArgs[0]->number() || !iArgs[1]->number())
-    return;
-  Vector t(iArgs[0]->number()->value(), iArgs[1]->number()->value());
+  Vector t(a[0], a[1]);
   iTextPos = iTextLinePos = iTextLinePos + t;
 }
 
-void CairoPainter::opTJ()
+void CairoPainter::opTJ(const CompiledXForm &code, int slot, int index)
 {
-  if (!iFont || iArgs.size() != 1 || !iArgs[0]->array())
+  if (!iFont)
     return;
+  const CompiledXForm::Instr &in = code.iCode[index];
+  const CompiledXForm::Resolved &res = code.iResolved[slot];
+  // glyphs were resolved for a different font if a symbol has
+  // changed the font in the meantime
+  bool resolved = (res.iFaces[index] == iFont);
   std::vector<cairo_glyph_t> glyphs;
-  for (int i = 0; i < iArgs[0]->array()->count(); ++i) {
-    const PdfObj *obj = iArgs[0]->array()->obj(i, 0);
-    if (obj->number()) {
-      iTextPos.x -= 0.001 * iFontSize * obj->number()->value();
-    } else if (obj->string()) {
-      String s = obj->string()->value();
-      for (int j = 0; j < s.size(); ++j) {
-	uchar ch = s[j];
-	Vector pt = matrix() * iTextPos;
-	cairo_glyph_t g;
-	g.index = iFont->getGlyph(ch);
-	g.x = pt.x;
-	g.y = pt.y;
-	glyphs.push_back(g);
-	iTextPos.x += 0.001 * iFontSize * iFont->width(ch);
-      }
+  for (int i = in.iFirst; i < in.iFirst + in.iCount; ++i) {
+    const CompiledXForm::Char &c = code.iChars[i];
+    if (c.iCode < 0) {
+      iTextPos.x -= 0.001 * iFontSize * c.iAdjust;
+    } else {
+      Vector pt = matrix() * iTextPos;
+      cairo_glyph_t g;
+      g.index = resolved ? res.iGlyphs[i] : iFont->getGlyph(c.iCode);
+      g.x = pt.x;
+      g.y = pt.y;
+      glyphs.push_back(g);
+      iTextPos.x += 0.001 * iFontSize *
+	(resolved ? res.iWidths[i] : iFont->width(c.iCode));
     }
   }
   drawGlyphs(glyphs);
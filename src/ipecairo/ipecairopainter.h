@@ -43,7 +43,6 @@
 namespace ipe {
 
   class Cascade;
-  class PdfObj;
 
   class CairoPainter : public Painter {
   public:
@@ -69,25 +68,26 @@ namespace ipe {
     virtual void doDrawText(const Text *text);
 
   private:
+    class CompiledXForm;
+
     // void DimColor(QColor &col);
     void drawGlyphs(std::vector<cairo_glyph_t> &glyphs);
-    void execute(const Buffer &buffer);
-    void clearArgs();
-    void opcm();
+    void execute(CompiledXForm &code);
+    void opcm(const double *a);
     void opBT();
-    void opTf();
-    void opTd();
-    void opTJ();
+    void opTf(bool valid, Face *font, double size);
+    void opTd(const double *a);
+    void opTJ(const CompiledXForm &code, int slot, int index);
     void opk(bool stroke);
-    void opg(bool stroke);
-    void oprg(bool stroke);
-    void opw();
-    void opm();
-    void opl();
+    void opg(bool stroke, const double *a);
+    void oprg(bool stroke, const double *a);
+    void opw(const double *a);
+    void opm(const double *a);
+    void opl(const double *a);
     void opq();
     void opQ();
-    void opre();
-    void opsym();
+    void opre(const double *a);
+    void opsym(const String *s);
 
   private:
     Fonts *iFonts;
@@ -100,7 +100,6 @@ namespace ipe {
     bool iAfterMoveTo;
 
     // PDF operator drawing
-    std::vector<const PdfObj *> iArgs;
     double iTextRgb[3];
     double iStrokeRgb[3];
     double iFillRgb[3];
@@ -33,6 +33,8 @@
 #include "ipepdfparser.h"
 #include "ipexml.h"
 
+#include <atomic>
+
 #include <ft2build.h>
 #include FT_FREETYPE_H
 
@@ -296,7 +298,10 @@ Fonts *Fonts::New(const FontPool *fontPool)
 //! Private constructor
 Fonts::Fonts(const FontPool *fontPool) : iFontPool(fontPool)
 {
-  // nothing
+  // stamps are never reused, as compiled XForms keep the glyphs
+  // resolved for several Fonts objects (canvas, thumbnails, iperender)
+  static std::atomic<int> stamp(0);
+  iStamp = ++stamp;
 }
 
 //! Delete all the loaded Faces.
@@ -67,6 +67,8 @@ namespace ipe {
     static Fonts *New(const FontPool *fontPool);
     ~Fonts();
     Face *getFace(int id);
+    //! Return number identifying this Fonts object (never reused).
+    inline int stamp() const { return iStamp; }
     static cairo_font_face_t *screenFont();
     static String freetypeVersion();
 
@@ -75,6 +77,7 @@ namespace ipe {
 
   private:
     const FontPool *iFontPool;
+    int iStamp;
 
     typedef std::list<Face *> FaceSeq;
     FaceSeq iFaces;
@@ -112,13 +112,31 @@ bool StreamParser::parse()
 // write out attributes, but drop 'pdfObject'
 void StreamParser::writeAttributes(const XmlAttributes &attr)
 {
-  for (XmlAttributes::const_iterator it = attr.begin();
-       it != attr.end(); ++it)
-    if (it->first != "pdfObject")
-      fprintf(iOut, " %s=\"%s\"", it->first.z(), it->second.z());
+  for (int i = 0; i < attr.count(); ++i)
+    if (attr.key(i) != "pdfObject")
+      fprintf(iOut, " %s=\"%s\"", attr.key(i).z(), attr.value(i).z());
   fprintf(iOut, ">\n");
 }
 
+// write data in hex, 36 bytes per line
+static void writeHex(std::FILE *out, const Buffer &bits)
+{
+  static const char hexDigit[] = "0123456789abcdef";
+  const char *data = bits.data();
+  const char *fin = data + bits.size();
+  char line[80];
+  while (data != fin) {
+    char *q = line;
+    for (int col = 0; col < 36 && data != fin; ++col) {
+      uchar ch = uchar(*data++);
+      *q++ = hexDigit[ch >> 4];
+      *q++ = hexDigit[ch & 0x0f];
+    }
+    *q++ = '\n';
+    fwrite(line, 1, q - line, out);
+  }
+}
+
 bool StreamParser::parseBitmap()
 {
   XmlAttributes attr;
@@ -129,19 +147,7 @@ bool StreamParser::parseBitmap()
     int objNum = Lex(objNumStr).getInt();
     Buffer bits = image(objNum);
     writeAttributes(attr);
-    // write bits
-    const char *data = bits.data();
-    const char *fin = data + bits.size();
-    int col = 0;
-    while (data != fin) {
-      fprintf(iOut, "%02x", (*data++ & 0xff));
-      if (++col == 36) {
-	fputc('\n', iOut);
-	col = 0;
-      }
-    }
-    if (col > 0)
-      fputc('\n', iOut);
+    writeHex(iOut, bits);
     fprintf(iOut, "</bitmap>\n");
   } else {
     // just write out attributes
@@ -306,34 +312,32 @@ static bool extractPs(DataSource &source, std::FILE *out)
   return false;
 }
 
-static bool extractPdf(DataSource &source, std::FILE *out)
+// Return the dictionary of the Ipe XML stream, or 0.
+static const PdfDict *findXmlStream(const PdfFile &loader)
 {
-  PdfFile loader;
-  if (!loader.parse(source)) {
-    fprintf(stderr, "Error parsing PDF file - probably not an Ipe file.\n");
-    return false;
-  }
-
+  // catalog() cannot be used, as the xref entry of /Root may be wrong
+  const PdfObj *root = loader.trailer()->get("Root", &loader);
+  if (!root || !root->dict())
+    return 0;
   // try ancient format version first (early previews of Ipe 6.0)
-  const PdfObj *obj = loader.catalog()->get("Ipe", &loader);
+  const PdfObj *obj = root->dict()->get("Ipe", &loader);
   if (!obj) {
     obj = loader.object(1);
-    if (!obj || !obj->dict()) {
-      fprintf(stderr, "Input file does not contain an Ipe XML stream.\n");
-      return false;
-    }
-
+    if (!obj || !obj->dict())
+      return 0;
     const PdfObj *type = obj->dict()->get("Type", 0);
-    if (!type || !type->name() || type->name()->value() != "Ipe") {
-      fprintf(stderr, "Input file does not contain an Ipe XML stream.\n");
-      return false;
-    }
+    if (!type || !type->name() || type->name()->value() != "Ipe")
+      return 0;
   }
+  return obj->dict();
+}
 
-  Buffer buffer = obj->dict()->stream();
+static bool extractXml(PdfFile &loader, const PdfDict *ipe, std::FILE *out)
+{
+  Buffer buffer = ipe->stream();
   BufferSource xml(buffer);
 
-  if (obj->dict()->deflated()) {
+  if (ipe->deflated()) {
     InflateSource xml1(xml);
     StreamParserPdf parser(loader, xml1, out);
     return parser.parse();
@@ -343,6 +347,40 @@ static bool extractPdf(DataSource &source, std::FILE *out)
   }
 }
 
+static bool extractPdf(DataSource &source, std::FILE *out)
+{
+  PdfFile loader;
+  if (!loader.parse(source)) {
+    fprintf(stderr, "Error parsing PDF file - probably not an Ipe file.\n");
+    return false;
+  }
+  const PdfDict *ipe = findXmlStream(loader);
+  if (!ipe) {
+    fprintf(stderr, "Input file does not contain an Ipe XML stream.\n");
+    return false;
+  }
+  return extractXml(loader, ipe, out);
+}
+
+//! Extract using the xref table, parsing only the objects needed.
+/*! Returns false if this is not possible, without writing anything.
+  Only files that can be mapped are handled here, as pipes cannot be
+  read a second time. */
+static bool extractPdfFast(const char *fname, std::FILE *out, bool &res)
+{
+  MappedFileSource mapped(fname);
+  if (!mapped.isMapped())
+    return false;
+  PdfFile loader;
+  if (!loader.parse(mapped.data(), mapped.size()))
+    return false;
+  const PdfDict *ipe = findXmlStream(loader);
+  if (!ipe)
+    return false;
+  res = extractXml(loader, ipe, out);
+  return true;
+}
+
 // --------------------------------------------------------------------
 
 static void usage()
@@ -394,8 +432,13 @@ int main(int argc, char *argv[])
     if (!out) {
       fprintf(stderr, "Could not open '%s' for writing.\n", dst.z());
     } else {
-      bool res = (format == EPdf) ?
-	extractPdf(source, out) : extractPs(source, out);
+      bool res;
+      if (format == EPdf) {
+	// the file is scanned completely only if its xref table is broken
+	if (!extractPdfFast(src, out, res))
+	  res = extractPdf(source, out);
+      } else
+	res = extractPs(source, out);
       if (!res)
 	fprintf(stderr, "Error during extraction of XML stream.\n");
       std::fclose(out);
@@ -183,6 +183,11 @@ void Effect::pageDictionary(Stream &stream) const
 
   The Repository is a singleton object.  It is created the first time
   it is used. You obtain access to the repository using get().
+
+  Strings are found through a hash table, so toIndex() takes constant
+  time even with a large number of symbolic names.  The repository can
+  be used from several threads: lookups only take a shared lock, and
+  only adding a new string needs exclusive access.
 */
 
 // pointer to singleton object
@@ -191,17 +196,18 @@ Repository *Repository::singleton = 0;
 //! Constructor.
 Repository::Repository()
 {
+  rehash(256);
   // put certain strings at index 0 .. 7
-  iStrings.push_back("normal");
-  iStrings.push_back("undefined");
-  iStrings.push_back("Background");
-  iStrings.push_back("sym-stroke");
-  iStrings.push_back("sym-fill");
-  iStrings.push_back("sym-pen");
-  iStrings.push_back("arrow/normal(spx)");
-  iStrings.push_back("opaque");
-  iStrings.push_back("arrow/arc(spx)");
-  iStrings.push_back("arrow/farc(spx)");
+  add("normal");
+  add("undefined");
+  add("Background");
+  add("sym-stroke");
+  add("sym-fill");
+  add("sym-pen");
+  add("arrow/normal(spx)");
+  add("opaque");
+  add("arrow/arc(spx)");
+  add("arrow/farc(spx)");
 }
 
 //! Get pointer to singleton Repository.
@@ -214,9 +220,15 @@ Repository *Repository::get()
 }
 
 //! Return string with given index.
+/*! The result is a private copy of the stored string, so that
+  several threads never share the (non-atomic) reference count of the
+  strings in the repository. */
 String Repository::toString(int index) const
 {
-  return iStrings[index];
+  iLock.lockRead();
+  String str(iStrings[index], 0, -1);
+  iLock.unlockRead();
+  return str;
 }
 
 //! Return index of given string.
@@ -224,12 +236,72 @@ String Repository::toString(int index) const
 int Repository::toIndex(String str)
 {
   assert(!str.isEmpty());
-  std::vector<String>::const_iterator it =
-    std::find(iStrings.begin(), iStrings.end(), str);
-  if (it != iStrings.end())
-    return (it - iStrings.begin());
+  uint hash = hashString(str);
+  iLock.lockRead();
+  int index = find(str, hash);
+  iLock.unlockRead();
+  if (index >= 0)
+    return index;
+  iLock.lockWrite();
+  // another thread may have added it in the meantime
+  index = find(str, hash);
+  if (index < 0)
+    index = add(str);
+  iLock.unlockWrite();
+  return index;
+}
+
+//! FNV-1a hash of the string.
+uint Repository::hashString(String str)
+{
+  uint hash = 2166136261u;
+  for (int i = 0; i < str.size(); ++i) {
+    hash ^= uchar(str[i]);
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+//! Look up string in the hash table, return -1 if not present.
+int Repository::find(String str, uint hash) const
+{
+  uint mask = iTable.size() - 1;
+  for (uint slot = hash & mask; iTable[slot] >= 0; slot = (slot + 1) & mask) {
+    if (iStrings[iTable[slot]] == str)
+      return iTable[slot];
+  }
+  return -1;
+}
+
+//! Add a string that is not yet in the repository.
+int Repository::add(String str)
+{
+  int index = iStrings.size();
   iStrings.push_back(str);
-  return iStrings.size() - 1;
+  // keep the table at most half full
+  if (2 * iStrings.size() > iTable.size())
+    rehash(2 * iTable.size());
+  else {
+    uint mask = iTable.size() - 1;
+    uint slot = hashString(str) & mask;
+    while (iTable[slot] >= 0)
+      slot = (slot + 1) & mask;
+    iTable[slot] = index;
+  }
+  return index;
+}
+
+//! Rebuild hash table with \a size slots (a power of two).
+void Repository::rehash(int size)
+{
+  iTable.assign(size, -1);
+  uint mask = size - 1;
+  for (int i = 0; i < int(iStrings.size()); ++i) {
+    uint slot = hashString(iStrings[i]) & mask;
+    while (iTable[slot] >= 0)
+      slot = (slot + 1) & mask;
+    iTable[slot] = i;
+  }
 }
 
 //! Destroy repository object.
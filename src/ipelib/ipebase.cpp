@@ -221,6 +221,14 @@ void String::append(const String &rhs)
   iImp->iSize += n;
 }
 
+//! Append \a len bytes starting at \a data to this string.
+void String::append(const char *data, int len)
+{
+  detach(len);
+  memcpy(iImp->iData + iImp->iSize, data, len);
+  iImp->iSize += len;
+}
+
 //! Append \a ch to this string.
 void String::append(char ch)
 {
@@ -323,15 +331,18 @@ namespace ipe {
   /*! \relates Fixed */
   Stream &operator<<(Stream &stream, const Fixed &f)
   {
-    stream << (f.iValue / 1000);
+    char buf[40];
+    int n = Stream::formatInt(buf, f.iValue / 1000);
     if (f.iValue % 1000) {
-      stream << "." << ((f.iValue / 100) % 10);
+      buf[n++] = '.';
+      n += Stream::formatInt(buf + n, (f.iValue / 100) % 10);
       if (f.iValue % 100) {
-	stream << ((f.iValue / 10) % 10);
+	n += Stream::formatInt(buf + n, (f.iValue / 10) % 10);
 	if (f.iValue % 10)
-	  stream << (f.iValue % 10);
+	  n += Stream::formatInt(buf + n, f.iValue % 10);
       }
     }
+    stream.putRaw(buf, n);
     return stream;
   }
 }
@@ -362,19 +373,45 @@ String Lex::token()
 /*! Skips any whitespace before the token.
   Returns empty string if end of string is reached. */
 String Lex::nextToken()
+{
+  Token tok = nextTokenView();
+  return String(iString, tok.iData - iString.data(), tok.iSize);
+}
+
+//! Return nextTokenView, but without extracting the token.
+Lex::Token Lex::tokenView()
+{
+  int pos = iPos;
+  Token tok = nextTokenView();
+  iPos = pos;
+  return tok;
+}
+
+//! Extract next token, without copying it.
+/*! Skips any whitespace before the token.  Returns an empty token if
+  end of string is reached.  The token refers to the Lex's string and
+  does not allocate memory. */
+Lex::Token Lex::nextTokenView()
 {
   skipWhitespace();
-  uint mark = iPos;
-  while (!(eos() || uchar(iString[iPos]) <= ' '))
+  int mark = iPos;
+  const char *data = iString.data();
+  int size = iString.size();
+  while (iPos < size && uchar(data[iPos]) > ' ')
     ++iPos;
-  return iString.substr(mark, iPos - mark);
+  Token tok;
+  tok.iData = data + mark;
+  tok.iSize = iPos - mark;
+  return tok;
 }
 
 //! Extract integer token (skipping whitespace).
 int Lex::getInt()
 {
-  String str = nextToken();
-  return std::atoi(str.z());
+  Token tok = nextTokenView();
+  int val;
+  parseInt(tok.iData, tok.iData + tok.iSize, val);
+  return val;
 }
 
 inline int hexDigit(int ch)
@@ -401,6 +438,28 @@ int Lex::getHexByte()
   return (hexDigit(ch1) << 4) | hexDigit(ch2);
 }
 
+//! Extract \a length bytes in hex (skipping whitespace).
+/*! This is equivalent to calling getHexByte() \a length times, but
+  much faster on long runs of hex digits. */
+void Lex::getHexBytes(char *out, int length)
+{
+  const char *s = iString.data();
+  int size = iString.size();
+  while (length > 0) {
+    while (length > 0 && iPos + 1 < size
+	   && uchar(s[iPos]) > ' ' && uchar(s[iPos + 1]) > ' ') {
+      *out++ = char((hexDigit(s[iPos]) << 4) | hexDigit(s[iPos + 1]));
+      iPos += 2;
+      --length;
+    }
+    if (length > 0) {
+      // whitespace or end of string
+      *out++ = char(getHexByte());
+      --length;
+    }
+  }
+}
+
 //! Extract hexadecimal token (skipping whitespace).
 unsigned long int Lex::getHexNumber()
 {
@@ -411,24 +470,119 @@ unsigned long int Lex::getHexNumber()
 //! Extract Fixed token (skipping whitespace).
 Fixed Lex::getFixed()
 {
-  String str = nextToken();
-  int i = 0;
-  while (i < str.size() && str[i] != '.')
-    ++i;
-  int integral = std::strtol(str.substr(0, i).z(), 0, 10);
-  int fractional = 0;
-  if (i < str.size()) {
-    String s = (str.substr(i+1) + "000").substr(0, 3);
-    fractional = std::strtol(s.z(), 0, 10);
-  }
-  return Fixed::fromInternal(integral * 1000 + fractional);
+  Token tok = nextTokenView();
+  Fixed val;
+  parseFixed(tok.iData, tok.iData + tok.iSize, val);
+  return val;
 }
 
 //! Extract double token (skipping whitespace).
 double Lex::getDouble()
 {
-  String str = nextToken();
-  return std::atof(str.z());
+  Token tok = nextTokenView();
+  double val;
+  parseDouble(tok.iData, tok.iData + tok.iSize, val);
+  return val;
+}
+
+//! Parse an integer from the characters in [p, fin).
+/*! Accepts an optional sign followed by decimal digits, and stores
+  the value in \a val (zero if there are no digits).  Returns a
+  pointer to the first character not consumed.  Does not allocate
+  memory. */
+const char *Lex::parseInt(const char *p, const char *fin, int &val)
+{
+  const char *q = p;
+  bool neg = false;
+  if (q < fin && (*q == '-' || *q == '+'))
+    neg = (*q++ == '-');
+  const char *digits = q;
+  int v = 0;
+  while (q < fin && '0' <= *q && *q <= '9')
+    v = 10 * v + (*q++ - '0');
+  val = neg ? -v : v;
+  return (q == digits) ? p : q;
+}
+
+//! Parse a Fixed from the characters in [p, fin).
+/*! Only three fractional digits are used, further digits are
+  consumed but ignored.  Returns a pointer to the first character not
+  consumed. */
+const char *Lex::parseFixed(const char *p, const char *fin, Fixed &val)
+{
+  int integral;
+  const char *q = parseInt(p, fin, integral);
+  if (q == p && q < fin && (*q == '-' || *q == '+'))
+    ++q;  // sign without integral part, as in "-.5"
+  int fractional = 0;
+  if (q < fin && *q == '.') {
+    ++q;
+    int mult = 100;
+    while (q < fin && '0' <= *q && *q <= '9') {
+      fractional += mult * (*q++ - '0');
+      mult /= 10;
+    }
+  }
+  val = Fixed::fromInternal(integral * 1000 + fractional);
+  return q;
+}
+
+//! Parse a double from the characters in [p, fin).
+/*! The common case of a decimal number with at most 15 significant
+  digits and no exponent is converted directly (and exactly, since
+  both the digits and the power of ten are representable as doubles).
+  Anything else is handed to strtod.  Returns a pointer to the first
+  character not consumed. */
+const char *Lex::parseDouble(const char *p, const char *fin, double &val)
+{
+  static const double pow10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+  const char *q = p;
+  bool neg = false;
+  if (q < fin && (*q == '-' || *q == '+'))
+    neg = (*q++ == '-');
+  double m = 0.0;
+  int ndigits = 0;
+  int nfrac = 0;
+  while (q < fin && '0' <= *q && *q <= '9') {
+    m = 10.0 * m + (*q++ - '0');
+    ++ndigits;
+  }
+  if (q < fin && *q == '.') {
+    ++q;
+    while (q < fin && '0' <= *q && *q <= '9') {
+      m = 10.0 * m + (*q++ - '0');
+      ++ndigits;
+      ++nfrac;
+    }
+  }
+  bool special = (q < fin && (*q == 'e' || *q == 'E' || *q == 'x' ||
+			      *q == 'X' || *q == 'n' || *q == 'N' ||
+			      *q == 'i' || *q == 'I'));
+  if (ndigits > 0 && ndigits <= 15 && nfrac <= 22 && !special) {
+    val = m / pow10[nfrac];
+    if (neg)
+      val = -val;
+    return q;
+  }
+  // slow path
+  char buf[64];
+  int n = fin - p;
+  if (n < int(sizeof(buf))) {
+    memcpy(buf, p, n);
+    buf[n] = '\0';
+    char *end;
+    val = std::strtod(buf, &end);
+    return p + (end - buf);
+  } else {
+    String s;
+    s.append(p, n);
+    const char *z = s.z();
+    char *end;
+    val = std::strtod(z, &end);
+    return p + (end - z);
+  }
 }
 
 //! Skip over whitespace.
@@ -509,6 +663,97 @@ Buffer &Buffer::operator=(const Buffer &rhs)
 
 // --------------------------------------------------------------------
 
+// 64-bit hash function xxHash64 by Yann Collet (BSD license).
+
+typedef unsigned long long u64;
+
+static const u64 Prime1 = 11400714785074694791ULL;
+static const u64 Prime2 = 14029467366897019727ULL;
+static const u64 Prime3 = 1609587929392839161ULL;
+static const u64 Prime4 = 9650029242287828579ULL;
+static const u64 Prime5 = 2870177450012600261ULL;
+
+static inline u64 rotl(u64 x, int r)
+{
+  return (x << r) | (x >> (64 - r));
+}
+
+static inline u64 read64(const uchar *p)
+{
+  return u64(p[0]) | (u64(p[1]) << 8) | (u64(p[2]) << 16)
+    | (u64(p[3]) << 24) | (u64(p[4]) << 32) | (u64(p[5]) << 40)
+    | (u64(p[6]) << 48) | (u64(p[7]) << 56);
+}
+
+static inline u64 read32(const uchar *p)
+{
+  return u64(p[0]) | (u64(p[1]) << 8) | (u64(p[2]) << 16)
+    | (u64(p[3]) << 24);
+}
+
+static inline u64 hashRound(u64 acc, u64 input)
+{
+  acc += input * Prime2;
+  return rotl(acc, 31) * Prime1;
+}
+
+static inline u64 mergeRound(u64 acc, u64 val)
+{
+  acc ^= hashRound(0, val);
+  return acc * Prime1 + Prime4;
+}
+
+//! Return the 64-bit hash xxHash64 of \a data.
+unsigned long long Buffer::hash64(const char *data, int len,
+				  unsigned long long seed)
+{
+  const uchar *p = (const uchar *) data;
+  const uchar *fin = p + len;
+  u64 h;
+  if (len >= 32) {
+    u64 v1 = seed + Prime1 + Prime2;
+    u64 v2 = seed + Prime2;
+    u64 v3 = seed;
+    u64 v4 = seed - Prime1;
+    while (p + 32 <= fin) {
+      v1 = hashRound(v1, read64(p));
+      v2 = hashRound(v2, read64(p + 8));
+      v3 = hashRound(v3, read64(p + 16));
+      v4 = hashRound(v4, read64(p + 24));
+      p += 32;
+    }
+    h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+    h = mergeRound(h, v1);
+    h = mergeRound(h, v2);
+    h = mergeRound(h, v3);
+    h = mergeRound(h, v4);
+  } else
+    h = seed + Prime5;
+  h += u64(len);
+  while (p + 8 <= fin) {
+    h ^= hashRound(0, read64(p));
+    h = rotl(h, 27) * Prime1 + Prime4;
+    p += 8;
+  }
+  if (p + 4 <= fin) {
+    h ^= read32(p) * Prime1;
+    h = rotl(h, 23) * Prime2 + Prime3;
+    p += 4;
+  }
+  while (p < fin) {
+    h ^= (*p++) * Prime5;
+    h = rotl(h, 11) * Prime1;
+  }
+  h ^= h >> 33;
+  h *= Prime2;
+  h ^= h >> 29;
+  h *= Prime3;
+  h ^= h >> 32;
+  return h;
+}
+
+// --------------------------------------------------------------------
+
 /*! \class ipe::Stream
   \ingroup base
   \brief Abstract base class for output streams.
@@ -546,48 +791,66 @@ void Stream::putRaw(const char *data, int size)
     putChar(data[i]);
 }
 
-//! Output integer.
-Stream &Stream::operator<<(int i)
+//! Format an integer into \a buf.
+/*! The buffer must have room for at least 12 characters.  Returns
+  the number of characters written (the result is not
+  zero-terminated). */
+int Stream::formatInt(char *buf, int i)
 {
-  char buf[30];
-  std::sprintf(buf, "%d", i);
-  *this << buf;
-  return *this;
-}
-
-//! Output double.
-Stream &Stream::operator<<(double d)
+  char tmp[12];
+  unsigned int u = (i < 0) ? 0u - unsigned(i) : unsigned(i);
+  int n = 0;
+  do {
+    tmp[n++] = char('0' + u % 10);
+    u /= 10;
+  } while (u != 0);
+  char *p = buf;
+  if (i < 0)
+    *p++ = '-';
+  while (n > 0)
+    *p++ = tmp[--n];
+  return p - buf;
+}
+
+//! Format a double into \a buf, in the format used by operator<<.
+/*! Prints six significant digits, but omits trailing zeros.  Numbers
+  smaller than 1e-8 in absolute value are written as zero.
+
+  The buffer must have room for at least 32 characters.  Returns the
+  number of characters written (the result is not zero-terminated).
+*/
+int Stream::formatDouble(char *buf, double d)
 {
-  char buf[30];
+  char *p = buf;
   if (d < 0.0) {
-    putChar('-');
+    *p++ = '-';
     d = -d;
   }
   if (d >= 1e9) {
     // PDF will not be able to read this, but we have to write something.
     // Such large numbers should only happen if something is wrong.
-    std::sprintf(buf, "%g", d);
-    putCString(buf);
+    p += std::sprintf(p, "%g", d);
   } else if (d < 1e-8) {
-    putChar('0');
+    *p++ = '0';
   } else {
     // Print six significant digits, but omit trailing zeros.
     // Probably I'll want to have adjustable precision later.
-    int factor;
-    if (d > 1000.0)
-      factor = 100L;
-    else if (d > 100.0)
-      factor = 1000L;
-    else if (d > 10.0)
-      factor = 10000L;
-    else if (d > 1.0)
-      factor = 100000L;
-    else if (d > 0.1)
-      factor = 1000000L;
-    else if (d > 0.01)
-      factor = 10000000L;
-    else
-      factor = 100000000L;
+    int factor, ndigits;
+    if (d > 1000.0) {
+      factor = 100L; ndigits = 2;
+    } else if (d > 100.0) {
+      factor = 1000L; ndigits = 3;
+    } else if (d > 10.0) {
+      factor = 10000L; ndigits = 4;
+    } else if (d > 1.0) {
+      factor = 100000L; ndigits = 5;
+    } else if (d > 0.1) {
+      factor = 1000000L; ndigits = 6;
+    } else if (d > 0.01) {
+      factor = 10000000L; ndigits = 7;
+    } else {
+      factor = 100000000L; ndigits = 8;
+    }
     double dd = trunc(d);
     int intpart = int(dd + 0.5);
     // 10^9 < 2^31
@@ -596,26 +859,48 @@ Stream &Stream::operator<<(double d)
       ++intpart;
       v -= factor;
     }
-    std::sprintf(buf, "%d", intpart);
-    putCString(buf);
-    int mask = factor / 10;
+    p += formatInt(p, intpart);
     if (v != 0) {
-      putChar('.');
-      while (v != 0) {
-	putChar('0' + v / mask);
-	v = (10 * v) % factor;
+      *p++ = '.';
+      // strip trailing zeros, then write remaining digits right-to-left
+      while (v % 10 == 0) {
+	v /= 10;
+	--ndigits;
+      }
+      for (int k = ndigits - 1; k >= 0; --k) {
+	p[k] = char('0' + v % 10);
+	v /= 10;
       }
+      p += ndigits;
     }
   }
+  return p - buf;
+}
+
+//! Output integer.
+Stream &Stream::operator<<(int i)
+{
+  char buf[12];
+  putRaw(buf, formatInt(buf, i));
+  return *this;
+}
+
+//! Output double.
+Stream &Stream::operator<<(double d)
+{
+  char buf[32];
+  putRaw(buf, formatDouble(buf, d));
   return *this;
 }
 
 //! Output byte in hexadecimal.
 void Stream::putHexByte(char b)
 {
-  char buf[3];
-  std::sprintf(buf, "%02x", (b & 0xff));
-  *this << buf;
+  static const char hexDigit[] = "0123456789abcdef";
+  char buf[2];
+  buf[0] = hexDigit[(b >> 4) & 0x0f];
+  buf[1] = hexDigit[b & 0x0f];
+  putRaw(buf, 2);
 }
 
 //! Save a string with XML escaping of &, >, <, ", '.
@@ -698,8 +983,7 @@ void FileStream::putChar(char ch)
 
 void FileStream::putString(String s)
 {
-  for (int i = 0; i < s.size(); ++i)
-    std::fputc(s[i], iFile);
+  std::fwrite(s.data(), 1, s.size(), iFile);
 }
 
 void FileStream::putCString(const char *s)
@@ -709,8 +993,7 @@ void FileStream::putCString(const char *s)
 
 void FileStream::putRaw(const char *data, int size)
 {
-  for (int i = 0; i < size; i++)
-    std::fputc(data[i], iFile);
+  std::fwrite(data, 1, size, iFile);
 }
 
 long FileStream::tell() const
@@ -720,6 +1003,87 @@ long FileStream::tell() const
 
 // --------------------------------------------------------------------
 
+/*! \class ipe::BufferedStream
+  \ingroup base
+  \brief Stream collecting output in a fixed-size buffer.
+
+  Output is collected in a buffer, and only passed on to the
+  underlying stream in large blocks, when the buffer is full or when
+  flush() is called.  This avoids a function call on the underlying
+  stream for every character, number, or small string written.
+
+  The buffer is flushed by close() and by the destructor, but clients
+  should call flush() explicitly before accessing the underlying
+  stream again.
+*/
+
+//! Create buffered stream writing to \a stream.
+/*! \a size is the size of the buffer in bytes. */
+BufferedStream::BufferedStream(TellStream &stream, int size)
+  : iStream(stream), iBuffer(size)
+{
+  iN = 0;
+}
+
+//! Destructor flushes the buffer.
+BufferedStream::~BufferedStream()
+{
+  flush();
+}
+
+//! Write all buffered data to the underlying stream.
+void BufferedStream::flush()
+{
+  if (iN > 0)
+    iStream.putRaw(iBuffer.data(), iN);
+  iN = 0;
+}
+
+void BufferedStream::putChar(char ch)
+{
+  if (iN == iBuffer.size())
+    flush();
+  iBuffer[iN++] = ch;
+}
+
+void BufferedStream::putString(String s)
+{
+  putRaw(s.data(), s.size());
+}
+
+void BufferedStream::putCString(const char *s)
+{
+  putRaw(s, strlen(s));
+}
+
+void BufferedStream::putRaw(const char *data, int size)
+{
+  if (iN + size > iBuffer.size()) {
+    flush();
+    if (size >= iBuffer.size()) {
+      // large blocks are not copied into the buffer
+      iStream.putRaw(data, size);
+      return;
+    }
+  }
+  memcpy(iBuffer.data() + iN, data, size);
+  iN += size;
+}
+
+long BufferedStream::tell() const
+{
+  return iStream.tell() + iN;
+}
+
+//! Flush the buffer and close the underlying stream.
+void BufferedStream::close()
+{
+  flush();
+  iStream.close();
+}
+
+// --------------------------------------------------------------------
+
 /*! \class ipe::DataSource
  * \ingroup base
  * \brief Interface for getting data for parsing.
@@ -731,6 +1095,34 @@ DataSource::~DataSource()
   // nothing
 }
 
+//! Get the next block of data.
+/*! Sets \a data to point to the next block of characters, and returns
+  the number of characters in the block (0 at the end of the data).
+  The source advances past the block.
+
+  Sources that hold their data in memory return a pointer into their
+  own storage, which remains valid as long as the source exists.
+  Other sources copy at most \a size characters into \a buffer and
+  set \a data to \a buffer.
+
+  The default implementation fills \a buffer by calling getChar(), so
+  derived classes need to implement only getChar().  Parsers should
+  use this method instead of getChar() to avoid a virtual function
+  call for every character.
+*/
+int DataSource::getBlock(const char *&data, char *buffer, int size)
+{
+  int n = 0;
+  while (n < size) {
+    int ch = getChar();
+    if (ch == EOF)
+      break;
+    buffer[n++] = char(ch);
+  }
+  data = buffer;
+  return n;
+}
+
 // --------------------------------------------------------------------
 
 /*! \class ipe::FileSource
@@ -749,6 +1141,12 @@ int FileSource::getChar()
   return std::fgetc(iFile);
 }
 
+int FileSource::getBlock(const char *&data, char *buffer, int size)
+{
+  data = buffer;
+  return std::fread(buffer, 1, size, iFile);
+}
+
 /*! \class ipe::BufferSource
   \ingroup base
   \brief Data source for parsing from a buffer.
@@ -767,4 +1165,15 @@ int BufferSource::getChar()
   return uchar(iBuffer[iPos++]);
 }
 
+//! Returns the remaining contents of the buffer in a single block.
+int BufferSource::getBlock(const char *&data, char *, int)
+{
+  int n = iBuffer.size() - iPos;
+  if (n <= 0)
+    return 0;
+  data = iBuffer.data() + iPos;
+  iPos = iBuffer.size();
+  return n;
+}
+
 // --------------------------------------------------------------------
@@ -58,6 +58,10 @@ Bitmap::MRenderData::~MRenderData()
   The bitmap can cache data to speed up rendering. This data can be
   set only once (as the bitmap is conceptually immutable).
 
+  The reference count is updated atomically, so that copies of the
+  same bitmap can be made and destroyed in several threads (as when
+  pages are parsed in parallel).
+
   The bitmap also provides a slot for short-term storage of an "object
   number".  The PDF embedder, for instance, sets it to the PDF object
   number when embedding the bitmap, and can reuse it when "drawing"
@@ -78,17 +82,15 @@ Bitmap::Bitmap(const XmlAttributes &attr, String data)
   iImp->iData = Buffer(length);
   char *p = iImp->iData.data();
   if (attr["encoding"] ==  "base64") {
-    Buffer dbuffer(data.data(), data.size());
-    BufferSource source(dbuffer);
-    Base64Source b64source(source);
-    while (length-- > 0)
-      *p++ = b64source.getChar();
+    int n = Base64Source::decode(data.data(), data.size(), p, length);
+    // missing data reads as EOF
+    while (n < length)
+      p[n++] = char(EOF);
   } else {
     Lex datalex(data);
-    while (length-- > 0)
-      *p++ = char(datalex.getHexByte());
+    datalex.getHexBytes(p, length);
   }
-  computeChecksum();
+  computeHash();
 }
 
 //! Create from XML using external raw data
@@ -97,7 +99,7 @@ Bitmap::Bitmap(const XmlAttributes &attr, Buffer data)
   int length = init(attr);
   assert(length == data.size());
   iImp->iData = data;
-  computeChecksum();
+  computeHash();
 }
 
 int Bitmap::init(const XmlAttributes &attr)
@@ -179,7 +181,7 @@ Bitmap::Bitmap(int width, int height,
     iImp->iFilter = EFlateDecode;
   } else
     iImp->iData = data;
-  computeChecksum();
+  computeHash();
 }
 
 //! Copy constructor.
@@ -188,7 +190,7 @@ Bitmap::Bitmap(const Bitmap &rhs)
 {
   iImp = rhs.iImp;
   if (iImp)
-    iImp->iRefCount++;
+    ++iImp->iRefCount;
 }
 
 //! Destructor.
@@ -209,7 +211,7 @@ Bitmap &Bitmap::operator=(const Bitmap &rhs)
       delete iImp;
     iImp = rhs.iImp;
     if (iImp)
-      iImp->iRefCount++;
+      ++iImp->iRefCount;
   }
   return *this;
 }
@@ -226,6 +228,7 @@ int Bitmap::colorKey() const
 void Bitmap::setColorKey(int key)
 {
   iImp->iColorKey = key;
+  computeHash();
 }
 
 //! Save bitmap in XML stream.
@@ -272,11 +275,8 @@ void Bitmap::saveAsXml(Stream &stream, int id, int pdfObjNum) const
   } else {
     // save data
     stream << " encoding=\"base64\">\n";
-    const char *p = data();
-    const char *fin = p + size();
     Base64Stream b64(stream);
-    while (p != fin)
-      b64.putChar(*p++);
+    b64.putRaw(data(), size());
     b64.close();
     stream << "</bitmap>\n";
   }
@@ -303,30 +303,26 @@ bool Bitmap::equal(Bitmap rhs) const
       iImp->iComponents != rhs.iImp->iComponents ||
       iImp->iColorKey != rhs.iImp->iColorKey ||
       iImp->iFilter != rhs.iImp->iFilter ||
-      iImp->iChecksum != rhs.iImp->iChecksum ||
+      iImp->iHash != rhs.iImp->iHash ||
       iImp->iData.size() != rhs.iImp->iData.size())
     return false;
   // check actual data
-  int len = iImp->iData.size();
-  char *p = iImp->iData.data();
-  char *q = rhs.iImp->iData.data();
-  while (len--) {
-    if (*p++ != *q++)
-      return false;
-  }
-  return true;
+  return !memcmp(iImp->iData.data(), rhs.iImp->iData.data(),
+		 iImp->iData.size());
 }
 
-void Bitmap::computeChecksum()
+// --------------------------------------------------------------------
+
+typedef unsigned long long u64;
+
+//! Compute hash of the data and of everything equal() compares.
+void Bitmap::computeHash()
 {
-  int s = 0;
-  int len = iImp->iData.size();
-  char *p = iImp->iData.data();
-  while (len--) {
-    s = (s & 0x0fffffff) << 3;
-    s += *p++;
-  }
-  iImp->iChecksum = s;
+  u64 seed = u64(iImp->iWidth) | (u64(iImp->iHeight) << 24)
+    | (u64(iImp->iColorSpace) << 48) | (u64(iImp->iFilter) << 52)
+    | (u64(iImp->iBitsPerComponent) << 56);
+  seed ^= u64(uint(iImp->iColorKey)) * 1609587929392839161ULL; // prime
+  iImp->iHash = Buffer::hash64(iImp->iData.data(), iImp->iData.size(), seed);
 }
 
 // --------------------------------------------------------------------
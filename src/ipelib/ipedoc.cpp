@@ -90,17 +90,20 @@ Document::Document()
 Document::~Document()
 {
   for (int i = 0; i < countPages(); ++i)
-    delete page(i);
+    delete iPages[i];
   delete iCascade;
   delete iFontPool;
 }
 
 //! Copy constructor.
+/*! Pages that have not been parsed yet are not parsed by copying. */
 Document::Document(const Document &rhs)
 {
   iCascade = new Cascade(*rhs.iCascade);
   for (int i = 0; i < rhs.countPages(); ++i)
-    iPages.push_back(new Page(*rhs.page(i)));
+    iPages.push_back(rhs.iPages[i] ? new Page(*rhs.iPages[i]) : 0);
+  iPageXml = rhs.iPageXml;
+  iBitmaps = rhs.iBitmaps;
   iProperties = rhs.iProperties;
   iFontPool = 0;
 }
@@ -123,6 +126,8 @@ Document::TFormat Document::fileFormat(DataSource &source)
 {
   String s1 = readLine(source);
   String s2 = readLine(source);
+  if (s1.substr(0, 8) == "\033IPEXML1")  // binary XML
+    return EBinary;
   if (s1.substr(0, 5) == "<?xml" ||
       s1.substr(0, 9) == "<!DOCTYPE" ||
       s1.substr(0, 4) == "<ipe")
@@ -149,6 +154,8 @@ Document::TFormat Document::formatFromFilename(String fn)
   if (fn.size() < 5)
     return Document::EUnknown;
   // fn = fn.toLower();
+  if (fn.right(5) == ".ipeb")
+    return Document::EBinary;
   String s = fn.right(4);
   if (s == ".xml" || s == ".ipe")
     return Document::EXml;
@@ -294,9 +301,10 @@ Buffer PsStreamParser::pdfStream(int objNum)
 
 // --------------------------------------------------------------------
 
-Document *doParse(Document *self, ImlParser &parser, int &reason)
+Document *doParse(Document *self, ImlParser &parser, int &reason,
+		   uint flags)
 {
-  int res = parser.parseDocument(*self);
+  int res = parser.parseDocument(*self, (flags & Document::ELoadLazy));
   if (res) {
     delete self;
     self = 0;
@@ -308,14 +316,14 @@ Document *doParse(Document *self, ImlParser &parser, int &reason)
   return self;
 }
 
-Document *doParseXml(DataSource &source, int &reason)
+Document *doParseXml(DataSource &source, int &reason, uint flags)
 {
   Document *self = new Document;
   ImlParser parser(source);
-  return doParse(self, parser, reason);
+  return doParse(self, parser, reason, flags);
 }
 
-Document *doParsePs(DataSource &source, int &reason)
+Document *doParsePs(DataSource &source, int &reason, uint flags)
 {
   PsSource psSource(source);
   reason = Document::EFileOpenError; // could not find Xml stream
@@ -327,19 +335,16 @@ Document *doParsePs(DataSource &source, int &reason)
     A85Source a85(psSource);
     InflateSource source(a85);
     PsStreamParser parser(source, psSource);
-    return doParse(self, parser, reason);
+    return doParse(self, parser, reason, flags);
   } else {
     PsStreamParser parser(psSource, psSource);
-    return doParse(self, parser, reason);
+    return doParse(self, parser, reason, flags);
   }
 }
 
-Document *doParsePdf(DataSource &source, int &reason)
+static Document *doParsePdfFile(PdfFile &loader, int &reason, uint flags)
 {
-  PdfFile loader;
   reason = Document::ENotAnIpeFile;
-  if (!loader.parse(source))  // could not parse PDF container
-    return 0;
   const PdfObj *obj = loader.object(1);
   // was the object really created by Ipe?
   if (!obj || !obj->dict())
@@ -355,52 +360,89 @@ Document *doParsePdf(DataSource &source, int &reason)
   if (obj->dict()->deflated()) {
     InflateSource xml1(xml);
     PdfStreamParser parser(loader, xml1);
-    return doParse(self, parser, reason);
+    return doParse(self, parser, reason, flags);
   } else {
     PdfStreamParser parser(loader, xml);
-    return doParse(self, parser, reason);
+    return doParse(self, parser, reason, flags);
   }
 }
 
+Document *doParsePdf(DataSource &source, int &reason, uint flags)
+{
+  PdfFile loader;
+  reason = Document::ENotAnIpeFile;
+  if (!loader.parse(source))  // could not parse PDF container
+    return 0;
+  return doParsePdfFile(loader, reason, flags);
+}
+
 //! Construct a document from an input stream.
 /*! Returns 0 if the stream couldn't be parsed, and a reason
   explaining that in \a reason.  If \a reason is positive, it is a
   file (stream) offset where parsing failed.  If \a reason is
   negative, it is an error code, see Document::LoadErrors.
+
+  With the ELoadLazy flag, only the text of each page is kept while
+  loading.  A page is parsed the first time it is accessed using
+  page().  Syntax errors inside pages are then not detected while
+  loading.  A page that cannot be parsed is shown as an empty page,
+  but the document cannot be saved as long as it contains such a page
+  (see brokenPage()), so that the original contents are not
+  overwritten.
 */
 Document *Document::load(DataSource &source, TFormat format,
-			 int &reason)
+			 int &reason, uint flags)
 {
-  if (format == EXml)
-    return doParseXml(source, reason);
+  // ImlParser recognizes binary XML by itself
+  if (format == EXml || format == EBinary)
+    return doParseXml(source, reason, flags);
 
   if (format == EPdf)
-    return doParsePdf(source, reason);
+    return doParsePdf(source, reason, flags);
 
   if (format == EEps)
-    return doParsePs(source, reason);
+    return doParsePs(source, reason, flags);
 
   return 0;
 }
 
-Document *Document::load(const char *fname, int &reason)
+//! Load a document from the file \a fname.
+/*! The file is memory-mapped if possible, otherwise it is read
+  through the C standard library. */
+Document *Document::load(const char *fname, int &reason, uint flags)
 {
   reason = EFileOpenError;
+  MappedFileSource mapped(fname);
+  if (mapped.isOpen()) {
+    TFormat format = fileFormat(mapped);
+    mapped.setPosition(0);
+    if (format == EPdf) {
+      // read only the objects needed, using the xref table
+      PdfFile loader;
+      if (loader.parse(mapped.data(), mapped.size())) {
+	Document *self = doParsePdfFile(loader, reason, flags);
+	if (self || reason != ENotAnIpeFile)
+	  return self;
+	// the xref table may be broken, try again reading all objects
+      }
+    }
+    return load(mapped, format, reason, flags);
+  }
   std::FILE *fd = std::fopen(fname, "rb");
   if (!fd)
     return 0;
   FileSource source(fd);
   TFormat format = fileFormat(source);
   std::rewind(fd);
-  Document *self = load(source, format, reason);
+  Document *self = load(source, format, reason, flags);
   std::fclose(fd);
   return self;
 }
 
-Document *Document::loadWithErrorReport(const char *fname)
+Document *Document::loadWithErrorReport(const char *fname, uint flags)
 {
   int reason;
-  Document *doc = load(fname, reason);
+  Document *doc = load(fname, reason, flags);
   if (doc)
     return doc;
 
@@ -429,42 +471,148 @@ Document *Document::loadWithErrorReport(const char *fname)
 
 // --------------------------------------------------------------------
 
+// Number of threads creating PDF pages requested in the save flags.
+static int saveThreads(uint flags)
+{
+  int n = (flags & Document::EThreadsMask) / Document::EThreads;
+  return (n > 0) ? n : Thread::idealCount();
+}
+
+// Compression level requested in the save flags.
+static int compressLevel(uint flags)
+{
+  if (flags & Document::ENoZip)
+    return 0;
+  int n = (flags & Document::ECompressMask) / Document::ECompress;
+  return (n > 0) ? n : 9;
+}
+
+// Write the document in PDF format.  If previous is not 0, write only
+// an update to be appended to it, and return the fraction of garbage
+// in the updated file.
+static double savePdf(const Document *doc, TellStream &stream, uint flags,
+		      const PdfFile *previous = 0)
+{
+  PdfWriter writer(stream, doc, doc->fontPool(),
+		   (flags & Document::EMarkedView), 0, -1,
+		   compressLevel(flags), previous);
+  writer.createPages(saveThreads(flags), (flags & Document::ELayerForms));
+  writer.createBookmarks();
+  if (!(flags & Document::EExport)) {
+    // all bitmaps have been embedded and carry correct object number
+    int level = compressLevel(flags);
+    if ((flags & Document::EAppend) && level > 0) {
+      // only pages that have changed need to be compressed again
+      String xml;
+      StringStream xmlStream(xml);
+      doc->saveAsDeflatedXml(xmlStream, level);
+      writer.createXmlStream(xml);
+    } else {
+      doc->saveAsXml(writer.startXmlStream(), true);
+      writer.finishXmlStream();
+    }
+  }
+  writer.createTrailer();
+  return writer.garbage();
+}
+
+// Collects an update in memory.  Positions are reported as in the
+// file the update is to be appended to.
+class PendingUpdate : public TellStream {
+public:
+  PendingUpdate(long offset) : iOffset(offset), iStream(iData) { }
+  virtual void putChar(char ch) { iStream.putChar(ch); }
+  virtual void putString(String s) { iStream.putString(s); }
+  virtual void putCString(const char *s) { iStream.putCString(s); }
+  virtual void putRaw(const char *data, int size)
+  { iStream.putRaw(data, size); }
+  virtual long tell() const { return iOffset + iStream.tell(); }
+  const String &data() const { return iData; }
+private:
+  long iOffset;
+  String iData;
+  StringStream iStream;
+};
+
+// Append the changes to the existing PDF file fname.  Returns false if
+// this is not possible, or if more than maxGarbage of the file would
+// then be garbage.  The file must then be written completely.
+static bool appendPdf(const Document *doc, const char *fname, uint flags,
+		      double maxGarbage)
+{
+  MappedFileSource mapped(fname);
+  PdfFile previous;
+  if (!mapped.isOpen() || !previous.parse(mapped.data(), mapped.size()))
+    return false;
+  // the file is only touched once the update is known to be acceptable
+  PendingUpdate update(mapped.size());
+  if (savePdf(doc, update, flags, &previous) > maxGarbage)
+    return false;
+  std::FILE *fd = std::fopen(fname, "r+b");
+  if (!fd)
+    return false;
+  if (std::fseek(fd, 0, SEEK_END) || std::ftell(fd) != mapped.size()) {
+    std::fclose(fd);
+    return false;
+  }
+  const String &data = update.data();
+  bool okay = (std::fwrite(data.data(), 1, data.size(), fd)
+	       == std::size_t(data.size()));
+  okay = !std::fclose(fd) && okay;
+  return okay;
+}
+
 //! Save in a stream.
-/*! Returns true if sucessful.
+/*! Returns true if sucessful.  Fails if a page of a document loaded
+  with ELoadLazy could not be parsed (see brokenPage()).
+
+  The content streams of PDF pages are created by several threads.
+  Their number can be set in \a flags as a multiple of EThreads,
+  otherwise Thread::idealCount() is used.  The output does not depend
+  on the number of threads.
+
+  Streams are compressed at level 9, unless \a flags contains ENoZip
+  or a level from 1 (fastest) to 12 (smallest) as a multiple of
+  ECompress.  Levels above 9 differ only when Ipe uses libdeflate.
+
+  The output is collected in a BufferedStream, and written to \a out
+  in large blocks.
+
+  The EBinary format is the XML representation in binary XML (see
+  XmlParser::compile), with path data already parsed.  It loads
+  faster than XML and is meant for caches and for passing documents
+  between programs, not for interchange with other Ipe versions.
 */
-bool Document::save(TellStream &stream, TFormat format, uint flags) const
+bool Document::save(TellStream &out, TFormat format, uint flags) const
 {
+  if (brokenPage() >= 0)
+    return false;
+
+  BufferedStream stream(out);
+
   if (format == EXml) {
     stream << "<?xml version=\"1.0\"?>\n";
     stream << "<!DOCTYPE ipe SYSTEM \"ipe.dtd\">\n";
     saveAsXml(stream);
+    stream.flush();
     return true;
   }
 
-  int compresslevel = 9;
-  if (flags & ENoZip)
-    compresslevel = 0;
+  if (format == EBinary) {
+    String xml;
+    StringStream xmlStream(xml);
+    saveAsXml(xmlStream);
+    Buffer buffer(xml.data(), xml.size());
+    BufferSource source(buffer);
+    XmlParser parser(source);
+    bool okay = parser.compile(stream);
+    stream.flush();
+    return okay;
+  }
 
   if (format == EPdf) {
-    PdfWriter writer(stream, this, iFontPool, (flags & EMarkedView),
-		     0, -1, compresslevel);
-    writer.createPages();
-    writer.createBookmarks();
-    if (!(flags & EExport)) {
-      String xmlData;
-      StringStream stream(xmlData);
-      if (compresslevel > 0) {
-	DeflateStream dfStream(stream, compresslevel);
-	// all bitmaps have been embedded and carry correct object number
-	saveAsXml(dfStream, true);
-	dfStream.close();
-	writer.createXmlStream(xmlData, true);
-      } else {
-	saveAsXml(stream, true);
-	writer.createXmlStream(xmlData, false);
-      }
-    }
-    writer.createTrailer();
+    savePdf(this, stream, flags);
+    stream.flush();
     return true;
   }
 
@@ -477,16 +625,29 @@ bool Document::save(TellStream &stream, TFormat format, uint flags) const
       return false;
     writer.createPageView(0, 0);
     if (!(flags & EExport))
-      writer.createXml(compresslevel);
+      writer.createXml(compressLevel(flags));
     writer.createTrailer();
+    stream.flush();
     return true;
   }
 
   return false;
 }
 
-bool Document::save(const char *fname, TFormat format, uint flags) const
+/*! If \a flags contains EAppend and \a fname is an existing PDF file,
+  only the objects that have changed are appended to it, as an
+  incremental update.  When more than \a maxGarbage (a fraction) of
+  the updated file is no longer used, the file is written completely
+  instead. */
+bool Document::save(const char *fname, TFormat format, uint flags,
+		    double maxGarbage) const
 {
+  // do not touch the file if the document cannot be saved
+  if (brokenPage() >= 0)
+    return false;
+  if (format == EPdf && (flags & EAppend)
+      && appendPdf(this, fname, flags, maxGarbage))
+    return true;
   std::FILE *fd = std::fopen(fname, "wb");
   if (!fd)
     return false;
@@ -502,31 +663,32 @@ bool Document::exportView(const char *fname, TFormat format, uint flags,
 {
   if (format != EPdf && format != EEps)
     return false;
-
-  int compresslevel = 9;
-  if (flags & ENoZip)
-    compresslevel = 0;
+  if (brokenPage(pno, pno) >= 0)
+    return false;
 
   std::FILE *fd = std::fopen(fname, "wb");
   if (!fd)
     return false;
-  FileStream stream(fd);
+  FileStream file(fd);
+  BufferedStream stream(file);
 
   if (format == EPdf) {
     PdfWriter writer(stream, this, iFontPool, (flags & EMarkedView),
-		     pno, pno, compresslevel);
+		     pno, pno, compressLevel(flags));
     writer.createPageView(pno, vno);
     writer.createTrailer();
   } else {
     // Postscript
     PsWriter writer(stream, this, (flags & ENoColor));
     if (!writer.createHeader(pno, vno)) {
+      stream.flush();
       std::fclose(fd);
       return false;
     }
     writer.createPageView(pno, vno);
     writer.createTrailer();
   }
+  stream.flush();
   std::fclose(fd);
   return true;
 }
@@ -535,17 +697,18 @@ bool Document::exportView(const char *fname, TFormat format, uint flags,
 bool Document::exportPages(const char *fname, uint flags,
 			   int fromPage, int toPage) const
 {
-  int compresslevel = 9;
-  if (flags & ENoZip)
-    compresslevel = 0;
+  if (brokenPage(fromPage, toPage) >= 0)
+    return false;
   std::FILE *fd = std::fopen(fname, "wb");
   if (!fd)
     return false;
-  FileStream stream(fd);
+  FileStream file(fd);
+  BufferedStream stream(file);
   PdfWriter writer(stream, this, iFontPool, (flags & EMarkedView),
-		   fromPage, toPage, compresslevel);
-  writer.createPages();
+		   fromPage, toPage, compressLevel(flags));
+  writer.createPages(saveThreads(flags), (flags & ELayerForms));
   writer.createTrailer();
+  stream.flush();
   std::fclose(fd);
   return true;
 }
@@ -553,9 +716,13 @@ bool Document::exportPages(const char *fname, uint flags,
 // --------------------------------------------------------------------
 
 //! Create a list of all bitmaps in the document.
-void Document::findBitmaps(BitmapFinder &bm) const
+/*! Only pages \a fromPage to \a toPage are scanned (a negative \a
+  toPage means the last page), but all symbols are. */
+void Document::findBitmaps(BitmapFinder &bm, int fromPage, int toPage) const
 {
-  for (int i = 0; i < countPages(); ++i)
+  if (toPage < 0 || toPage >= countPages())
+    toPage = countPages() - 1;
+  for (int i = fromPage; i <= toPage; ++i)
     bm.scanPage(page(i));
   // also need to look at all templates
   AttributeSeq seq;
@@ -567,8 +734,56 @@ void Document::findBitmaps(BitmapFinder &bm) const
   std::sort(bm.iBitmaps.begin(), bm.iBitmaps.end());
 }
 
+//! Collect the character codes used by the text on some pages.
+/*! The text objects in all symbols are scanned as well. */
+void Document::findCharacters(CharacterFinder &cf,
+			      int fromPage, int toPage) const
+{
+  if (toPage < 0 || toPage >= countPages())
+    toPage = countPages() - 1;
+  for (int i = fromPage; i <= toPage; ++i)
+    cf.scanPage(page(i));
+  AttributeSeq seq;
+  iCascade->allNames(ESymbol, seq);
+  for (AttributeSeq::iterator it = seq.begin(); it != seq.end(); ++it) {
+    const Symbol *symbol = iCascade->findSymbol(*it);
+    symbol->iObject->accept(cf);
+  }
+}
+
 //! Save in XML format into an Stream.
 void Document::saveAsXml(Stream &stream, bool usePdfBitmaps) const
+{
+  saveXmlHead(stream, usePdfBitmaps);
+  for (int i = 0; i < countPages(); ++i)
+    page(i)->saveAsXml(stream);
+  stream << "</ipe>\n";
+}
+
+//! Save in XML format as a zlib stream, for embedding in PDF.
+/*! Bitmaps refer to their PDF objects, as in saveAsXml().  The
+  compressed XML of each page is cached (see Page::deflatedXml), so
+  only the pages that have changed since the last call are
+  compressed again.  The result differs from compressing the output
+  of saveAsXml() in a single run, and is a little larger. */
+void Document::saveAsDeflatedXml(Stream &stream, int compressLevel) const
+{
+  std::vector<String> pieces;
+  String head;
+  StringStream headStream(head);
+  saveXmlHead(headStream, true);
+  pieces.push_back(DeflateStream::deflatePiece(head.data(), head.size(),
+					       compressLevel));
+  for (int i = 0; i < countPages(); ++i)
+    pieces.push_back(page(i)->deflatedXml(compressLevel));
+  String tail("</ipe>\n");
+  pieces.push_back(DeflateStream::deflatePiece(tail.data(), tail.size(),
+					       compressLevel));
+  DeflateStream::writePieces(stream, pieces);
+}
+
+// Save everything before the pages.
+void Document::saveXmlHead(Stream &stream, bool usePdfBitmaps) const
 {
   stream << "<ipe version=\"" << ipe::FILE_FORMAT << "\"";
   if (!iProperties.iCreator.empty())
@@ -641,11 +856,6 @@ void Document::saveAsXml(Stream &stream, bool usePdfBitmaps) const
 
   // now save style sheet
   iCascade->saveAsXml(stream);
-
-  // save pages
-  for (int i = 0; i < countPages(); ++i)
-    page(i)->saveAsXml(stream);
-  stream << "</ipe>\n";
 }
 
 // --------------------------------------------------------------------
@@ -767,20 +977,26 @@ int Document::countTotalViews() const
 void Document::insert(int no, Page *page)
 {
   iPages.insert(iPages.begin() + no, page);
+  if (!iPageXml.empty())
+    iPageXml.insert(iPageXml.begin() + no, String());
 }
 
 //! Append a new page.
 void Document::push_back(Page *page)
 {
   iPages.push_back(page);
+  if (!iPageXml.empty())
+    iPageXml.push_back(String());
 }
 
 //! Replace page.
 /*! Returns the original page. */
 Page *Document::set(int no, Page *page)
 {
-  Page *p = iPages[no];
+  Page *p = this->page(no);
   iPages[no] = page;
+  if (!iPageXml.empty())
+    iPageXml[no] = String();
   return p;
 }
 
@@ -788,15 +1004,78 @@ Page *Document::set(int no, Page *page)
 /*! Returns the page that has been removed.  */
 Page *Document::remove(int no)
 {
-  Page *p = iPages[no];
+  Page *p = page(no);
   iPages.erase(iPages.begin() + no);
+  if (!iPageXml.empty())
+    iPageXml.erase(iPageXml.begin() + no);
+  return p;
+}
+
+//! Parse all pages that have not been parsed yet.
+/*! Only needed for documents loaded with ELoadLazy, for instance
+  before several threads access the pages. */
+void Document::materializeAll() const
+{
+  for (int i = 0; i < countPages(); ++i)
+    (void) page(i);
+}
+
+//! Return the first page that could not be parsed.
+/*! Only pages \a fromPage to \a toPage are checked (a negative \a
+  toPage means the last page), and parsed if necessary.  Returns -1
+  if all these pages are fine.
+
+  Only documents loaded with ELoadLazy can contain such pages.  They
+  are shown as empty pages, and the document cannot be saved until
+  they have been replaced using set() or removed.
+*/
+int Document::brokenPage(int fromPage, int toPage) const
+{
+  if (iPageXml.empty())
+    return -1;
+  if (toPage < 0 || toPage >= countPages())
+    toPage = countPages() - 1;
+  for (int i = fromPage; i <= toPage; ++i) {
+    (void) page(i);
+    if (!iPageXml[i].empty())
+      return i;
+  }
+  return -1;
+}
+
+//! Parse page \a no of a document loaded with ELoadLazy.
+/*! If the page cannot be parsed, an empty page is returned in its
+  place, and its text is kept to mark it as broken. */
+Page *Document::materialize(int no) const
+{
+  int errorPos;
+  Page *p = ImlParser::parsePageText(iPageXml[no], iBitmaps, errorPos);
+  if (!p) {
+    ipeDebug("Error parsing page %d at position %d", no + 1, errorPos);
+    iPages[no] = Page::basic();
+    return iPages[no];
+  }
+  iPages[no] = p;
+  iPageXml[no] = String();
   return p;
 }
 
+//! Append a page that will be parsed when it is first used.
+void Document::addUnparsedPage(String xml)
+{
+  if (iPageXml.empty())
+    iPageXml.resize(iPages.size());
+  iPages.push_back(0);
+  iPageXml.push_back(xml);
+}
+
 // --------------------------------------------------------------------
 
 //! Run PdfLatex
-int Document::runLatex(String &texLog)
+/*! Only the text objects on pages \a fromPage to \a toPage are
+  processed (a negative \a toPage means the last page).  Text
+  objects on other pages cannot be rendered afterwards. */
+int Document::runLatex(String &texLog, int fromPage, int toPage)
 {
   texLog = "";
   Latex converter(cascade());
@@ -810,9 +1089,13 @@ int Document::runLatex(String &texLog)
       converter.scanObject(sym->iObject);
   }
 
+  if (toPage < 0 || toPage >= countPages())
+    toPage = countPages() - 1;
   int count = 0;
-  for (int i = 0; i < countPages(); ++i)
+  for (int i = fromPage; i <= toPage; ++i) {
+    page(i)->applyTitleStyle(cascade());
     count = converter.scanPage(page(i));
+  }
   if (count == 0)
     return ErrNoText;
 
@@ -914,6 +1197,14 @@ int Document::runLatex(String &texLog)
   bool okay = (converter.readPdf(source) && converter.updateTextObjects());
   std::fclose(pdfF);
 
+  // symbols are drawn as part of the pages that use them
+  if (converter.symbolsChanged()) {
+    for (int i = 0; i < countPages(); ++i) {
+      if (isMaterialized(i))
+	page(i)->invalidateRendering(-1);
+    }
+  }
+
   if (okay) {
     setFontPool(converter.takeFontPool());
     return ErrNone;
@@ -923,10 +1214,10 @@ int Document::runLatex(String &texLog)
 
 //! Run Pdflatex (suitable for console applications)
 /*! Success/error is reported on stderr. */
-int Document::runLatex()
+int Document::runLatex(int fromPage, int toPage)
 {
   String logFile;
-  switch (runLatex(logFile)) {
+  switch (runLatex(logFile, fromPage, toPage)) {
   case ErrNoText:
     fprintf(stderr, "No text objects in document, no need to run Pdflatex.\n");
     return 0;
@@ -0,0 +1,445 @@
+// --------------------------------------------------------------------
+// Subsetting embedded fonts
+// --------------------------------------------------------------------
+/*
+
+    This file is part of the extensible drawing editor Ipe.
+    Copyright (C) 1993-2014  Otfried Cheong
+
+    Ipe is free software; you can redistribute it and/or modify it
+    under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    As a special exception, you have permission to link Ipe with the
+    CGAL library and distribute executables, as long as you follow the
+    requirements of the Gnu General Public License in regard to all of
+    the software in the executable aside from CGAL.
+
+    Ipe is distributed in the hope that it will be useful, but WITHOUT
+    ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+    or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+    License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Ipe; if not, you can find it at
+    "http://www.gnu.org/copyleft/gpl.html", or write to the Free
+    Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+*/
+
+#include "ipefontpool.h"
+
+#include <cctype>
+#include <set>
+
+using namespace ipe;
+
+// --------------------------------------------------------------------
+
+// glyph names of StandardEncoding, codes 32 to 126
+static const char * const standardAscii[] = {
+  "space", "exclam", "quotedbl", "numbersign", "dollar", "percent",
+  "ampersand", "quoteright", "parenleft", "parenright", "asterisk",
+  "plus", "comma", "hyphen", "period", "slash", "zero", "one", "two",
+  "three", "four", "five", "six", "seven", "eight", "nine", "colon",
+  "semicolon", "less", "equal", "greater", "question", "at", "A", "B",
+  "C", "D", "E", "F", "G", "H", "I", "J", "K", "L", "M", "N", "O", "P",
+  "Q", "R", "S", "T", "U", "V", "W", "X", "Y", "Z", "bracketleft",
+  "backslash", "bracketright", "asciicircum", "underscore", "quoteleft",
+  "a", "b", "c", "d", "e", "f", "g", "h", "i", "j", "k", "l", "m", "n",
+  "o", "p", "q", "r", "s", "t", "u", "v", "w", "x", "y", "z",
+  "braceleft", "bar", "braceright", "asciitilde" };
+
+// glyph names of StandardEncoding above 160
+static const struct { int iCode; const char *iName; } standardHigh[] = {
+  { 161, "exclamdown" }, { 162, "cent" }, { 163, "sterling" },
+  { 164, "fraction" }, { 165, "yen" }, { 166, "florin" },
+  { 167, "section" }, { 168, "currency" }, { 169, "quotesingle" },
+  { 170, "quotedblleft" }, { 171, "guillemotleft" },
+  { 172, "guilsinglleft" }, { 173, "guilsinglright" }, { 174, "fi" },
+  { 175, "fl" }, { 177, "endash" }, { 178, "dagger" },
+  { 179, "daggerdbl" }, { 180, "periodcentered" }, { 182, "paragraph" },
+  { 183, "bullet" }, { 184, "quotesinglbase" }, { 185, "quotedblbase" },
+  { 186, "quotedblright" }, { 187, "guillemotright" },
+  { 188, "ellipsis" }, { 189, "perthousand" }, { 191, "questiondown" },
+  { 193, "grave" }, { 194, "acute" }, { 195, "circumflex" },
+  { 196, "tilde" }, { 197, "macron" }, { 198, "breve" },
+  { 199, "dotaccent" }, { 200, "dieresis" }, { 202, "ring" },
+  { 203, "cedilla" }, { 205, "hungarumlaut" }, { 206, "ogonek" },
+  { 207, "caron" }, { 208, "emdash" }, { 225, "AE" },
+  { 227, "ordfeminine" }, { 232, "Lslash" }, { 233, "Oslash" },
+  { 234, "OE" }, { 235, "ordmasculine" }, { 241, "ae" },
+  { 245, "dotlessi" }, { 248, "lslash" }, { 249, "oslash" },
+  { 250, "oe" }, { 251, "germandbls" }, { 0, 0 } };
+
+//! Glyph name of \a code in StandardEncoding, or 0.
+static const char *standardGlyph(int code)
+{
+  if (32 <= code && code <= 126)
+    return standardAscii[code - 32];
+  for (int i = 0; standardHigh[i].iName; ++i) {
+    if (standardHigh[i].iCode == code)
+      return standardHigh[i].iName;
+  }
+  return 0;
+}
+
+// --------------------------------------------------------------------
+
+const ushort eexecKey = 55665;
+const ushort charStringKey = 4330;
+
+static Buffer decrypt(const char *data, int size, ushort key)
+{
+  Buffer out(size);
+  ushort r = key;
+  for (int i = 0; i < size; ++i) {
+    uchar c = uchar(data[i]);
+    out[i] = char(c ^ (r >> 8));
+    r = ushort((c + r) * 52845u + 22719u);
+  }
+  return out;
+}
+
+static Buffer encrypt(const String &data, ushort key)
+{
+  Buffer out(data.size());
+  ushort r = key;
+  for (int i = 0; i < data.size(); ++i) {
+    uchar c = uchar(data[i] ^ (r >> 8));
+    out[i] = char(c);
+    r = ushort((c + r) * 52845u + 22719u);
+  }
+  return out;
+}
+
+// --------------------------------------------------------------------
+
+static inline bool isSpace(char ch)
+{
+  return (ch == ' ' || ch == '\t' || ch == '\r' || ch == '\n');
+}
+
+// Scans the text parts of a Type1 font program.
+class Type1Scanner {
+public:
+  Type1Scanner(const char *data, int size)
+    : iData(data), iSize(size), iPos(0) { /* nothing */ }
+  bool find(const char *s);
+  void skipSpace();
+  String token();
+  bool number(int &n);
+public:
+  const char *iData;
+  int iSize;
+  int iPos;
+};
+
+//! Move to the next occurrence of \a s.
+bool Type1Scanner::find(const char *s)
+{
+  const char *p = std::search(iData + iPos, iData + iSize,
+			      s, s + std::strlen(s));
+  if (p == iData + iSize)
+    return false;
+  iPos = p - iData;
+  return true;
+}
+
+void Type1Scanner::skipSpace()
+{
+  while (iPos < iSize && isSpace(iData[iPos]))
+    ++iPos;
+}
+
+//! Return the next token.
+/*! A name starts a new token even without space: "dup 32/space put". */
+String Type1Scanner::token()
+{
+  skipSpace();
+  int start = iPos;
+  if (iPos < iSize && iData[iPos] == '/')
+    ++iPos;
+  while (iPos < iSize && !isSpace(iData[iPos]) && iData[iPos] != '/')
+    ++iPos;
+  String s;
+  s.append(iData + start, iPos - start);
+  return s;
+}
+
+bool Type1Scanner::number(int &n)
+{
+  String s = token();
+  if (s.empty() || s.find('.') >= 0)
+    return false;
+  Lex lex(s);
+  n = lex.getInt();
+  return lex.eos();
+}
+
+// --------------------------------------------------------------------
+
+//! Read the built-in encoding from the cleartext part of a Type1 font.
+static bool builtinEncoding(const char *data, int size, String *names)
+{
+  Type1Scanner scan(data, size);
+  if (!scan.find("/Encoding"))
+    return false;
+  scan.iPos += 9;
+  String t = scan.token();
+  if (t == "StandardEncoding") {
+    for (int code = 0; code < 0x100; ++code) {
+      const char *name = standardGlyph(code);
+      if (name)
+	names[code] = name;
+    }
+    return true;
+  }
+  // 256 array 0 1 255 {1 index exch /.notdef put} for
+  // dup 32 /space put ... readonly def
+  while (t != "def" && t != "readonly") {
+    if (t.empty())
+      return false;
+    if (t == "dup") {
+      int code;
+      if (!scan.number(code))
+	return false;
+      String name = scan.token();
+      if (code < 0 || code >= 0x100 || name.size() < 2 || name[0] != '/'
+	  || scan.token() != "put")
+	return false;
+      names[code] = name.substr(1);
+    }
+    t = scan.token();
+  }
+  return true;
+}
+
+//! Find the components of an accented glyph built with 'seac'.
+/*! Returns false if the charstring does not use 'seac'. */
+static bool findSeac(const char *data, int size, int lenIV,
+		     int &base, int &accent)
+{
+  Buffer cs = (lenIV >= 0) ? decrypt(data, size, charStringKey)
+    : Buffer(data, size);
+  std::vector<int> stack;
+  int i = (lenIV >= 0) ? lenIV : 0;
+  while (i < size) {
+    int v = uchar(cs[i++]);
+    if (v >= 32) {
+      if (v <= 246) {
+	stack.push_back(v - 139);
+      } else if (v <= 254) {
+	if (i >= size)
+	  return false;
+	int w = uchar(cs[i++]);
+	stack.push_back(v <= 250 ? (v - 247) * 256 + w + 108 :
+			-(v - 251) * 256 - w - 108);
+      } else {
+	if (i + 4 > size)
+	  return false;
+	int w = (uchar(cs[i]) << 24) | (uchar(cs[i+1]) << 16)
+	  | (uchar(cs[i+2]) << 8) | uchar(cs[i+3]);
+	stack.push_back(w);
+	i += 4;
+      }
+    } else if (v == 12) {
+      if (i >= size)
+	return false;
+      if (cs[i++] == 6 && stack.size() >= 2) {  // seac
+	base = stack[stack.size() - 2];
+	accent = stack[stack.size() - 1];
+	return true;
+      }
+      stack.clear();
+    } else if (v == 14) {  // endchar
+      return false;
+    } else
+      stack.clear();
+  }
+  return false;
+}
+
+//! Replace the value of \a key in a dictionary with one entry per line.
+static String replaceEntry(String dict, String key, String value)
+{
+  String prefix = String("/") + key + " ";
+  String result;
+  int i = 0;
+  while (i < dict.size()) {
+    int j = i;
+    while (j < dict.size() && dict[j] != '\n')
+      ++j;
+    String line = dict.substr(i, j - i);
+    if (line.left(prefix.size()) == prefix)
+      result += prefix + value;
+    else
+      result += line;
+    if (j < dict.size())
+      result += '\n';
+    i = j + 1;
+  }
+  return result;
+}
+
+// --------------------------------------------------------------------
+
+//! A glyph in the /CharStrings dictionary of a Type1 font.
+struct Type1Glyph {
+  String iName;
+  //! Start of the entry in the private part.
+  int iStart;
+  //! Start and size of the charstring.
+  int iData;
+  int iSize;
+};
+
+/*! Create a subset of this font containing only the glyphs needed
+  for the character codes marked in \a used.  Returns false if the
+  font cannot be subset, or would not become smaller.
+
+  The caller must pass all codes used with the font: a glyph that is
+  missing from the subset is not drawn.
+
+  Only embedded Type1 fonts are subset.  The /CharStrings dictionary
+  is reduced to the glyphs for the used codes, the glyphs these are
+  composed of, and /.notdef.  The /Subrs are kept.  */
+bool Font::subset(const std::vector<bool> &used, Font &result) const
+{
+  if (iType != EType1 || iStandardFont || iLength1 <= 0 || iLength2 <= 4
+      || iLength3 < 0 || iLength1 + iLength2 + iLength3 > iStreamData.size())
+    return false;
+
+  const char *clear = iStreamData.data();
+  const char *binary = clear + iLength1;
+  // an encrypted part in hexadecimal form is not supported
+  bool hex = true;
+  for (int i = 0; i < 4; ++i)
+    hex = hex && std::isxdigit(uchar(binary[i]));
+  if (hex)
+    return false;
+
+  // glyph names of the used character codes
+  String builtin[0x100];
+  bool hasBuiltin = builtinEncoding(clear, iLength1, builtin);
+  if (!iHasEncoding && !hasBuiltin)
+    return false;
+  std::set<String> keep;
+  keep.insert(".notdef");
+  for (int code = 0; code < 0x100 && code < int(used.size()); ++code) {
+    if (!used[code])
+      continue;
+    if (iHasEncoding && iEncoding[code] != ".notdef")
+      keep.insert(iEncoding[code]);
+    else if (!builtin[code].empty())
+      keep.insert(builtin[code]);
+  }
+
+  // find the glyphs in the private part
+  Buffer priv = decrypt(binary, iLength2, eexecKey);
+  Type1Scanner scan(priv.data(), priv.size());
+  int lenIV = 4;
+  if (scan.find("/lenIV")) {
+    scan.iPos += 6;
+    if (!scan.number(lenIV))
+      return false;
+  }
+  scan.iPos = 0;
+  if (!scan.find("/CharStrings"))
+    return false;
+  scan.iPos += 12;
+  scan.skipSpace();
+  int countStart = scan.iPos;
+  int count;
+  if (!scan.number(count))
+    return false;
+  int countEnd = scan.iPos;
+  if (!scan.find("/"))
+    return false;
+  std::vector<Type1Glyph> glyphs;
+  for (;;) {
+    scan.skipSpace();
+    if (scan.iPos >= priv.size() || priv[scan.iPos] != '/')
+      break;
+    Type1Glyph g;
+    g.iStart = scan.iPos;
+    g.iName = scan.token().substr(1);
+    if (!scan.number(g.iSize) || g.iSize < 0)
+      return false;
+    scan.token();  // RD or -|
+    g.iData = scan.iPos + 1;
+    scan.iPos = g.iData + g.iSize;
+    if (scan.iPos > priv.size())
+      return false;
+    // the entry ends with ND, |-, or noaccess def.  Several entries
+    // can be on one line.
+    String t = scan.token();
+    if (t == "noaccess")
+      t = scan.token();
+    if (t != "ND" && t != "|-" && t != "def")
+      return false;
+    glyphs.push_back(g);
+  }
+  int tail = scan.iPos;
+  if (glyphs.empty() || scan.token() != "end")
+    return false;
+
+  // add the components of accented glyphs
+  for (uint i = 0; i < glyphs.size(); ++i) {
+    int base, accent;
+    if (keep.count(glyphs[i].iName)
+	&& findSeac(priv.data() + glyphs[i].iData, glyphs[i].iSize, lenIV,
+		    base, accent)) {
+      const char *b = standardGlyph(base);
+      const char *a = standardGlyph(accent);
+      if (!b || !a)
+	return false;
+      keep.insert(b);
+      keep.insert(a);
+    }
+  }
+
+  // write private part with the glyphs to keep
+  String out;
+  out.append(priv.data(), countStart);
+  int kept = 0;
+  String charSet;
+  for (uint i = 0; i < glyphs.size(); ++i) {
+    if (keep.count(glyphs[i].iName)) {
+      ++kept;
+      if (glyphs[i].iName != ".notdef")
+	charSet += String("/") + glyphs[i].iName;
+    }
+  }
+  if (kept == int(glyphs.size()))
+    return false;  // nothing to remove
+  StringStream ss(out);
+  ss << kept;
+  out.append(priv.data() + countEnd, glyphs[0].iStart - countEnd);
+  for (uint i = 0; i < glyphs.size(); ++i) {
+    if (keep.count(glyphs[i].iName)) {
+      int end = (i + 1 < glyphs.size()) ? glyphs[i+1].iStart : tail;
+      out.append(priv.data() + glyphs[i].iStart, end - glyphs[i].iStart);
+    }
+  }
+  out.append(priv.data() + tail, priv.size() - tail);
+
+  Buffer enc = encrypt(out, eexecKey);
+  result = *this;
+  result.iStreamData = Buffer(iLength1 + enc.size() + iLength3);
+  char *p = result.iStreamData.data();
+  std::memcpy(p, clear, iLength1);
+  std::memcpy(p + iLength1, enc.data(), enc.size());
+  std::memcpy(p + iLength1 + enc.size(), binary + iLength2, iLength3);
+  result.iLength2 = enc.size();
+  String length2;
+  StringStream ls(length2);
+  ls << result.iLength2;
+  result.iStreamDict = replaceEntry(iStreamDict, "Length2", length2);
+  result.iFontDescriptor = replaceEntry(iFontDescriptor, "CharSet",
+					String("(") + charSet + ")");
+  return true;
+}
+
+// --------------------------------------------------------------------
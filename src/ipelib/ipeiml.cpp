@@ -71,8 +71,12 @@ Buffer ImlParser::pdfStream(int /* objNum */)
 }
 
 //! Read a complete  document from IML stream.
-/*! Returns an error code. */
-int ImlParser::parseDocument(Document &doc)
+/*! Returns an error code.
+
+  If \a lazy is true, pages are not parsed, but their text is stored
+  in the document to be parsed when the page is first used.
+*/
+int ImlParser::parseDocument(Document &doc, bool lazy)
 {
   Document::SProperties properties = doc.properties();
 
@@ -145,6 +149,21 @@ int ImlParser::parseDocument(Document &doc)
     tag = parseToTag();
   }
 
+  if (lazy && !isBinary()) {
+    while (tag == "page") {
+      String text;
+      if (!takeElement(tag, text))
+	return ESyntaxError;
+      doc.addUnparsedPage(text);
+      tag = parseToTag();
+    }
+    doc.iBitmaps = iBitmaps;
+  } else if (tag == "page" && !isBinary() && Thread::idealCount() > 1) {
+    // with more than one processor, parse pages in parallel
+    if (!parsePages(doc, tag))
+      return ESyntaxError;
+  }
+
   while (tag == "page") {
     // read one page
     Page *page = new Page;
@@ -160,6 +179,147 @@ int ImlParser::parseDocument(Document &doc)
   return ESuccess;
 }
 
+// --------------------------------------------------------------------
+
+// Makes the text of a page available to a parser.
+class StringSource : public DataSource {
+public:
+  StringSource(const String &str) : iString(str), iPos(0) { /* nothing */ }
+  virtual int getChar();
+  virtual int getBlock(const char *&data, char *buffer, int size);
+private:
+  const String &iString;
+  int iPos;
+};
+
+int StringSource::getChar()
+{
+  if (iPos >= iString.size())
+    return EOF;
+  return uchar(iString[iPos++]);
+}
+
+int StringSource::getBlock(const char *&data, char *, int)
+{
+  int n = iString.size() - iPos;
+  if (n <= 0)
+    return 0;
+  data = iString.data() + iPos;
+  iPos = iString.size();
+  return n;
+}
+
+//! Parse the XML text of a single page.
+/*! The text must consist of a \c page element.  Bitmaps used by the
+  page are taken from \a bitmaps.  Returns 0 if the page cannot be
+  parsed, and sets \a errorPos to the position of the error in \a
+  text. */
+Page *ImlParser::parsePageText(const String &text,
+			       const std::vector<std::pair<int, Bitmap> >
+			       &bitmaps, int &errorPos)
+{
+  StringSource source(text);
+  ImlParser parser(source);
+  parser.iBitmaps = bitmaps;
+  IpeAutoPtr<Page> page(new Page);
+  if (parser.parseToTag() != "page" || !parser.parsePage(*page)) {
+    errorPos = parser.parsePosition();
+    return 0;
+  }
+  return page.take();
+}
+
+// A page whose text has been read, but not yet parsed.
+struct PageJob {
+  String iText;
+  int iStart;     // position of the text in the input
+  Page *iPage;    // zero if there was an error
+  int iError;     // error position in iText
+};
+
+// Parses every iStep'th page, starting with page iFirst.
+class PageParser : public Thread {
+public:
+  PageParser(const std::vector<std::pair<int, Bitmap> > &bitmaps,
+	     std::vector<PageJob> &jobs, int first, int step)
+    : iBitmaps(bitmaps), iJobs(jobs), iFirst(first), iStep(step)
+  { /* nothing */ }
+  void parse();
+protected:
+  virtual void run();
+private:
+  const std::vector<std::pair<int, Bitmap> > &iBitmaps;
+  std::vector<PageJob> &iJobs;
+  int iFirst;
+  int iStep;
+};
+
+void PageParser::run()
+{
+  parse();
+}
+
+void PageParser::parse()
+{
+  for (int i = iFirst; i < int(iJobs.size()); i += iStep) {
+    PageJob &job = iJobs[i];
+    job.iPage = ImlParser::parsePageText(job.iText, iBitmaps, job.iError);
+  }
+}
+
+//! Parse a sequence of pages using several threads.
+/*! On calling, stream must be just past the first \c page tag.
+  First the text of all pages is read, then the pages are parsed
+  concurrently.  The pages are appended to \a doc in order.  Returns
+  with \a tag set to the tag following the last page.
+
+  Bitmaps must have been read before calling this.
+*/
+bool ImlParser::parsePages(Document &doc, String &tag)
+{
+  std::vector<PageJob> jobs;
+  while (tag == "page") {
+    jobs.push_back(PageJob());
+    PageJob &job = jobs.back();
+    job.iStart = iPos - 6;  // position of "<page"
+    if (!takeElement(tag, job.iText))
+      return false;
+    tag = parseToTag();
+  }
+
+  int n = Thread::idealCount();
+  if (n > int(jobs.size()))
+    n = jobs.size();
+  std::vector<PageParser *> parsers;
+  for (int k = 0; k < n; ++k)
+    parsers.push_back(new PageParser(iBitmaps, jobs, k, n));
+  // the first share of pages is parsed by this thread
+  for (int k = 1; k < n; ++k) {
+    if (!parsers[k]->start())
+      parsers[k]->parse();
+  }
+  parsers[0]->parse();
+  for (int k = 0; k < n; ++k) {
+    parsers[k]->wait();
+    delete parsers[k];
+  }
+
+  bool okay = true;
+  for (uint i = 0; i < jobs.size(); ++i) {
+    if (okay && !jobs[i].iPage) {
+      iPos = jobs[i].iStart + jobs[i].iError;
+      okay = false;
+    }
+    if (okay)
+      doc.push_back(jobs[i].iPage);
+    else
+      delete jobs[i].iPage;
+  }
+  return okay;
+}
+
+// --------------------------------------------------------------------
+
 //! Parse an Bitmap.
 /*! On calling, stream must be just past \c bitmap. */
 bool ImlParser::parseBitmap()
@@ -172,13 +332,13 @@ bool ImlParser::parseBitmap()
     int objNum = Lex(objNumStr).getInt();
     // ipeDebug("ParseBitmap: objNum = %d", objNum);
     Bitmap bitmap(att, pdfStream(objNum));
-    iBitmaps.push_back(bitmap);
+    iBitmaps.push_back(std::make_pair(bitmap.objNum(), bitmap));
   } else {
     String bits;
     if (!parsePCDATA("bitmap", bits))
       return false;
     Bitmap bitmap(att, bits);
-    iBitmaps.push_back(bitmap);
+    iBitmaps.push_back(std::make_pair(bitmap.objNum(), bitmap));
   }
   return true;
 }
@@ -363,7 +523,8 @@ Object *ImlParser::parseObject(String tag, Page *page,
   if (tag[0] == '/')
     return 0;
 
-  XmlAttributes attr;
+  // reuse attribute storage for all objects
+  XmlAttributes &attr = iAttributes;
   if (!parseAttributes(attr))
     return 0;
 
@@ -398,10 +559,10 @@ Object *ImlParser::parseObject(String tag, Page *page,
   if (tag == "image" && attr.has("bitmap", bitmapId)) {
     int objNum = Lex(bitmapId).getInt();
     Bitmap bitmap;
-    for (std::vector<Bitmap>::const_iterator it = iBitmaps.begin();
-	 it != iBitmaps.end(); ++it) {
-      if (it->objNum() == objNum) {
-	bitmap = *it;
+    for (std::vector<std::pair<int, Bitmap> >::const_iterator it =
+	   iBitmaps.begin(); it != iBitmaps.end(); ++it) {
+      if (it->first == objNum) {
+	bitmap = it->second;
 	break;
       }
     }
@@ -51,6 +51,7 @@ Latex::Latex(const Cascade *sheet)
 {
   iCascade = sheet;
   iFontPool = 0;
+  iSymbolsChanged = false;
 }
 
 //! Destructor.
@@ -81,12 +82,14 @@ public:
   virtual void visitReference(const Reference *obj);
 public:
   bool iTextFound;
+  const Page *iPage;
+  int iObject;
 private:
   Latex::TextList *iList;
 };
 
 TextCollectingVisitor::TextCollectingVisitor(Latex::TextList *list)
-  : iList(list)
+  : iPage(0), iObject(-1), iList(list)
 {
   // nothing
 }
@@ -96,6 +99,8 @@ void TextCollectingVisitor::visitText(const Text *obj)
   Latex::SText s;
   s.iText = obj;
   s.iSize = obj->size();
+  s.iPage = iPage;
+  s.iObject = iObject;
   iList->push_back(s);
   iTextFound = true;
 }
@@ -123,19 +128,19 @@ int Latex::scanObject(const Object *obj)
 }
 
 /*! Scan a page and insert all text objects into Latex's list.
-  Returns total number of text objects found so far. */
-int Latex::scanPage(Page *page)
+  Returns total number of text objects found so far.  The title
+  style must already have been applied to the page (see
+  Page::applyTitleStyle). */
+int Latex::scanPage(const Page *page)
 {
-  page->applyTitleStyle(iCascade);
   TextCollectingVisitor visitor(&iTextObjects);
+  visitor.iPage = page;
   const Text *title = page->titleText();
   if (title)
     title->accept(visitor);
   for (int i = 0; i < page->count(); ++i) {
-    visitor.iTextFound = false;
+    visitor.iObject = i;
     page->object(i)->accept(visitor);
-    if (visitor.iTextFound)
-      page->invalidateBBox(i);
   }
   return iTextObjects.size();
 }
@@ -152,10 +157,11 @@ int Latex::createLatexSource(Stream &stream, String preamble)
 {
   bool ancient = (getenv("IPEANCIENTPDFTEX") != 0);
   int count = 0;
-  stream << "\\pdfcompresslevel0\n"
+  // fast compression, with object streams if Pdftex supports them
+  stream << "\\pdfcompresslevel1\n"
 	 << "\\nonstopmode\n"
 	 << "\\expandafter\\ifx\\csname pdfobjcompresslevel\\endcsname"
-	 << "\\relax\\else\\pdfobjcompresslevel0\\fi\n";
+	 << "\\relax\\else\\pdfminorversion5\\pdfobjcompresslevel2\\fi\n";
   if (!ancient) {
     stream << "\\ifnum\\the\\pdftexversion<140"
 	   << "\\errmessage{Pdftex is too old. "
@@ -283,8 +289,7 @@ bool Latex::getXForm(const PdfObj *xform)
     return false;
   Text::XForm *xf = new Text::XForm;
   iXForms.push_back(xf);
-  assert(!dict->deflated());
-  xf->iStream = dict->stream();
+  xf->iStream = dict->inflate();
   /* Should we check /Matrix and /FormType?
      /Type /XObject
      /Subtype /Form
@@ -506,13 +511,13 @@ bool Latex::getEmbeddedFont(int fno, int objno)
   if (!fontFile || !fontFile->dict() || fontFile->dict()->stream().size() == 0)
     return false;
   assert(font.iStreamData.size() == 0);
-  assert(!fontFile->dict()->deflated());
-  font.iStreamData = fontFile->dict()->stream();
+  font.iStreamData = fontFile->dict()->inflate();
   font.iLength1 = font.iLength2 = font.iLength3 = -1;
   for (int i = 0; i < fontFile->dict()->count(); i++) {
     String key = fontFile->dict()->key(i);
     const PdfObj *data = fontFile->dict()->get(key, &iPdf);
-    if (key != "Length")
+    // the stream data is stored uncompressed
+    if (key != "Length" && key != "Filter" && key != "DecodeParms")
       font.iStreamDict += String("/") + key + " " + data->repr() + "\n";
     if (key == "Length1" && data->number())
       font.iLength1 = int(data->number()->value());
@@ -568,8 +573,23 @@ bool Latex::readPdf(DataSource &source)
   return true;
 }
 
+static bool sameXForm(const Text::XForm *a, const Text::XForm *b)
+{
+  return (a && b && a->iStream.size() == b->iStream.size()
+	  && !std::memcmp(a->iStream.data(), b->iStream.data(),
+			  a->iStream.size())
+	  && a->iBBox.bottomLeft() == b->iBBox.bottomLeft()
+	  && a->iBBox.topRight() == b->iBBox.topRight()
+	  && a->iDepth == b->iDepth && a->iFonts == b->iFonts
+	  && a->iStretch == b->iStretch);
+}
+
 //! Notify all text objects about their updated PDF code.
-/*! Returns true if successful. */
+/*! Returns true if successful.
+
+  The bounding box and the cached output of the page containing a
+  text object are invalidated only if its PDF code has actually
+  changed. */
 bool Latex::updateTextObjects()
 {
   for (TextList::iterator it = iTextObjects.begin();
@@ -582,6 +602,12 @@ bool Latex::updateTextObjects()
       return false;
     Text::XForm *xform = *xf;
     iXForms.erase(xf);
+    if (!sameXForm(it->iText->getXForm(), xform)) {
+      if (it->iPage)
+	it->iPage->invalidateRendering(it->iObject);
+      else
+	iSymbolsChanged = true;
+    }
     it->iText->setXForm(xform);
   }
   return true;
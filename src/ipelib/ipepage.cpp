@@ -68,7 +68,14 @@ using namespace ipe;
   UI), and possibly a transition effect (Acrobat Reader eye candy).
 
   A Page can be copied and assigned.  The operation takes time linear
-  in the number of top-level object on the page.
+  in the number of top-level object on the page.  The cached output
+  described below is not copied.
+
+  The Page caches its XML representation and the content streams of
+  its views, so that saving a document only needs to regenerate the
+  pages that have changed.  All methods modifying the page discard the
+  cache.  If you modify an object on the page directly, you must call
+  invalidateBBox() afterwards.
 
 */
 
@@ -80,6 +87,42 @@ Page::Page() : iTitle()
   iMarked = true;
 }
 
+//! Copy constructor.
+/*! The cached output of \a rhs is not copied, as the objects of the
+  copy may be modified independently. */
+Page::Page(const Page &rhs)
+  : iLayers(rhs.iLayers), iViews(rhs.iViews), iTitle(rhs.iTitle),
+    iTitleObject(rhs.iTitleObject), iObjects(rhs.iObjects),
+    iNotes(rhs.iNotes), iMarked(rhs.iMarked)
+{
+  for (int i = 0; i < 2; ++i) {
+    iUseTitle[i] = rhs.iUseTitle[i];
+    iSection[i] = rhs.iSection[i];
+  }
+  invalidateRendering(-1);
+}
+
+//! Assignment operator.
+/*! The cached output of \a rhs is not copied. */
+Page &Page::operator=(const Page &rhs)
+{
+  if (this != &rhs) {
+    iLayers = rhs.iLayers;
+    iViews = rhs.iViews;
+    iTitle = rhs.iTitle;
+    iTitleObject = rhs.iTitleObject;
+    for (int i = 0; i < 2; ++i) {
+      iUseTitle[i] = rhs.iUseTitle[i];
+      iSection[i] = rhs.iSection[i];
+    }
+    iObjects = rhs.iObjects;
+    iNotes = rhs.iNotes;
+    iMarked = rhs.iMarked;
+    dropCache();
+  }
+  return *this;
+}
+
 //! Create a new empty page with standard settings.
 /*! This is an empty page with layer 'alpha' and a single view. */
 Page *Page::basic()
@@ -95,7 +138,52 @@ Page *Page::basic()
 // --------------------------------------------------------------------
 
 //! save page in XML format.
+/*! The XML representation is cached, and reused by the next call
+  unless the page has been modified in the meantime (or the bitmaps
+  it uses have been renumbered).  Saving a large document where only
+  a few pages have changed is therefore fast. */
 void Page::saveAsXml(Stream &stream) const
+{
+  updateXmlCache();
+  stream << iXmlCache;
+}
+
+//! Return the XML representation as a compressed piece.
+/*! The piece is created by DeflateStream::deflatePiece, and cached
+  like the XML representation itself. */
+String Page::deflatedXml(int compressLevel) const
+{
+  updateXmlCache();
+  if (iXmlDeflated.empty() || iXmlDeflatedLevel != compressLevel) {
+    iXmlDeflated = DeflateStream::deflatePiece(iXmlCache.data(),
+					       iXmlCache.size(),
+					       compressLevel);
+    iXmlDeflatedLevel = compressLevel;
+  }
+  return iXmlDeflated;
+}
+
+void Page::updateXmlCache() const
+{
+  bool valid = !iXmlCache.empty();
+  for (uint i = 0; valid && i < iXmlBitmaps.size(); ++i)
+    valid = (iXmlBitmaps[i].first.objNum() == iXmlBitmaps[i].second);
+  if (!valid) {
+    String xml;
+    StringStream xmlStream(xml);
+    saveXmlUncached(xmlStream);
+    BitmapFinder bm;
+    bm.scanPage(this);
+    iXmlBitmaps.clear();
+    for (uint i = 0; i < bm.iBitmaps.size(); ++i)
+      iXmlBitmaps.push_back(std::make_pair(bm.iBitmaps[i],
+					   bm.iBitmaps[i].objNum()));
+    iXmlCache = xml;
+    iXmlDeflated = String();
+  }
+}
+
+void Page::saveXmlUncached(Stream &stream) const
 {
   stream << "<page";
   if (!title().empty()) {
@@ -176,6 +264,7 @@ void Page::setLocked(int i, bool flag)
 {
   iLayers[i].iFlags &= ~ELocked;
   if (flag) iLayers[i].iFlags |= ELocked;
+  dropCache();
 }
 
 //! Set snapping of layer \a i.
@@ -192,6 +281,7 @@ void Page::addLayer(String name)
   iLayers.back().iVisible.resize(countViews());
   for (int i = 0; i < countViews(); ++i)
     iLayers.back().iVisible[i] = false;
+  dropCache();
 }
 
 //! Find layer with given name.
@@ -256,6 +346,7 @@ void Page::moveLayer(int index, int newIndex)
     }
     it->iLayer = k;
   }
+  dropCache();
 }
 
 //! Removes an empty layer from the page.
@@ -273,6 +364,7 @@ void Page::removeLayer(String name)
       it->iLayer = k-1;
   }
   iLayers.erase(iLayers.begin() + index);
+  dropCache();
 }
 
 //! Rename a layer.
@@ -282,6 +374,7 @@ void Page::renameLayer(String oldName, String newName)
   if (l < 0)
     return;
   iLayers[l].iName = newName;
+  dropCache();
 }
 
 //! Returns a precise bounding box for the artwork on the page.
@@ -333,6 +426,7 @@ void Page::setEffect(int index, Attribute sym)
 {
   assert(sym.isSymbolic());
   iViews[index].iEffect = sym;
+  dropCache();
 }
 
 //! Set active layer of view.
@@ -340,6 +434,7 @@ void Page::setActive(int index, String layer)
 {
   assert(findLayer(layer) >= 0);
   iViews[index].iActive = layer;
+  dropCache();
 }
 
 //! Set visibility of layer \a layer in view \a view.
@@ -348,6 +443,7 @@ void Page::setVisible(int view, String layer, bool vis)
   int index = findLayer(layer);
   assert(index >= 0);
   iLayers[index].iVisible[view] = vis;
+  dropCache();
 }
 
 //! Insert a new view at index \a i.
@@ -358,6 +454,7 @@ void Page::insertView(int i, String active)
   iViews[i].iMarked = false;
   for (int l = 0; l < countLayers(); ++l)
     iLayers[l].iVisible.insert(iLayers[l].iVisible.begin() + i, false);
+  dropCache();
 }
 
 //! Remove the view at index \a i.
@@ -366,6 +463,7 @@ void Page::removeView(int i)
   iViews.erase(iViews.begin() + i);
   for (int l = 0; l < countLayers(); ++l)
     iLayers[l].iVisible.erase(iLayers[l].iVisible.begin() + i);
+  dropCache();
 }
 
 //! Remove all views of this page.
@@ -375,11 +473,13 @@ void Page::clearViews()
   for (LayerSeq::iterator it = iLayers.begin();
        it != iLayers.end(); ++it)
     it->iVisible.clear();
+  dropCache();
 }
 
 void Page::setMarkedView(int index, bool marked)
 {
   iViews[index].iMarked = marked;
+  dropCache();
 }
 
 int Page::countMarkedViews() const
@@ -441,6 +541,7 @@ void Page::insert(int i, TSelect select, int layer, Object *obj)
   s.iSelect = select;
   s.iLayer = layer;
   s.iObject = obj;
+  dropCache();
 }
 
 //! Append a new object.
@@ -452,12 +553,14 @@ void Page::append(TSelect select, int layer, Object *obj)
   s.iSelect = select;
   s.iLayer = layer;
   s.iObject = obj;
+  dropCache();
 }
 
 //! Remove the object at index \a i.
 void Page::remove(int i)
 {
   iObjects.erase(iObjects.begin() + i);
+  dropCache();
 }
 
 //! Replace the object at index \a i.
@@ -490,9 +593,37 @@ void Page::transform(int i, const Matrix &m)
 }
 
 //! Invalidate the bounding box at index \a i (the object is somehow changed).
+/*! This also discards the cached output of the page.  Call it
+  whenever an object of the page has been modified in place. */
 void Page::invalidateBBox(int i) const
 {
   iObjects[i].iBBox.clear();
+  dropCache();
+}
+
+//! The rendering of the object at index \a i has changed.
+/*! This is used when the object itself is unchanged, but it will look
+  different, for instance because Latex has produced new output for
+  its text.  Invalidates the bounding box and the cached view output,
+  but keeps the cached XML representation.  If \a i is negative, only
+  the cached view output is discarded. */
+void Page::invalidateRendering(int i) const
+{
+  if (i >= 0)
+    iObjects[i].iBBox.clear();
+  for (ViewSeq::const_iterator it = iViews.begin(); it != iViews.end(); ++it) {
+    it->iCacheKey = String();
+    it->iCache = String();
+  }
+}
+
+//! Discard all cached output of the page.
+void Page::dropCache() const
+{
+  iXmlCache = String();
+  iXmlBitmaps.clear();
+  iXmlDeflated = String();
+  invalidateRendering(-1);
 }
 
 //! Return a bounding box for the object at index \a i.
@@ -543,6 +674,8 @@ bool Page::setAttribute(int i, Property prop, Attribute value,
   bool changed = object(i)->setAttribute(prop, value, stroke, fill);
   if (changed && (prop == EPropTextSize || prop == EPropTransformations))
     invalidateBBox(i);
+  else if (changed)
+    dropCache();
   return changed;
 }
 
@@ -568,6 +701,7 @@ void Page::setSection(int level, bool useTitle, String name)
 {
   iUseTitle[level] = useTitle;
   iSection[level] = useTitle ? String() : name;
+  dropCache();
 }
 
 //! Set the title of this page.
@@ -576,6 +710,7 @@ void Page::setTitle(String title)
 {
   iTitle = title;
   iTitleObject.setText(String("\\PageTitle{") + title + "}");
+  dropCache();
 }
 
 //! Return title of this page.
@@ -588,12 +723,14 @@ String Page::title() const
 void Page::setNotes(String notes)
 {
   iNotes = notes;
+  dropCache();
 }
 
 //! Set if page is marked for printing.
 void Page::setMarked(bool marked)
 {
   iMarked = marked;
+  dropCache();
 }
 
 //! Return Text object representing the title text.
@@ -602,7 +739,8 @@ void Page::setMarked(bool marked)
 */
 const Text *Page::titleText() const
 {
-  if (title().empty())
+  // no copy of the title, as several threads may call this
+  if (iTitle.empty())
     return 0;
   return &iTitleObject;
 }
@@ -615,11 +753,42 @@ void Page::applyTitleStyle(const Cascade *sheet)
   const StyleSheet::TitleStyle *ts = sheet->findTitleStyle();
   if (!ts)
     return;
+  // keep the XForm of the title if the style has not changed
+  if (iTitleObject.matrix() == Matrix(ts->iPos) &&
+      iTitleObject.size() == ts->iSize &&
+      iTitleObject.stroke() == ts->iColor &&
+      iTitleObject.horizontalAlignment() == ts->iHorizontalAlignment &&
+      iTitleObject.verticalAlignment() == ts->iVerticalAlignment)
+    return;
   iTitleObject.setMatrix(Matrix(ts->iPos));
   iTitleObject.setSize(ts->iSize);
   iTitleObject.setStroke(ts->iColor);
   iTitleObject.setHorizontalAlignment(ts->iHorizontalAlignment);
   iTitleObject.setVerticalAlignment(ts->iVerticalAlignment);
+  invalidateRendering(-1);
+}
+
+// --------------------------------------------------------------------
+
+//! Return the cached output of view \a view.
+/*! Returns an empty string if nothing has been cached for this view,
+  if the page has been modified since, or if the output was cached
+  under a different \a key.  The key describes everything outside the
+  page that the output depends on.
+
+  PdfWriter uses this to keep the compressed content streams. */
+String Page::cachedView(int view, String key) const
+{
+  if (iViews[view].iCacheKey == key)
+    return iViews[view].iCache;
+  return String();
+}
+
+//! Cache \a data as the output of view \a view under \a key.
+void Page::setCachedView(int view, String key, String data) const
+{
+  iViews[view].iCacheKey = key;
+  iViews[view].iCache = data;
 }
 
 // --------------------------------------------------------------------
@@ -60,14 +60,18 @@ static char specialChars[256] = {
 
 // --------------------------------------------------------------------
 
-inline int toInt(String &s)
+inline int toInt(const String &s)
 {
-  return std::strtol(s.z(), 0, 10);
+  int val;
+  Lex::parseInt(s.data(), s.data() + s.size(), val);
+  return val;
 }
 
-inline double toDouble(String &s)
+inline double toDouble(const String &s)
 {
-  return std::strtod(s.z(), 0);
+  double val;
+  Lex::parseDouble(s.data(), s.data() + s.size(), val);
+  return val;
 }
 
 // --------------------------------------------------------------------
@@ -157,6 +161,10 @@ const PdfString *PdfString::string() const { return this; }
 
 void PdfString::write(Stream &stream) const
 {
+  if (iBinary) {
+    stream << "<" << iValue << ">";
+    return;
+  }
   char octbuf[5];
   stream << "(";
   for (int i = 0; i < iValue.size(); ++i) {
@@ -320,30 +328,73 @@ bool PdfDict::deflated() const
   return !(!f || !f->name() || f->name()->value() != "FlateDecode");
 }
 
-#if 0
 //! Return the (uncompressed) stream data.
-/*! This only handles the /Flate compression. */
-Buffer PdfDict::Inflate() const
+/*! This only handles the /Flate compression, with or without a PNG
+  predictor.  Streams without a filter are returned unchanged. */
+Buffer PdfDict::inflate() const
 {
-  if (iStream.size() == 0)
+  if (iStream.size() == 0 || !deflated())
     return iStream;
-  const PdfObj *f = get("Filter", 0);
-  if (!f || !f->Name() || f->Name()->Value() != "FlateDecode")
-    return iStream;
-
-  String dest;
 
-  BufferSource bsource(iStream);
-  InflateSource source(bsource);
-
-  int ch = source.getChar();
-  while (ch != EOF) {
-    dest += char(ch);
-    ch = source.getChar();
+  Buffer dest = Compression::backend()->inflate(iStream.data(),
+						iStream.size());
+
+  int predictor = 1;
+  int colors = 1;
+  int bits = 8;
+  int columns = 1;
+  const PdfObj *parms = get("DecodeParms", 0);
+  if (parms && parms->dict()) {
+    const PdfObj *p = parms->dict()->get("Predictor", 0);
+    if (p && p->number())
+      predictor = int(p->number()->value());
+    p = parms->dict()->get("Colors", 0);
+    if (p && p->number())
+      colors = int(p->number()->value());
+    p = parms->dict()->get("BitsPerComponent", 0);
+    if (p && p->number())
+      bits = int(p->number()->value());
+    p = parms->dict()->get("Columns", 0);
+    if (p && p->number())
+      columns = int(p->number()->value());
+  }
+  if (predictor < 10 || colors < 1 || bits < 1 || columns < 1)
+    return dest;
+
+  // PNG predictor: each row is preceded by a byte giving its filter type
+  int bpp = (colors * bits + 7) / 8;
+  int width = (columns * colors * bits + 7) / 8;
+  int rows = dest.size() / (width + 1);
+  Buffer out(rows * width);
+  const uchar *in = (const uchar *) dest.data();
+  uchar *q = (uchar *) out.data();
+  for (int row = 0; row < rows; ++row) {
+    int type = *in++;
+    const uchar *up = (row > 0) ? q - width : 0;
+    for (int i = 0; i < width; ++i) {
+      int a = (i >= bpp) ? q[i - bpp] : 0;
+      int b = up ? up[i] : 0;
+      int c = (up && i >= bpp) ? up[i - bpp] : 0;
+      int x = in[i];
+      switch (type) {
+      case 1: x += a; break;
+      case 2: x += b; break;
+      case 3: x += (a + b) / 2; break;
+      case 4: {
+	int pa = std::abs(b - c);
+	int pb = std::abs(a - c);
+	int pc = std::abs(a + b - 2 * c);
+	x += (pa <= pb && pa <= pc) ? a : (pb <= pc) ? b : c; }
+	break;
+      default: break;
+      }
+      q[i] = uchar(x);
+    }
+    in += width;
+    q += width;
   }
-  return Buffer(dest.data(), dest.size());
+  return out;
 }
-#endif
 
 // --------------------------------------------------------------------
 
@@ -356,24 +407,65 @@ Buffer PdfDict::Inflate() const
  by Ipe for loading, and to extract information from PDF files created
  by Pdflatex.
 
- The parser reads a PDF file sequentially from front to back, ignores
- the contents of 'xref' sections, stores only generation 0 objects,
- and stops after reading the first 'trailer' section (so it cannot
- deal with files with incremental updates).  It cannot handle stream
- objects whose /Length entry has been deferred (using an indirect
- object).
+ The parser reads a PDF file sequentially from front to back, and
+ ignores the contents of 'xref' sections as well as generation
+ numbers: objects are identified by their number alone, and later
+ objects replace earlier ones with the same number (see
+ PdfFile::parse).  When the /Length entry
+ of a stream has been deferred (using an indirect object), the parser
+ looks up the length in the PdfFile given to the constructor.  Without
+ a PdfFile, such a stream cannot be read.
 
 */
 
 //! Construct with a data source.
-PdfParser::PdfParser(DataSource &source)
-  : iSource(source)
+/*! The parser reads the source in blocks, using
+  DataSource::getBlock(), so it may read ahead of the current parse
+  position.  Indirect stream lengths are looked up in \a file, if
+  it is not zero. */
+PdfParser::PdfParser(DataSource &source, const PdfFile *file)
+  : iSource(source), iFile(file), iBuffer(0x2000)
 {
   iPos = 0;
+  iP = iFin = 0;
   getChar();  // init iCh
   getToken(); // init iTok
 }
 
+//! Get the next block of data from the source.
+/*! Returns false if the source is exhausted. */
+bool PdfParser::fillBuffer()
+{
+  int n = iSource.getBlock(iP, iBuffer.data(), iBuffer.size());
+  if (n <= 0) {
+    iP = iFin = 0;
+    return false;
+  }
+  iFin = iP + n;
+  return true;
+}
+
+//! Copy \a n bytes, starting with the current character, to \a p.
+/*! Afterwards, the current character is the one following these bytes.
+  Missing bytes at the end of the data are set to zero. */
+void PdfParser::getBytes(char *p, int n)
+{
+  if (n <= 0)
+    return;
+  *p++ = char(iCh);
+  --n;
+  while (n > 0 && (iP < iFin || fillBuffer())) {
+    int k = std::min(n, int(iFin - iP));
+    memcpy(p, iP, k);
+    iP += k;
+    iPos += k;
+    p += k;
+    n -= k;
+  }
+  memset(p, 0, n);
+  getChar();
+}
+
 //! Skip white space and comments.
 void PdfParser::skipWhiteSpace()
 {
@@ -392,6 +484,7 @@ void PdfParser::getToken()
 {
   iTok.iString.erase();
   iTok.iType = PdfToken::EErr;
+  iTok.iBinary = false;
   skipWhiteSpace();
   if (eos())
     return; // Err
@@ -422,7 +515,16 @@ void PdfParser::getToken()
 	  buf[i] = '\0';
 	  iTok.iString.append(char(std::strtol(buf, 0, 8)));
 	} else {
-	  iTok.iString.append(char(iCh));
+	  char ch = char(iCh);
+	  switch (iCh) {
+	  case 'n': ch = '\n'; break;
+	  case 'r': ch = '\r'; break;
+	  case 't': ch = '\t'; break;
+	  case 'b': ch = '\b'; break;
+	  case 'f': ch = '\f'; break;
+	  default: break;
+	  }
+	  iTok.iString.append(ch);
 	  getChar();
 	}
       } else {
@@ -457,6 +559,7 @@ void PdfParser::getToken()
     // We don't bother to decode it
     getChar(); // skip '>'
     iTok.iType = PdfToken::EString;
+    iTok.iBinary = true;
     ipeDebug("Found binary string <%s>", iTok.iString.z());
     return;
   }
@@ -484,11 +587,16 @@ void PdfParser::getToken()
     return;
   }
 
-  // collect all characters up to white-space or separator
-  while (!specialChars[iCh]) {
-    if (eos())
-      return; // Err
+  // collect all characters up to white-space, separator, or the end
+  while (!eos() && !specialChars[iCh]) {
     iTok.iString.append(char(iCh));
+    // take the rest of the run inside the current block in one piece
+    const char *q = iP;
+    while (q < iFin && !specialChars[uchar(*q)])
+      ++q;
+    iTok.iString.append(iP, q - iP);
+    iPos += q - iP;
+    iP = q;
     getChar();
   }
 
@@ -561,18 +669,15 @@ PdfDict *PdfParser::makeDict()
 	getChar();
       getChar(); // skip '\n'
       // now at beginning of stream
-      const PdfObj *len = dict->get("Length", 0);
-      if (!len || !len->number())
+      const PdfObj *len = dict->get("Length", iFile);
+      if (len && len->number()) {
+	int bytes = int(len->number()->value());
+	Buffer buf(bytes);
+	getBytes(buf.data(), bytes);
+	dict->setStream(buf);
+	getToken();
+      } else
 	return 0;
-      int bytes = int(len->number()->value());
-      Buffer buf(bytes);
-      char *p = buf.data();
-      while (bytes--) {
-	*p++ = char(iCh);
-	getChar();
-      }
-      dict->setStream(buf);
-      getToken();
       if (iTok.iType != PdfToken::EOp || iTok.iString != "endstream")
 	return 0;
       getToken();
@@ -616,9 +721,9 @@ PdfObj *PdfParser::getObject()
 
   switch (tok.iType) {
   case PdfToken::ENumber:
-    return new PdfNumber(std::strtod(tok.iString.z(), 0));
+    return new PdfNumber(toDouble(tok.iString));
   case PdfToken::EString:
-    return new PdfString(tok.iString);
+    return new PdfString(tok.iString, tok.iBinary);
   case PdfToken::EName:
     return new PdfName(tok.iString.substr(1));
   case PdfToken::ENull:
@@ -641,8 +746,8 @@ PdfObj *PdfParser::getObject()
 //! Parse an object definition (current token is object number).
 PdfObj *PdfParser::getObjectDef()
 {
-  getToken();
-  if (iTok.iType != PdfToken::ENumber || iTok.iString != "0")
+  getToken();  // generation number
+  if (iTok.iType != PdfToken::ENumber)
     return 0;
   getToken();
   if (iTok.iType != PdfToken::EOp || iTok.iString != "obj")
@@ -660,15 +765,14 @@ PdfObj *PdfParser::getObjectDef()
 //! Skip xref table (current token is 'xref')
 void PdfParser::skipXRef()
 {
-  getToken(); // first object number
-  getToken(); // number of objects
-  int k = toInt(iTok.iString);
   getToken();
-  while (k--) {
-    getToken(); // obj num
-    getToken(); // gen num
-    getToken(); // n or f
-  }
+  // The table can have several subsections.  Their headers are not
+  // trusted, as the table may be damaged, so all numbers and entry
+  // types are skipped.
+  while (iTok.iType == PdfToken::ENumber
+	 || (iTok.iType == PdfToken::EOp
+	     && (iTok.iString == "n" || iTok.iString == "f")))
+    getToken();
 }
 
 //! Parse trailer dictionary (current token is 'trailer')
@@ -683,31 +787,107 @@ PdfDict *PdfParser::getTrailer()
 
 // --------------------------------------------------------------------
 
+// Makes PDF data in memory available to a PdfParser.
+class PdfMemorySource : public DataSource {
+public:
+  PdfMemorySource(const char *data, int size)
+    : iData(data), iSize(size), iPos(0) { /* nothing */ }
+  virtual int getChar();
+  virtual int getBlock(const char *&data, char *buffer, int size);
+private:
+  const char *iData;
+  int iSize;
+  int iPos;
+};
+
+int PdfMemorySource::getChar()
+{
+  if (iPos >= iSize)
+    return EOF;
+  return uchar(iData[iPos++]);
+}
+
+int PdfMemorySource::getBlock(const char *&data, char *, int)
+{
+  int n = iSize - iPos;
+  if (n <= 0)
+    return 0;
+  data = iData + iPos;
+  iPos = iSize;
+  return n;
+}
+
+// --------------------------------------------------------------------
+
 /*! \class ipe::PdfFile
  * \ingroup base
  * \brief All information obtained by parsing a PDF file.
+
+ A PdfFile is either filled by parsing the entire file sequentially
+ (parse(DataSource &)), or it reads only the cross-reference table of
+ a file in memory (parse(const char *, int)) and parses objects when
+ they are first accessed.
+
+ Both cross-reference tables and cross-reference streams are
+ understood, and objects stored in compressed object streams are
+ extracted when needed (PDF 1.5).
  */
 
 //! Create empty container.
 PdfFile::PdfFile()
 {
   iTrailer = 0;
+  iData = 0;
+  iSize = 0;
+  iLastXRef = -1;
 }
 
 // Destroy all the objects from the file.
 PdfFile::~PdfFile()
+{
+  clear();
+}
+
+void PdfFile::clear()
 {
   delete iTrailer;
+  iTrailer = 0;
   std::map<int, const PdfObj *>::const_iterator it;
   for (it = iObjects.begin(); it != iObjects.end(); ++it) {
     delete it->second;
   }
+  iObjects.clear();
+  iXRef.clear();
+  iData = 0;
+  iSize = 0;
+  iLastXRef = -1;
+}
+
+// Largest object number allowed by the PDF specification.
+static const int maxObjNum = 8388607;
+
+// Is this a plausible subsection of a cross-reference table, with at
+// most maxCount entries?  The values come from the file, so they are
+// checked before the table is resized.
+static bool validSubsection(int first, int count, int maxCount)
+{
+  return (first >= 0 && count >= 0 && count <= maxCount
+	  && first <= maxObjNum - count);
+}
+
+static bool hasType(const PdfObj *obj, const char *type)
+{
+  if (!obj || !obj->dict())
+    return false;
+  const PdfObj *t = obj->dict()->get("Type", 0);
+  return (t && t->name() && t->name()->value() == type);
 }
 
 //! Parse entire PDF stream, and store objects.
 bool PdfFile::parse(DataSource &source)
 {
   PdfParser parser(source);
+  int xrefStream = -1;
 
   for (;;) {
     PdfToken t = parser.token();
@@ -720,39 +900,369 @@ bool PdfFile::parse(DataSource &source)
 	ipeDebug("Failed to get object %d", num);
 	return false;
       }
+      // objects in an incremental update replace earlier versions
+      std::map<int, const PdfObj *>::iterator it = iObjects.find(num);
+      if (it != iObjects.end())
+	delete it->second;
       iObjects[num] = obj;
+      if (hasType(obj, "XRef"))
+	xrefStream = num;
     } else if (t.iType == PdfToken::EOp) {
       if (t.iString == "trailer") {
+	delete iTrailer;
 	iTrailer = parser.getTrailer();
 	if (!iTrailer) {
 	  ipeDebug("Failed to get trailer");
 	  return false;
 	}
-	return true;
+	xrefStream = -1;
       } else if (t.iString == "xref") {
 	parser.skipXRef();
+      } else if (t.iString == "startxref") {
+	parser.getToken();
+	parser.getToken();
+      } else if (iTrailer) {
+	break;  // ignore a damaged update
       } else {
 	ipeDebug("Weird token: %s", t.iString.z());
 	// don't know what's happening
 	return false;
       }
+    } else if (t.iType == PdfToken::EErr && parser.eos() && xrefStream >= 0) {
+      // the dictionary of the cross-reference stream is the trailer
+      delete iTrailer;
+      iTrailer = iObjects[xrefStream]->dict();
+      iObjects.erase(xrefStream);
+      break;
+    } else if (t.iType == PdfToken::EErr && parser.eos() && iTrailer) {
+      break;
     } else {
       ipeDebug("Weird token type: %d %s", t.iType, t.iString.z());
       // don't know what's happening
       return false;
     }
   }
+
+  // extract the objects stored in object streams
+  std::vector<int> streams;
+  std::map<int, const PdfObj *>::const_iterator it;
+  for (it = iObjects.begin(); it != iObjects.end(); ++it) {
+    if (hasType(it->second, "ObjStm"))
+      streams.push_back(it->first);
+  }
+  for (int i = 0; i < int(streams.size()); ++i) {
+    if (!readObjectStream(streams[i])) {
+      ipeDebug("Failed to read object stream %d", streams[i]);
+      return false;
+    }
+  }
+  return true;
+}
+
+//! Read the cross-reference table of a PDF file in memory.
+/*! Only the cross-reference table and the trailer are read, objects
+  are parsed when they are accessed using object().  The \a data must
+  remain valid as long as the PdfFile is used.
+
+  Returns false if the file has no valid cross-reference table (it
+  may still be possible to read it using parse(DataSource &)). */
+bool PdfFile::parse(const char *data, int size)
+{
+  clear();
+  // find 'startxref' near the end of the file
+  int i = size - 9;
+  while (i >= 0 && i >= size - 1024
+	 && std::memcmp(data + i, "startxref", 9))
+    --i;
+  if (i < 0 || i < size - 1024)
+    return false;
+  i += 9;
+  while (i < size && specialChars[uchar(data[i])] == 1)
+    ++i;
+  int offset = 0;
+  while (i < size && '0' <= data[i] && data[i] <= '9')
+    offset = 10 * offset + (data[i++] - '0');
+
+  iData = data;
+  iSize = size;
+  iLastXRef = offset;
+  // follow the chain of cross-reference tables of incremental updates
+  int sections = 0;
+  while (offset >= 0) {
+    if (++sections > 100 || !readXRef(offset, offset)) {
+      ipeDebug("Failed to read xref table at %d", offset);
+      clear();
+      return false;
+    }
+  }
+  return true;
+}
+
+//! Read the xref table at \a offset, and return offset of the previous one.
+/*! The table can be a classic cross-reference table or a
+  cross-reference stream.  Entries of tables read earlier (that is,
+  more recent ones) take precedence. */
+bool PdfFile::readXRef(int offset, int &prev)
+{
+  if (offset <= 0 || offset >= iSize)
+    return false;
+  PdfMemorySource source(iData + offset, iSize - offset);
+  PdfParser parser(source);
+  const PdfDict *trailer = 0;
+  if (parser.token().iType == PdfToken::ENumber) {
+    // cross-reference stream
+    PdfObj *obj = parser.getObjectDef();
+    if (!hasType(obj, "XRef") || !readXRefStream(obj->dict())) {
+      delete obj;
+      return false;
+    }
+    trailer = obj->dict();
+  } else {
+    if (parser.token().iType != PdfToken::EOp
+	|| parser.token().iString != "xref")
+      return false;
+    parser.getToken();
+    // free entries are marked last, as a hybrid file lists the
+    // compressed objects as free, and in its XRefStm stream
+    std::vector<int> freeObjects;
+    while (parser.token().iType == PdfToken::ENumber) {
+      int first = toInt(parser.token().iString);
+      parser.getToken();
+      if (parser.token().iType != PdfToken::ENumber)
+	return false;
+      int count = toInt(parser.token().iString);
+      parser.getToken();
+      // each entry takes 20 bytes
+      if (!validSubsection(first, count, (iSize - offset) / 20))
+	return false;
+      if (first + count > int(iXRef.size())) {
+	XRef unknown = { -1, 0, 0 };
+	iXRef.resize(first + count, unknown);
+      }
+      for (int num = first; num < first + count; ++num) {
+	PdfToken pos = parser.token();
+	parser.getToken();
+	PdfToken gen = parser.token();
+	parser.getToken();
+	PdfToken type = parser.token();
+	parser.getToken();
+	if (pos.iType != PdfToken::ENumber || gen.iType != PdfToken::ENumber
+	    || type.iType != PdfToken::EOp)
+	  return false;
+	if (iXRef[num].iType < 0) {
+	  iXRef[num].iGen = toInt(gen.iString);
+	  if (type.iString == "n") {
+	    iXRef[num].iType = 1;
+	    iXRef[num].iOffset = toInt(pos.iString);
+	  } else
+	    freeObjects.push_back(num);
+	}
+      }
+    }
+    if (parser.token().iType != PdfToken::EOp
+	|| parser.token().iString != "trailer")
+      return false;
+    trailer = parser.getTrailer();
+    if (!trailer)
+      return false;
+    const PdfObj *stm = trailer->get("XRefStm", 0);
+    if (stm && stm->number()) {
+      int next;
+      if (!readXRef(int(stm->number()->value()), next)) {
+	delete trailer;
+	return false;
+      }
+    }
+    for (int i = 0; i < int(freeObjects.size()); ++i) {
+      if (iXRef[freeObjects[i]].iType < 0)
+	iXRef[freeObjects[i]].iType = 0;
+    }
+  }
+  const PdfObj *p = trailer->get("Prev", 0);
+  prev = (p && p->number()) ? int(p->number()->value()) : -1;
+  if (iTrailer)
+    delete trailer;
+  else
+    iTrailer = trailer;
+  return true;
+}
+
+//! Read the entries of a cross-reference stream.
+bool PdfFile::readXRefStream(const PdfDict *dict)
+{
+  const PdfObj *w = dict->get("W", 0);
+  if (!w || !w->array() || w->array()->count() != 3)
+    return false;
+  int width[3];
+  for (int i = 0; i < 3; ++i) {
+    const PdfObj *obj = w->array()->obj(i, 0);
+    if (!obj->number())
+      return false;
+    width[i] = int(obj->number()->value());
+    if (width[i] < 0 || width[i] > 4)
+      return false;
+  }
+  int entrySize = width[0] + width[1] + width[2];
+  if (entrySize == 0)
+    return false;
+  std::vector<int> index;
+  const PdfObj *idx = dict->get("Index", 0);
+  if (idx && idx->array()) {
+    for (int i = 0; i < idx->array()->count(); ++i) {
+      const PdfObj *obj = idx->array()->obj(i, 0);
+      if (!obj->number())
+	return false;
+      index.push_back(int(obj->number()->value()));
+    }
+  } else {
+    const PdfObj *sz = dict->get("Size", 0);
+    if (!sz || !sz->number())
+      return false;
+    index.push_back(0);
+    index.push_back(int(sz->number()->value()));
+  }
+
+  Buffer data = dict->inflate();
+  const uchar *p = (const uchar *) data.data();
+  const uchar *fin = p + data.size();
+  for (int k = 0; k + 1 < int(index.size()); k += 2) {
+    int first = index[k];
+    int count = index[k + 1];
+    if (!validSubsection(first, count, (fin - p) / entrySize))
+      return false;
+    if (first + count > int(iXRef.size())) {
+      XRef unknown = { -1, 0, 0 };
+      iXRef.resize(first + count, unknown);
+    }
+    for (int num = first; num < first + count; ++num) {
+      int field[3];
+      for (int i = 0; i < 3; ++i) {
+	field[i] = 0;
+	for (int j = 0; j < width[i]; ++j)
+	  field[i] = (field[i] << 8) | *p++;
+      }
+      if (width[0] == 0)
+	field[0] = 1;  // default type
+      if (iXRef[num].iType >= 0)
+	continue;
+      iXRef[num].iType = 0;
+      iXRef[num].iGen = (field[0] == 2) ? 0 : field[2];
+      if (field[0] == 1 || field[0] == 2) {
+	iXRef[num].iType = field[0];
+	iXRef[num].iOffset = field[1];
+      }
+    }
+  }
+  return true;
+}
+
+//! Parse the objects in the object stream with number \a num.
+/*! Only objects that have not been found elsewhere are stored. */
+bool PdfFile::readObjectStream(int num) const
+{
+  // an object stream cannot itself be compressed
+  if (iData && (num < 0 || num >= int(iXRef.size()) || iXRef[num].iType != 1))
+    return false;
+  const PdfObj *obj = object(num);
+  if (!hasType(obj, "ObjStm"))
+    return false;
+  const PdfObj *n = obj->dict()->get("N", this);
+  const PdfObj *first = obj->dict()->get("First", this);
+  if (!n || !n->number() || !first || !first->number())
+    return false;
+  int count = int(n->number()->value());
+  int start = int(first->number()->value());
+  Buffer data = obj->dict()->inflate();
+  // each pair in the header takes at least four bytes
+  if (count < 0 || count > data.size() / 4)
+    return false;
+
+  // header consists of pairs of object number and offset
+  PdfMemorySource source(data.data(), data.size());
+  PdfParser parser(source);
+  std::vector<int> header;
+  for (int i = 0; i < 2 * count; ++i) {
+    if (parser.token().iType != PdfToken::ENumber)
+      return false;
+    header.push_back(toInt(parser.token().iString));
+    parser.getToken();
+  }
+
+  for (int i = 0; i < count; ++i) {
+    int onum = header[2 * i];
+    int offset = start + header[2 * i + 1];
+    if (iObjects.find(onum) != iObjects.end())
+      continue;
+    if (iData && (onum < 0 || onum >= int(iXRef.size())
+		  || iXRef[onum].iType != 2 || iXRef[onum].iOffset != num))
+      continue;  // superseded by a later update
+    if (offset < 0 || offset >= data.size())
+      return false;
+    PdfMemorySource osource(data.data() + offset, data.size() - offset);
+    PdfParser oparser(osource);
+    PdfObj *o = oparser.getObject();
+    if (!o) {
+      ipeDebug("Failed to get object %d from object stream %d", onum, num);
+      return false;
+    }
+    iObjects[onum] = o;
+  }
+  return true;
 }
 
 //! Return object with number \a num.
+/*! If only the cross-reference table has been read, the object is
+  parsed now.  This is not thread-safe. */
 const PdfObj *PdfFile::object(int num) const
 {
   std::map<int, const PdfObj *>::const_iterator it =
     iObjects.find(num);
   if (it != iObjects.end())
     return it->second;
-  else
+  if (!iData || num < 0 || num >= int(iXRef.size()))
+    return 0;
+  const XRef &xref = iXRef[num];
+  if (xref.iType == 2) {
+    if (!readObjectStream(xref.iOffset))
+      return 0;
+    it = iObjects.find(num);
+    return (it != iObjects.end()) ? it->second : 0;
+  }
+  if (xref.iType != 1 || xref.iOffset <= 0 || xref.iOffset >= iSize)
+    return 0;
+  PdfMemorySource source(iData + xref.iOffset, iSize - xref.iOffset);
+  PdfParser parser(source, this);
+  if (parser.token().iType != PdfToken::ENumber
+      || toInt(parser.token().iString) != num)
+    return 0;
+  PdfObj *obj = parser.getObjectDef();
+  if (!obj) {
+    ipeDebug("Failed to get object %d", num);
+    return 0;
+  }
+  iObjects[num] = obj;
+  return obj;
+}
+
+//! Return file offset of object with number \a num.
+/*! Returns -1 if the object is not stored directly in the file, or
+  if only the objects have been read (parse(DataSource &)). */
+int PdfFile::objectOffset(int num) const
+{
+  if (num < 0 || num >= int(iXRef.size()) || iXRef[num].iType != 1)
+    return -1;
+  return iXRef[num].iOffset;
+}
+
+//! Return generation number of object \a num.
+/*! For a free object, this is the generation to be used when its
+  number is used again.  Returns 0 if the object is not known, or if
+  only the objects have been read (parse(DataSource &)). */
+int PdfFile::generation(int num) const
+{
+  if (num < 0 || num >= int(iXRef.size()) || iXRef[num].iType < 0)
     return 0;
+  return iXRef[num].iGen;
 }
 
 //! Return root catalog of PDF file.
@@ -39,9 +39,13 @@
 #include "ipefontpool.h"
 #include "ipepdfparser.h"
 
+#include <algorithm>
+
 using namespace ipe;
 
 typedef std::vector<Bitmap>::const_iterator BmIter;
+typedef std::unordered_multimap<unsigned long long, Bitmap>::const_iterator
+BmHashIter;
 
 // --------------------------------------------------------------------
 
@@ -150,11 +154,11 @@ void PdfPainter::drawAttributes()
   drawOpacity();
 }
 
-static const char *opacityName(Fixed alpha)
+static String opacityName(Fixed alpha)
 {
-  static char buf[12];
+  char buf[12];
   sprintf(buf, "/alpha%03d", alpha.internal());
-  return buf;
+  return String(buf);
 }
 
 void PdfPainter::drawOpacity()
@@ -319,9 +323,9 @@ void PdfPainter::doDrawSymbol(Attribute symbol)
   Ipe data. You have to create a PdfWriter first, providing a file
   that has been opened for (binary) writing and is empty.  Then call
   createPages() to embed the pages.  Optionally, call \c
-  createXmlStream to embed a stream with the XML representation of the
-  document. Finally, call \c createTrailer to complete the PDF
-  document, and close the file.
+  startXmlStream, write the XML representation of the document to the
+  stream it returns, and call \c finishXmlStream. Finally, call \c
+  createTrailer to complete the PDF document, and close the file.
 
   Some reserved PDF object numbers:
 
@@ -329,14 +333,167 @@ void PdfPainter::doDrawSymbol(Attribute symbol)
     - 1:  XML stream.
     - 2: Parent of all pages objects.
 
+  If a \a previous version of the file is given, the PdfWriter
+  creates an incremental update to be appended to it instead: Objects
+  are numbered as in a complete file, but only those that differ from
+  the object with the same number in \a previous are written, followed
+  by a cross-reference table for them.  Afterwards, garbage() tells
+  how much of the updated file is no longer used.
+
 */
 
+// --------------------------------------------------------------------
+
+// Compares the objects written with the same objects in the previous
+// version of the file, and passes on only those that differ.  Data
+// outside objects is always passed on.
+class PdfWriter::UpdateStream : public TellStream {
+public:
+  UpdateStream(TellStream &stream, const PdfFile &previous);
+  void startObject(int num);
+  void finish();
+  double garbage() const;
+  virtual void putChar(char ch);
+  virtual void putString(String s);
+  virtual void putCString(const char *s);
+  virtual void putRaw(const char *data, int size);
+  virtual long tell() const;
+public:
+  //! Objects identical to the previous version.
+  std::set<int> iUnchanged;
+private:
+  void changed();
+private:
+  TellStream &iStream;
+  const PdfFile &iPrevious;
+  //! Object being compared, or -1.
+  int iNum;
+  //! Position of the object in the updated file.
+  long iStart;
+  //! The object in the previous version, and the bytes available.
+  const char *iOld;
+  int iOldSize;
+  //! Number of bytes found identical so far.
+  int iMatched;
+  //! Total size of the objects in the updated file.
+  long iLive;
+  //! Size of the updated file without the final cross-reference table.
+  long iEnd;
+};
+
+PdfWriter::UpdateStream::UpdateStream(TellStream &stream,
+				      const PdfFile &previous)
+  : iStream(stream), iPrevious(previous)
+{
+  iNum = -1;
+  iMatched = 0;
+  iLive = 0;
+  iEnd = 0;
+  // the update must start on a new line
+  int size = previous.size();
+  if (size > 0 && previous.data()[size-1] != '\n'
+      && previous.data()[size-1] != '\r')
+    iStream << "\n";
+}
+
+//! End the current object, and start comparing object \a num.
+void PdfWriter::UpdateStream::startObject(int num)
+{
+  finish();
+  iNum = num;
+  iStart = iStream.tell();
+  iMatched = 0;
+  int offset = iPrevious.objectOffset(num);
+  if (offset > 0 && offset < iPrevious.size()) {
+    iOld = iPrevious.data() + offset;
+    iOldSize = iPrevious.size() - offset;
+  } else {
+    iOld = 0;
+    iOldSize = 0;
+  }
+}
+
+//! End the current object.
+void PdfWriter::UpdateStream::finish()
+{
+  if (iNum >= 0) {
+    iLive += tell() - iStart;
+    if (iOld)
+      iUnchanged.insert(iNum);
+  }
+  iNum = -1;
+  iOld = 0;
+  iMatched = 0;
+  iEnd = iStream.tell();
+}
+
+//! Return fraction of the file not used by the objects written.
+double PdfWriter::UpdateStream::garbage() const
+{
+  return (iEnd > 0) ? double(iEnd - iLive) / iEnd : 0.0;
+}
+
+// Write the identical bytes, and pass on the rest of the object.
+void PdfWriter::UpdateStream::changed()
+{
+  iStream.putRaw(iOld, iMatched);
+  iOld = 0;
+  iMatched = 0;
+}
+
+void PdfWriter::UpdateStream::putChar(char ch)
+{
+  if (iNum >= 0 && iOld) {
+    if (iMatched < iOldSize && iOld[iMatched] == ch) {
+      ++iMatched;
+      return;
+    }
+    changed();
+  }
+  iStream.putChar(ch);
+}
+
+void PdfWriter::UpdateStream::putString(String s)
+{
+  putRaw(s.data(), s.size());
+}
+
+void PdfWriter::UpdateStream::putCString(const char *s)
+{
+  putRaw(s, std::strlen(s));
+}
+
+void PdfWriter::UpdateStream::putRaw(const char *data, int size)
+{
+  if (iNum >= 0 && iOld) {
+    if (size <= iOldSize - iMatched
+	&& !std::memcmp(iOld + iMatched, data, size)) {
+      iMatched += size;
+      return;
+    }
+    changed();
+  }
+  iStream.putRaw(data, size);
+}
+
+long PdfWriter::UpdateStream::tell() const
+{
+  return iStream.tell() + iMatched;
+}
+
+// --------------------------------------------------------------------
+
 //! Create a PDF writer operating on this (open and empty) file.
+/*! If \a previous is not 0, the \a stream must be positioned at the
+  end of that file instead, see above. */
 PdfWriter::PdfWriter(TellStream &stream, const Document *doc,
 		     const FontPool *pool,
 		     bool markedView, int fromPage, int toPage,
-		     int compression)
-  : iStream(stream), iDoc(doc), iMarkedView(markedView),
+		     int compression, const PdfFile *previous)
+  : iPrevious(previous),
+    iUpdate(previous ? new UpdateStream(stream, *previous) : 0),
+    iStream(iUpdate ? static_cast<TellStream &>(*iUpdate) : stream),
+    iDoc(doc), iMarkedView(markedView),
     iFromPage(fromPage), iToPage(toPage)
 {
   iCompressLevel = compression;
@@ -346,16 +503,19 @@ PdfWriter::PdfWriter(TellStream &stream, const Document *doc,
   iPageNumberFont = -1;
   iExtGState = -1;
   iPatternNum = -1;
+  iFormResources = -1;
   iBookmarks = -1;
+  iStreamBuffer = 0;  // no stream being written
+  iDeflate = 0;
 
   if (iFromPage < 0 || iFromPage >= iDoc->countPages())
     iFromPage = 0;
   if (iToPage < iFromPage || iToPage >= iDoc->countPages())
     iToPage = iDoc->countPages() - 1;
 
-  // mark all bitmaps as not embedded
+  // mark all bitmaps on the pages we write as not embedded
   BitmapFinder bm;
-  iDoc->findBitmaps(bm);
+  iDoc->findBitmaps(bm, iFromPage, iToPage);
   int id = -1;
   for (std::vector<Bitmap>::iterator it = bm.iBitmaps.begin();
        it != bm.iBitmaps.end(); ++it) {
@@ -363,10 +523,13 @@ PdfWriter::PdfWriter(TellStream &stream, const Document *doc,
     --id;
   }
 
-  if (iDoc->hasTransparency())
-    iStream << "%PDF-1.4\n";
-  else
-    iStream << "%PDF-1.3\n";
+  // an update keeps the header of the previous version
+  if (!iUpdate) {
+    if (iDoc->hasTransparency())
+      iStream << "%PDF-1.4\n";
+    else
+      iStream << "%PDF-1.3\n";
+  }
 
   if (iDoc->properties().iNumberPages) {
     iPageNumberFont = startObject();
@@ -466,10 +629,8 @@ PdfWriter::PdfWriter(TellStream &stream, const Document *doc,
 	      << "/YStep " << t->iStep << "\n"
 	      << "/Resources << >>\n"
 	      << "/Matrix [" << m << " 0 0]\n";
-      String s;
-      StringStream ss(s);
-      ss << "0 0 100 " << t->iWidth << " re f\n";
-      createStream(s.data(), s.size(), false);
+      startStream() << "0 0 100 " << t->iWidth << " re f\n";
+      finishStream();
       patterns[ts[i].index()] = num;
     }
 
@@ -478,7 +639,7 @@ PdfWriter::PdfWriter(TellStream &stream, const Document *doc,
     iStream << "<<\n";
     for (uint i = 0; i < ts.size(); ++i) {
       iStream << "/Pat" << ts[i].index() << " "
-	      << patterns[ts[i].index()] << " 0 R\n";
+	      << ref(patterns[ts[i].index()]) << "\n";
     }
     iStream << ">> endobj\n";
   }
@@ -507,37 +668,76 @@ PdfWriter::PdfWriter(TellStream &stream, const Document *doc,
 	iStream << "/Subtype /Form\n";
 	iStream << "/BBox ["  << bbox << "]\n";
 	createResources(bm);
-	String s;
-	StringStream ss(s);
-	PdfPainter painter(iDoc->cascade(), ss);
+	PdfPainter painter(iDoc->cascade(), startStream());
 	sym->iObject->draw(painter);
-	createStream(s.data(), s.size(), false);
+	finishStream();
 	iSymbols[sys[i].index()] = num;
       }
     }
   }
+
+  // everything outside a page that its content streams depend on
+  StringStream key(iCacheKey);
+  key << iCompressLevel << " " << iPageNumberFont << " :";
+  for (int i = 0; i < iDoc->cascade()->count(); ++i)
+    key << " " << iDoc->cascade()->sheet(i)->stamp();
 }
 
 //! Destructor.
 PdfWriter::~PdfWriter()
 {
-  // nothing
+  delete iDeflate;
+  delete iStreamBuffer;
+  delete iUpdate;
 }
 
-/*! Write the beginning of the next object: "no 0 obj " and save
+/*! Write the beginning of the next object: "no gen obj " and save
   information about file position. Default argument uses next unused
   object number.  Returns number of new object. */
 int PdfWriter::startObject(int objnum)
 {
   if (objnum < 0)
-    objnum = iObjNum++;
+    objnum = nextObjNum();
+  if (iUpdate)
+    iUpdate->startObject(objnum);
   iXref[objnum] = iStream.tell();
-  iStream << objnum << " 0 obj ";
+  iStream << objnum << " " << generation(objnum) << " obj ";
   return objnum;
 }
 
+//! Return the generation number of object \a num.
+/*! This is always 0 in a complete file.  In an update, an object
+  keeps the generation it has in the previous version, and a number
+  that was freed there is used with the generation of its free
+  entry. */
+int PdfWriter::generation(int num) const
+{
+  return iPrevious ? iPrevious->generation(num) : 0;
+}
+
+//! Return the next unused object number.
+/*! In an update, a number that was freed with generation 65535 must
+  not be used again, and is skipped. */
+int PdfWriter::nextObjNum()
+{
+  while (iPrevious && iPrevious->objectOffset(iObjNum) < 0
+	 && generation(iObjNum) >= 65535)
+    ++iObjNum;
+  return iObjNum++;
+}
+
+//! Return a reference to object \a num.
+String PdfWriter::ref(int num) const
+{
+  String s;
+  StringStream ss(s);
+  ss << num << " " << generation(num) << " R";
+  return s;
+}
+
 /*! Write all fonts to the PDF file, and fill in their object numbers.
-  Embeds no fonts if \c pool is 0, but must be called nevertheless. */
+  Embeds no fonts if \c pool is 0, but must be called nevertheless.
+  Type1 fonts are reduced to the glyphs used on the pages written. */
 void PdfWriter::embedFonts(const FontPool *pool)
 {
   std::map<int, int> fontNumber;
@@ -549,8 +749,16 @@ void PdfWriter::embedFonts(const FontPool *pool)
     std::vector<String> cmapFonts;
     iDoc->cascade()->allCMaps(cmapFonts);
 
-    for (FontPool::const_iterator font = pool->begin();
-	 font != pool->end(); ++font) {
+    CharacterFinder cf;
+    iDoc->findCharacters(cf, iFromPage, iToPage);
+
+    for (FontPool::const_iterator it = pool->begin();
+	 it != pool->end(); ++it) {
+      Font sub;
+      const Font *font = &*it;
+      if (cf.complete(it->iLatexNumber)
+	  && it->subset(cf.iCodes[it->iLatexNumber], sub))
+	font = &sub;
       int fontDescriptor = -1;
       if (!font->iFontDescriptor.empty()) {
 	int streamId = startObject();
@@ -559,7 +767,7 @@ void PdfWriter::embedFonts(const FontPool *pool)
 		     font->iStreamData.size(), false);
 	fontDescriptor = startObject();
 	iStream << "<<\n" << font->iFontDescriptor
-		<< streamId << " 0 R\n" << ">> endobj\n";
+		<< ref(streamId) << "\n>> endobj\n";
       }
       int cmap = -1;
       int j = font->iName.size() - 2;
@@ -567,8 +775,9 @@ void PdfWriter::embedFonts(const FontPool *pool)
 			     font->iName.substr(0, j)) != cmapFonts.end()) {
 	String fpage = font->iName.substr(j);
 	// int page = std::strtol(fpage.z(), 0, 16);
-	String s;
-	StringStream ss(s);
+	cmap = startObject();
+	iStream << "<<\n";
+	Stream &ss = startStream();
 	ss << "/CIDInit /ProcSet findresource begin\n"
 	   << "12 dict begin\n"
 	   << "begincmap\n"
@@ -589,17 +798,15 @@ void PdfWriter::embedFonts(const FontPool *pool)
 	   << "CMapName currentdict /CMap defineresource pop\n"
 	   << "end\n"
 	   << "end\n";
-	cmap = startObject();
-	iStream << "<<\n";
-	createStream(s.data(), s.size(), false);
+	finishStream();
       }
       int objectNumber = startObject();
       fontNumber[font->iLatexNumber] = objectNumber;
       iStream << "<<\n" << font->iFontDict;
       if (fontDescriptor >= 0)
-	iStream << "/FontDescriptor " << fontDescriptor << " 0 R\n";
+	iStream << "/FontDescriptor " << ref(fontDescriptor) << "\n";
       if (cmap >= 0)
-	iStream << "/ToUnicode " << cmap << " 0 R\n";
+	iStream << "/ToUnicode " << ref(cmap) << "\n";
       iStream << ">> endobj\n";
     }
   }
@@ -611,12 +818,12 @@ void PdfWriter::embedFonts(const FontPool *pool)
       for (FontPool::const_iterator font = pool->begin();
 	   font != pool->end(); ++font) {
 	iStream << "/F" << font->iLatexNumber << " "
-		<< fontNumber[font->iLatexNumber] << " 0 R ";
+		<< ref(fontNumber[font->iLatexNumber]) << " ";
       }
     }
     if (iPageNumberFont >= 0)
       iStream << "/F" << iPageNumberFont << " "
-	      << iPageNumberFont << " 0 R ";
+	      << ref(iPageNumberFont) << " ";
     iStream << ">> endobj\n";
   }
 }
@@ -639,7 +846,7 @@ void PdfWriter::createStream(const char *data, int size, bool preCompressed)
   if (iCompressLevel > 0) {
     int deflatedSize;
     Buffer deflated = DeflateStream::deflate(data, size, deflatedSize,
-						   iCompressLevel);
+					     iCompressLevel);
     iStream << "/Length " << deflatedSize
 	    << " /Filter /FlateDecode >>\nstream\n";
     iStream.putRaw(deflated.data(), deflatedSize);
@@ -653,9 +860,10 @@ void PdfWriter::createStream(const char *data, int size, bool preCompressed)
 
 // --------------------------------------------------------------------
 
+//! Write a bitmap, using the object number assigned by allocateBitmaps.
 void PdfWriter::embedBitmap(Bitmap bitmap)
 {
-  int objnum = startObject();
+  startObject(bitmap.objNum());
   iStream << "<<\n";
   iStream << "/Type /XObject\n";
   iStream << "/Subtype /Image\n";
@@ -696,74 +904,136 @@ void PdfWriter::embedBitmap(Bitmap bitmap)
   iStream << "/Length " << bitmap.size() << "\n>> stream\n";
   iStream.putRaw(bitmap.data(), bitmap.size());
   iStream << "\nendstream endobj\n";
-  bitmap.setObjNum(objnum);
 }
 
-void PdfWriter::embedBitmaps(const BitmapFinder &bm)
+//! Assign object numbers to the bitmaps in \a bm.
+/*! Bitmaps that have not been embedded yet receive a new object
+  number, and are appended to \a embed.  They must be written using
+  embedBitmap() before any other object is created. */
+void PdfWriter::allocateBitmaps(const BitmapFinder &bm,
+				std::vector<Bitmap> &embed)
 {
   for (BmIter it = bm.iBitmaps.begin(); it != bm.iBitmaps.end(); ++it) {
-    BmIter it1 = std::find(iBitmaps.begin(), iBitmaps.end(), *it);
-    if (it1 == iBitmaps.end()) {
-      // look again, more carefully
-      for (it1 = iBitmaps.begin();
-	   it1 != iBitmaps.end() && !it1->equal(*it); ++it1)
-	;
-      if (it1 == iBitmaps.end())
-	embedBitmap(*it); // not yet embedded
-      else
-	it->setObjNum(it1->objNum()); // identical Bitmap is embedded
-      iBitmaps.push_back(*it);
-    }
+    std::pair<BmHashIter, BmHashIter> range =
+      iBitmaps.equal_range(it->hash());
+    BmHashIter it1 = range.first;
+    while (it1 != range.second && it1->second != *it) // shared data
+      ++it1;
+    if (it1 != range.second)
+      continue; // already has its object number
+    for (it1 = range.first;
+	 it1 != range.second && !it1->second.equal(*it); ++it1)
+      ;
+    if (it1 == range.second) {
+      it->setObjNum(nextObjNum()); // not yet embedded
+      embed.push_back(*it);
+    } else
+      it->setObjNum(it1->second.objNum()); // identical Bitmap is embedded
+    iBitmaps.insert(std::make_pair(it->hash(), *it));
   }
 }
 
-void PdfWriter::createResources(const BitmapFinder &bm)
+void PdfWriter::embedBitmaps(const BitmapFinder &bm)
+{
+  std::vector<Bitmap> embed;
+  allocateBitmaps(bm, embed);
+  for (BmIter it = embed.begin(); it != embed.end(); ++it)
+    embedBitmap(*it);
+}
+
+/*! The resources include the layer \a forms, if given. */
+void PdfWriter::createResources(const BitmapFinder &bm,
+				const std::vector<FormUse> *forms)
+{
+  iStream << "/Resources ";
+  createResourceDict(bm, forms);
+}
+
+//! Write the resource dictionary used by createResources().
+void PdfWriter::createResourceDict(const BitmapFinder &bm,
+				   const std::vector<FormUse> *forms)
 {
-  iStream << "/Resources <<\n  /ProcSet [ /PDF ";
+  iStream << "<<\n  /ProcSet [ /PDF ";
   if (iResourceNum >= 0)
     iStream << "/Text";
   if (!bm.iBitmaps.empty())
     iStream << "/ImageB /ImageC";
   iStream << " ]\n";
   if (iResourceNum >= 0)
-    iStream << "  /Font " << iResourceNum << " 0 R\n";
+    iStream << "  /Font " << ref(iResourceNum) << "\n";
   // embed resources for gradients
   if (iGradients.size()) {
     iStream << "  /Shading <<";
     for (std::map<int,int>::const_iterator it = iGradients.begin();
 	 it != iGradients.end(); ++it)
-      iStream << " /Grad" << it->first << " " << it->second << " 0 R";
+      iStream << " /Grad" << it->first << " " << ref(it->second);
     iStream << " >>\n";
   }
   if (iExtGState >= 0)
-    iStream << "  /ExtGState " << iExtGState << " 0 R\n";
+    iStream << "  /ExtGState " << ref(iExtGState) << "\n";
   // patterns
   if (iPatternNum >= 0) {
     iStream << "  /ColorSpace << /PCS [/Pattern /DeviceRGB] >>\n";
-    iStream << "  /Pattern " << iPatternNum << " 0 R\n";
+    iStream << "  /Pattern " << ref(iPatternNum) << "\n";
   }
-  if (!bm.iBitmaps.empty() || !iSymbols.empty()) {
+  if (!bm.iBitmaps.empty() || !iSymbols.empty()
+      || (forms && !forms->empty())) {
     iStream << "  /XObject << ";
+    // mention each PDF object only once
+    std::set<int> images;
     for (BmIter it = bm.iBitmaps.begin(); it != bm.iBitmaps.end(); ++it) {
-      // mention each PDF object only once
-      BmIter it1;
-      for (it1 = bm.iBitmaps.begin();
-	   it1 != it && it1->objNum() != it->objNum(); it1++)
-	;
-      if (it1 == it)
-	iStream << "/Image" << it->objNum() << " " << it->objNum() << " 0 R ";
+      if (images.insert(it->objNum()).second)
+	iStream << "/Image" << it->objNum() << " " << ref(it->objNum()) << " ";
     }
     for (std::map<int,int>::const_iterator it = iSymbols.begin();
 	 it != iSymbols.end(); ++it)
-      iStream << "/Symbol" << it->first << " " << it->second << " 0 R ";
+      iStream << "/Symbol" << it->first << " " << ref(it->second) << " ";
+    if (forms) {
+      for (uint i = 0; i < forms->size(); ++i)
+	iStream << "/Layer" << (*forms)[i].iNum << " "
+		<< ref((*forms)[i].iNum) << " ";
+    }
     iStream << ">>\n";
   }
   iStream << "  >>\n";
 }
 
+//! Start a stream whose length is not known in advance.
+/*! Object must have been created with dictionary start having been
+  written.  The data written to the returned stream is compressed into
+  memory, depending on compress level, so that finishStream() can
+  write it with its length. */
+Stream &PdfWriter::startStream()
+{
+  assert(!iStreamBuffer);
+  iStreamData.erase();
+  iStreamBuffer = new StringStream(iStreamData);
+  if (iCompressLevel == 0)
+    return *iStreamBuffer;
+  iDeflate = new DeflateStream(*iStreamBuffer, iCompressLevel);
+  return *iDeflate;
+}
+
+//! Finish the stream started with startStream(), and write it.
+void PdfWriter::finishStream()
+{
+  if (iDeflate) {
+    iDeflate->close();
+    delete iDeflate;
+    iDeflate = 0;
+  }
+  delete iStreamBuffer;
+  iStreamBuffer = 0;
+  createStream(iStreamData.data(), iStreamData.size(), (iCompressLevel > 0));
+  iStreamData.erase();
+}
+
 // --------------------------------------------------------------------
 
-void PdfWriter::paintView(Stream &stream, int pno, int view)
+/*! If layer \a forms are given, these are drawn instead of the
+  objects. */
+void PdfWriter::paintView(Stream &stream, int pno, int view,
+			  const std::vector<FormUse> &forms) const
 {
   const Page *page = iDoc->page(pno);
   PdfPainter painter(iDoc->cascade(), stream);
@@ -791,46 +1061,203 @@ void PdfWriter::paintView(Stream &stream, int pno, int view)
   if (title)
     title->draw(painter);
 
+  uint form = 0;
   for (int i = 0; i < page->count(); ++i) {
-    if (page->objectVisible(view, i))
+    if (form < forms.size() && forms[form].iFirst == i) {
+      stream << "/Layer" << forms[form].iNum << " Do\n";
+      i = forms[form++].iLast - 1;
+    } else if (page->objectVisible(view, i))
       page->object(i)->draw(painter);
   }
 }
 
-//! create contents and page stream for this page view.
-void PdfWriter::createPageView(int pno, int view)
+static void paintObjects(const Cascade *cascade, Stream &stream,
+			 const Page *page, int first, int last)
+{
+  PdfPainter painter(cascade, stream);
+  for (int i = first; i < last; ++i)
+    page->object(i)->draw(painter);
+}
+
+// Compress a content stream that has been painted into memory.
+static String deflated(const String &data, int level)
+{
+  int size;
+  Buffer buffer = DeflateStream::deflate(data.data(), data.size(),
+					 size, level);
+  String result;
+  result.append(buffer.data(), size);
+  return result;
+}
+
+//! Paint the content stream of a view, and compress it.
+/*! If the compression backend prefers it, the stream is compressed
+  in one piece, see Compression::prefersBuffers(). */
+void PdfWriter::paintContents(View &view) const
+{
+  StringStream sstream(view.iData);
+  if (iCompressLevel > 0 && !Compression::backend()->prefersBuffers()) {
+    DeflateStream dfStream(sstream, iCompressLevel);
+    paintView(dfStream, view.iPage, view.iView, view.iForms);
+    dfStream.close();
+  } else {
+    paintView(sstream, view.iPage, view.iView, view.iForms);
+    if (iCompressLevel > 0)
+      view.iData = deflated(view.iData, iCompressLevel);
+  }
+}
+
+// Which of the views show object i?
+static std::vector<bool> showing(const Page *page, int i,
+				 const std::vector<int> &views)
+{
+  std::vector<bool> shown(views.size());
+  for (uint k = 0; k < views.size(); ++k)
+    shown[k] = page->objectVisible(views[k], i);
+  return shown;
+}
+
+// A form costs its object and cross-reference entry, and a reference
+// from each view showing it (in bytes).  Compressed on their own, the
+// objects also take more space than inside a content stream.
+static const int formObjectCost = 150;
+static const int formUseCost = 20;
+static const int formDeflateCost = 60;
+
+//! Create the layer forms of a page, and assign their object numbers.
+/*! The page is shown in \a views[first] and the following views.
+  Each run of consecutive objects shown by at least two of these
+  views is painted and compressed once.  It becomes a form if the
+  copies saved in the content streams of the views pay for the form
+  object and the references to it.  Otherwise the views draw the
+  objects themselves, and a page without forms has ordinary content
+  streams.  Forms without bitmaps share one resource dictionary. */
+void PdfWriter::findLayerForms(int pno, std::vector<View> &views, int first,
+			       std::vector<LayerForm> &forms)
 {
   const Page *page = iDoc->page(pno);
+  std::vector<int> viewNos;
+  for (uint k = first; k < views.size(); ++k)
+    viewNos.push_back(views[k].iView);
+  int i = 0;
+  while (i < page->count()) {
+    std::vector<bool> shown = showing(page, i, viewNos);
+    int j = i + 1;
+    while (j < page->count() && showing(page, j, viewNos) == shown)
+      ++j;
+    int count = std::count(shown.begin(), shown.end(), true);
+    if (count > 1) {
+      String data;
+      StringStream stream(data);
+      paintObjects(iDoc->cascade(), stream, page, i, j);
+      int inlineSize = data.size();
+      if (iCompressLevel > 0) {
+	data = deflated(data, iCompressLevel);
+	inlineSize = data.size() - formDeflateCost;
+      }
+      if (count * inlineSize >
+	  data.size() + formObjectCost + count * formUseCost) {
+	forms.push_back(LayerForm());
+	LayerForm &form = forms.back();
+	form.iPage = pno;
+	form.iFirst = i;
+	form.iLast = j;
+	form.iData = data;
+	for (int k = i; k < j; ++k)
+	  page->object(k)->accept(form.iBitmaps);
+	allocateBitmaps(form.iBitmaps, form.iEmbed);
+	FormUse use;
+	use.iNum = form.iNum = nextObjNum();
+	use.iFirst = i;
+	use.iLast = j;
+	for (uint k = 0; k < shown.size(); ++k) {
+	  if (shown[k])
+	    views[first + k].iForms.push_back(use);
+	}
+      }
+    }
+    i = j;
+  }
+}
+
+//! Write the bitmaps and the form XObject of a layer form.
+void PdfWriter::writeForm(const LayerForm &form)
+{
+  for (BmIter it = form.iEmbed.begin(); it != form.iEmbed.end(); ++it)
+    embedBitmap(*it);
+
+  bool shared = form.iBitmaps.iBitmaps.empty();
+  if (shared && iFormResources < 0) {
+    iFormResources = startObject();
+    createResourceDict(form.iBitmaps, 0);
+    iStream << "endobj\n";
+  }
+  startObject(form.iNum);
+  iStream << "<<\n";
+  iStream << "/Type /XObject\n";
+  iStream << "/Subtype /Form\n";
+  iStream << "/BBox [" << iDoc->cascade()->findLayout()->paper() << "]\n";
+  if (shared)
+    iStream << "/Resources " << ref(iFormResources) << "\n";
+  else
+    createResources(form.iBitmaps);
+  createStream(form.iData.data(), form.iData.size(), (iCompressLevel > 0));
+}
+
+//! Assign object numbers for a view, and look up its cached contents.
+void PdfWriter::prepareView(View &view)
+{
+  const Page *page = iDoc->page(view.iPage);
   // Find bitmaps to embed
-  BitmapFinder bm;
   const Symbol *background =
     iDoc->cascade()->findSymbol(Attribute::BACKGROUND());
   if (background && page->findLayer("BACKGROUND") < 0)
-    background->iObject->accept(bm);
-  bm.scanPage(page);
-  // ipeDebug("# of bitmaps: %d", bm.iBitmaps.size());
-  embedBitmaps(bm);
-  // create page stream
-  String pagedata;
-  StringStream sstream(pagedata);
-  if (iCompressLevel > 0) {
-    DeflateStream dfStream(sstream, iCompressLevel);
-    paintView(dfStream, pno, view);
-    dfStream.close();
-  } else
-    paintView(sstream, pno, view);
+    background->iObject->accept(view.iBitmaps);
+  // the objects the view draws itself
+  uint form = 0;
+  for (int i = 0; i < page->count(); ++i) {
+    if (form < view.iForms.size() && view.iForms[form].iFirst == i)
+      i = view.iForms[form++].iLast - 1;
+    else
+      page->object(i)->accept(view.iBitmaps);
+  }
+  // ipeDebug("# of bitmaps: %d", view.iBitmaps.iBitmaps.size());
+  allocateBitmaps(view.iBitmaps, view.iEmbed);
+  view.iContentsNum = nextObjNum();
+  view.iPageNum = nextObjNum();
+  // reuse page stream if neither the page nor its context has changed
+  StringStream keyStream(view.iKey);
+  keyStream << iCacheKey << " :";
+  if (iPageNumberFont >= 0)
+    keyStream << " " << view.iPage;
+  for (BmIter it = view.iBitmaps.iBitmaps.begin();
+       it != view.iBitmaps.iBitmaps.end(); ++it)
+    keyStream << " " << it->objNum();
+  for (uint i = 0; i < view.iForms.size(); ++i)
+    keyStream << " /" << view.iForms[i].iNum << ":"
+	      << view.iForms[i].iFirst << "-" << view.iForms[i].iLast;
+  view.iData = page->cachedView(view.iView, view.iKey);
+}
+
+//! Write the bitmaps, content stream, and page object of a view.
+void PdfWriter::writeView(const View &view)
+{
+  const Page *page = iDoc->page(view.iPage);
+  for (BmIter it = view.iEmbed.begin(); it != view.iEmbed.end(); ++it)
+    embedBitmap(*it);
 
-  int contentsobj = startObject();
+  startObject(view.iContentsNum);
   iStream << "<<\n";
-  createStream(pagedata.data(), pagedata.size(), (iCompressLevel > 0));
-  int pageobj = startObject();
+  createStream(view.iData.data(), view.iData.size(), (iCompressLevel > 0));
+  startObject(view.iPageNum);
   iStream << "<<\n";
   iStream << "/Type /Page\n";
-  iStream << "/Contents " << contentsobj << " 0 R\n";
+  iStream << "/Contents " << ref(view.iContentsNum) << "\n";
   // iStream << "/Rotate 0\n";
-  createResources(bm);
-  if (!page->effect(view).isNormal()) {
-    const Effect *effect = iDoc->cascade()->findEffect(page->effect(view));
+  createResources(view.iBitmaps, &view.iForms);
+  if (!page->effect(view.iView).isNormal()) {
+    const Effect *effect =
+      iDoc->cascade()->findEffect(page->effect(view.iView));
     if (effect)
       effect->pageDictionary(iStream);
   }
@@ -839,8 +1266,8 @@ void PdfWriter::createPageView(int pno, int view)
 
   int viewBBoxLayer = page->findLayer("VIEWBBOX");
   Rect bbox;
-  if (viewBBoxLayer >= 0 && page->visible(view, viewBBoxLayer))
-    bbox = page->viewBBox(iDoc->cascade(), view);
+  if (viewBBoxLayer >= 0 && page->visible(view.iView, viewBBoxLayer))
+    bbox = page->viewBBox(iDoc->cascade(), view.iView);
   else
     bbox = page->pageBBox(iDoc->cascade());
   if (layout->iCrop && !bbox.isEmpty())
@@ -849,39 +1276,162 @@ void PdfWriter::createPageView(int pno, int view)
     iStream << "/ArtBox [" << bbox << "]\n";
   iStream << "/Parent 2 0 R\n";
   iStream << ">> endobj\n";
-  iPageObjectNumbers.push_back(pageobj);
+  iPageObjectNumbers.push_back(view.iPageNum);
+}
+
+//! create contents and page stream for this page view.
+void PdfWriter::createPageView(int pno, int view)
+{
+  View v;
+  v.iPage = pno;
+  v.iView = view;
+  prepareView(v);
+  if (v.iData.empty()) {
+    paintContents(v);
+    iDoc->page(pno)->setCachedView(view, v.iKey, v.iData);
+  }
+  writeView(v);
+}
+
+// --------------------------------------------------------------------
+
+// Paints the content streams of every iStep'th view, starting with
+// view iFirst.
+class PdfWriter::ViewPainter : public Thread {
+public:
+  ViewPainter(const PdfWriter &writer, std::vector<View> &views,
+	      const std::vector<bool> &cached, int first, int step)
+    : iWriter(writer), iViews(views), iCached(cached),
+      iFirst(first), iStep(step) { /* nothing */ }
+  void paint();
+protected:
+  virtual void run();
+private:
+  const PdfWriter &iWriter;
+  std::vector<View> &iViews;
+  const std::vector<bool> &iCached;
+  int iFirst;
+  int iStep;
+};
+
+void PdfWriter::ViewPainter::run()
+{
+  paint();
+}
+
+void PdfWriter::ViewPainter::paint()
+{
+  for (int i = iFirst; i < int(iViews.size()); i += iStep) {
+    if (!iCached[i])
+      iWriter.paintContents(iViews[i]);
+  }
 }
 
 //! Create all PDF pages.
-void PdfWriter::createPages()
+/*! If \a threads is larger than one, the content streams of the
+  views are painted and compressed concurrently.  All objects are
+  still written by the calling thread in the same order, so the
+  output does not depend on the number of threads.
+
+  If \a layerForms is true, objects shown in several views of a page
+  can be painted only once, as form XObjects that the views draw
+  instead of the objects (see findLayerForms).  The forms are created
+  by the calling thread, and are not cached. */
+void PdfWriter::createPages(int threads, bool layerForms)
 {
+  std::vector<View> views;
+  std::vector<LayerForm> forms;
+  // this also parses the pages of a lazily loaded document, which
+  // must happen before the painting threads start
   for (int page = iFromPage; page <= iToPage; ++page) {
     if (iMarkedView && !iDoc->page(page)->marked())
       continue;
     int nViews = iDoc->page(page)->countViews();
-    if (iMarkedView) {
-      bool shown = false;
-      for (int view = 0; view < nViews; ++view) {
-	if (iDoc->page(page)->markedView(view)) {
-	  createPageView(page, view);
-	  shown = true;
-	}
+    int first = views.size();
+    for (int view = 0; view < nViews; ++view) {
+      if (!iMarkedView || iDoc->page(page)->markedView(view)) {
+	views.push_back(View());
+	views.back().iPage = page;
+	views.back().iView = view;
       }
-      if (!shown)
-	createPageView(page, nViews - 1);
-    } else {
-      for (int view = 0; view < nViews; ++view)
-	createPageView(page, view);
     }
+    if (iMarkedView && int(views.size()) == first) {
+      views.push_back(View());
+      views.back().iPage = page;
+      views.back().iView = nViews - 1;
+    }
+    if (layerForms && int(views.size()) - first > 1)
+      findLayerForms(page, views, first, forms);
+  }
+
+  // object numbers are assigned in the order of the serial output
+  std::vector<bool> cached;
+  for (uint i = 0; i < views.size(); ++i) {
+    prepareView(views[i]);
+    cached.push_back(!views[i].iData.empty());
+  }
+
+  int n = threads;
+  if (n > int(views.size()))
+    n = views.size();
+  if (n > 1) {
+    // the cascade must not be resolved lazily by several threads
+    iDoc->cascade()->resolve();
+    std::vector<ViewPainter *> painters;
+    for (int k = 0; k < n; ++k)
+      painters.push_back(new ViewPainter(*this, views, cached, k, n));
+    // the first share of views is painted by this thread
+    for (int k = 1; k < n; ++k) {
+      if (!painters[k]->start())
+	painters[k]->paint();
+    }
+    painters[0]->paint();
+    for (int k = 0; k < n; ++k) {
+      painters[k]->wait();
+      delete painters[k];
+    }
+  } else {
+    for (uint i = 0; i < views.size(); ++i) {
+      if (!cached[i])
+	paintContents(views[i]);
+    }
+  }
+
+  uint form = 0;
+  for (uint i = 0; i < views.size(); ++i) {
+    while (form < forms.size() && forms[form].iPage == views[i].iPage)
+      writeForm(forms[form++]);
+    if (!cached[i])
+      iDoc->page(views[i].iPage)->setCachedView(views[i].iView,
+						views[i].iKey,
+						views[i].iData);
+    writeView(views[i]);
   }
 }
 
-//! Create a stream containing the XML data.
-void PdfWriter::createXmlStream(String xmldata, bool preCompressed)
+//! Start a stream containing the XML data.
+/*! The XML data is written to the returned stream, and compressed
+  while it is written.  Call finishXmlStream() afterwards. */
+Stream &PdfWriter::startXmlStream()
 {
   iXmlStreamNum = startObject(1);
   iStream << "<<\n/Type /Ipe\n";
-  createStream(xmldata.data(), xmldata.size(), preCompressed);
+  return startStream();
+}
+
+//! Finish the stream started with startXmlStream().
+void PdfWriter::finishXmlStream()
+{
+  finishStream();
+}
+
+//! Create the XML stream from data that is already compressed.
+/*! See Document::saveAsDeflatedXml(). */
+void PdfWriter::createXmlStream(String deflated)
+{
+  iXmlStreamNum = startObject(1);
+  iStream << "<<\n/Type /Ipe\n";
+  createStream(deflated.data(), deflated.size(), true);
 }
 
 //! Write a PDF string object to the PDF stream.
@@ -926,6 +1476,7 @@ struct Section {
   int iPage;
   int iSeqPage;
   int iObjNum;
+  std::vector<int> iSubObjNums;
   std::vector<int> iSubPages;
   std::vector<int> iSubSeqPages;
 };
@@ -957,17 +1508,18 @@ void PdfWriter::createBookmarks()
   if (sections.empty())
     return;
   // reserve outline object
-  iBookmarks = iObjNum++;
+  iBookmarks = nextObjNum();
   // assign object numbers
   for (uint s = 0; s < sections.size(); ++s) {
-    sections[s].iObjNum = iObjNum++;
-    iObjNum += sections[s].iSubPages.size(); // leave space for subsections
+    sections[s].iObjNum = nextObjNum();
+    for (uint ss = 0; ss < sections[s].iSubPages.size(); ++ss)
+      sections[s].iSubObjNums.push_back(nextObjNum());
   }
   // embed root
   startObject(iBookmarks);
-  iStream << "<<\n/First " << sections[0].iObjNum << " 0 R\n"
+  iStream << "<<\n/First " << ref(sections[0].iObjNum) << "\n"
 	  << "/Count " << int(sections.size()) << "\n"
-	  << "/Last " << sections.back().iObjNum << " 0 R\n>> endobj\n";
+	  << "/Last " << ref(sections.back().iObjNum) << "\n>> endobj\n";
   for (uint s = 0; s < sections.size(); ++s) {
     int count = sections[s].iSubPages.size();
     int obj = sections[s].iObjNum;
@@ -975,32 +1527,32 @@ void PdfWriter::createBookmarks()
     startObject(obj);
     iStream << "<<\n/Title ";
     writeString(iDoc->page(sections[s].iPage)->section(0));
-    iStream << "\n/Parent " << iBookmarks << " 0 R\n"
-	    << "/Dest [ " << iPageObjectNumbers[sections[s].iSeqPage]
-	    << " 0 R /XYZ null null null ]\n";
+    iStream << "\n/Parent " << ref(iBookmarks) << "\n"
+	    << "/Dest [ " << ref(iPageObjectNumbers[sections[s].iSeqPage])
+	    << " /XYZ null null null ]\n";
     if (s > 0)
-      iStream << "/Prev " << sections[s-1].iObjNum << " 0 R\n";
+      iStream << "/Prev " << ref(sections[s-1].iObjNum) << "\n";
     if (s < sections.size() - 1)
-      iStream << "/Next " << sections[s+1].iObjNum << " 0 R\n";
+      iStream << "/Next " << ref(sections[s+1].iObjNum) << "\n";
+    const std::vector<int> &sub = sections[s].iSubObjNums;
     if (count > 0)
       iStream << "/Count " << -count << "\n"
-	      << "/First " << (obj + 1) << " 0 R\n"
-	      << "/Last " << (obj + count) << " 0 R\n";
+	      << "/First " << ref(sub.front()) << "\n"
+	      << "/Last " << ref(sub.back()) << "\n";
     iStream << ">> endobj\n";
-    // using ids obj + 1 .. obj + count for the subsections
     for (int ss = 0; ss < count; ++ss) {
       int pageNo = sections[s].iSubPages[ss];
       int seqPageNo = sections[s].iSubSeqPages[ss];
-      startObject(obj + ss + 1);
+      startObject(sub[ss]);
       iStream << "<<\n/Title ";
       writeString(iDoc->page(pageNo)->section(1));
-      iStream << "\n/Parent " << obj << " 0 R\n"
-	      << "/Dest [ " << iPageObjectNumbers[seqPageNo]
-	      << " 0 R /XYZ null null null ]\n";
+      iStream << "\n/Parent " << ref(obj) << "\n"
+	      << "/Dest [ " << ref(iPageObjectNumbers[seqPageNo])
+	      << " /XYZ null null null ]\n";
       if (ss > 0)
-	iStream << "/Prev " << (obj + ss) << " 0 R\n";
+	iStream << "/Prev " << ref(sub[ss - 1]) << "\n";
       if (ss < count - 1)
-	iStream << "/Next " << (obj + ss + 2) << " 0 R\n";
+	iStream << "/Next " << ref(sub[ss + 1]) << "\n";
       iStream << ">> endobj\n";
     }
   }
@@ -1019,22 +1571,30 @@ void PdfWriter::createTrailer()
   iStream << "/Kids [ ";
   for (std::vector<int>::const_iterator it = iPageObjectNumbers.begin();
        it != iPageObjectNumbers.end(); ++it)
-    iStream << (*it) << " 0 R ";
+    iStream << ref(*it) << " ";
   iStream << "]\n>> endobj\n";
   // create /Catalog
   int catalogobj = startObject();
   iStream << "<<\n/Type /Catalog\n/Pages 2 0 R\n";
+  if (iUpdate && iDoc->hasTransparency()
+      && std::strncmp(iPrevious->data(), "%PDF-1.4", 8) < 0)
+    iStream << "/Version /1.4\n";  // header of previous version
   if (props.iFullScreen)
     iStream << "/PageMode /FullScreen\n";
   if (iBookmarks >= 0) {
     if (!props.iFullScreen)
       iStream << "/PageMode /UseOutlines\n";
-    iStream << "/Outlines " << iBookmarks << " 0 R\n";
+    iStream << "/Outlines " << ref(iBookmarks) << "\n";
+  }
+  int totalViews = 0;
+  for (int page = iFromPage; page <= iToPage; ++page) {
+    int nviews = iDoc->page(page)->countViews();
+    totalViews += (nviews > 0) ? nviews : 1;
   }
-  if (iDoc->countTotalViews() > 1) {
+  if (totalViews > 1) {
     iStream << "/PageLabels << /Nums [ ";
     int count = 0;
-    for (int page = 0; page < iDoc->countPages(); ++page) {
+    for (int page = iFromPage; page <= iToPage; ++page) {
       if (!iMarkedView || iDoc->page(page)->marked()) {
 	int nviews = iMarkedView ? iDoc->page(page)->countMarkedViews() :
 	  iDoc->page(page)->countViews();
@@ -1080,6 +1640,10 @@ void PdfWriter::createTrailer()
   iStream << "/ModDate (" << props.iModified << ")\n";
   iStream << ">> endobj\n";
   // create Xref
+  if (iUpdate) {
+    createUpdateXRef(catalogobj, infoobj);
+    return;
+  }
   long xrefpos = iStream.tell();
   iStream << "xref\n0 " << iObjNum << "\n";
   for (int obj = 0; obj < iObjNum; ++obj) {
@@ -1095,9 +1659,72 @@ void PdfWriter::createTrailer()
   }
   iStream << "trailer\n<<\n";
   iStream << "/Size " << iObjNum << "\n";
-  iStream << "/Root " << catalogobj << " 0 R\n";
-  iStream << "/Info " << infoobj << " 0 R\n";
+  iStream << "/Root " << ref(catalogobj) << "\n";
+  iStream << "/Info " << ref(infoobj) << "\n";
+  iStream << ">>\nstartxref\n" << int(xrefpos) << "\n%%EOF\n";
+}
+
+//! Create the cross-reference table and trailer of an update.
+/*! The table lists the objects that have been written, and marks
+  the objects of the previous version that are no longer used as
+  free.  Unchanged objects are found through the previous table. */
+void PdfWriter::createUpdateXRef(int catalogobj, int infoobj)
+{
+  iUpdate->finish();
+  int size = std::max(iObjNum, iPrevious->countObjects());
+  std::vector<String> entries(size);
+  for (int obj = 1; obj < size; ++obj) {
+    std::map<int, long>::const_iterator it = iXref.find(obj);
+    char s[32];
+    if (it != iXref.end()) {
+      long pos = it->second;
+      if (iUpdate->iUnchanged.count(obj)) {
+	// the table must not be empty, so the catalog is always listed
+	if (obj != catalogobj)
+	  continue;
+	pos = iPrevious->objectOffset(obj);
+      }
+      std::sprintf(s, "%010ld %05d n \n", pos, generation(obj));
+      entries[obj] = s;
+    } else if (iPrevious->objectOffset(obj) >= 0) {
+      // the generation is incremented when the number is freed, but
+      // stays at 65535, and then the number is never used again
+      std::sprintf(s, "0000000000 %05d f \n",
+		   std::min(generation(obj) + 1, 65535));
+      entries[obj] = s;
+    }
+  }
+  long xrefpos = iStream.tell();
+  iStream << "xref\n";
+  int obj = 1;
+  while (obj < size) {
+    if (entries[obj].empty()) {
+      ++obj;
+      continue;
+    }
+    // a section of consecutive entries
+    int first = obj;
+    while (obj < size && !entries[obj].empty())
+      ++obj;
+    iStream << first << " " << (obj - first) << "\n";
+    for (int i = first; i < obj; ++i)
+      iStream << entries[i]; // note the final space!
+  }
+  iStream << "trailer\n<<\n";
+  iStream << "/Size " << size << "\n";
+  iStream << "/Root " << ref(catalogobj) << "\n";
+  iStream << "/Info " << ref(infoobj) << "\n";
+  iStream << "/Prev " << iPrevious->lastXRef() << "\n";
   iStream << ">>\nstartxref\n" << int(xrefpos) << "\n%%EOF\n";
 }
 
+//! Return fraction of the file that is garbage after an update.
+/*! This is the part of the file not used by the objects of the
+  current version (it excludes the final cross-reference table).
+  Returns 0.0 if no update has been created. */
+double PdfWriter::garbage() const
+{
+  return iUpdate ? iUpdate->garbage() : 0.0;
+}
+
 // --------------------------------------------------------------------
@@ -37,8 +37,12 @@
 #include <direct.h>
 #else
 #include <sys/wait.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <pthread.h>
 #endif
 #include <cstdlib>
+#include <climits>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <stdarg.h>
@@ -104,6 +108,8 @@ void Platform::initLib(int version)
     showDebug = true;
   debugHandler = debugHandlerImpl;
   atexit(cleanup_repository);
+  // create repository now, before any threads can race to do so
+  Repository::get();
   if (version == IPELIB_VERSION)
     return;
   fprintf(stderr,
@@ -245,6 +251,58 @@ String Platform::latexDirectory()
 #endif
 }
 
+//! Returns directory for cache files.
+/*! The directory is created if it does not exist.  Returns an empty
+  string if the directory cannot be found or cannot be created.
+  The directory returned ends in the path separator.
+
+  The location can be set using the environment variable IPECACHEDIR.
+ */
+String Platform::cacheDirectory()
+{
+  const char *p = getenv("IPECACHEDIR");
+  String cacheDir;
+#ifdef __MINGW32__
+  if (p) {
+    cacheDir = p;
+  } else {
+    TCHAR szPath[MAX_PATH];
+    String base;
+    if (SUCCEEDED(SHGetFolderPath(NULL, CSIDL_LOCAL_APPDATA,
+				  NULL, 0, szPath)))
+      base = String(szPath) + "\\ipe";
+    else if ((p = getenv("LOCALAPPDATA")) != 0)
+      base = String(p) + "\\ipe";
+    else
+      return String();
+    if (!fileExists(base) && _mkdir(base.z()) != 0)
+      return String();
+    cacheDir = base + "\\cache";
+  }
+  if (cacheDir.right(1) == "\\")
+    cacheDir = cacheDir.left(cacheDir.size() - 1);
+  if (!fileExists(cacheDir) && _mkdir(cacheDir.z()) != 0)
+    return String();
+  cacheDir += "\\";
+#else
+  if (p) {
+    cacheDir = p;
+    if (cacheDir.right(1) == "/")
+      cacheDir = cacheDir.left(cacheDir.size() - 1);
+  } else {
+    String dir = dotIpe();
+    if (dir.empty())
+      return String();
+    cacheDir = dir + "cache";
+  }
+  if (cacheDir.empty() ||
+      (!fileExists(cacheDir) && mkdir(cacheDir.z(), 0700) != 0))
+    return String();
+  cacheDir += "/";
+#endif
+  return cacheDir;
+}
+
 //! Returns filename of fontmap.
 String Platform::fontmapFile()
 {
@@ -332,6 +390,339 @@ int Platform::runPdfLatex(String dir)
 
 // --------------------------------------------------------------------
 
+/*! \class ipe::MappedFileSource
+  \ingroup base
+  \brief Data source for parsing from a memory-mapped file.
+
+  The entire file is mapped into memory, so getBlock() returns the
+  remaining contents of the file as a single block without copying,
+  and parsers can also access the file contents directly using data()
+  and size().  Use isOpen() to check whether the file could be opened
+  and mapped.
+
+  Files that cannot be mapped, such as pipes or devices, are read into
+  memory through the C standard library instead.  isMapped() tells
+  the two cases apart.  Files of 2GB or more are not opened at all,
+  and must be read using a FileSource.
+*/
+
+// Read the entire file into memory allocated using malloc, and close it.
+static bool readWholeFile(std::FILE *fd, const char *&data, int &size)
+{
+  if (!fd)
+    return false;
+  char *buf = 0;
+  int n = 0;
+  int cap = 0;
+  bool ok = true;
+  for (;;) {
+    if (n == cap) {
+      if (cap > INT_MAX / 2) {
+	ok = false;
+	break;
+      }
+      cap = cap ? 2 * cap : 0x10000;
+      char *p = (char *) std::realloc(buf, cap);
+      if (!p) {
+	ok = false;
+	break;
+      }
+      buf = p;
+    }
+    size_t k = std::fread(buf + n, 1, cap - n, fd);
+    if (k == 0)
+      break;
+    n += int(k);
+  }
+  ok = !std::ferror(fd) && ok;
+  std::fclose(fd);
+  if (!ok || n == 0) {
+    std::free(buf);
+    if (ok)
+      data = "";
+    return ok;
+  }
+  data = buf;
+  size = n;
+  return true;
+}
+
+//! Open and map the file \a fname.
+MappedFileSource::MappedFileSource(const char *fname)
+{
+  iData = 0;
+  iSize = 0;
+  iPos = 0;
+  iHandle = 0;
+  iMapped = false;
+#ifdef WIN32
+  HANDLE file = CreateFileA(fname, GENERIC_READ, FILE_SHARE_READ, 0,
+			    OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+  if (file == INVALID_HANDLE_VALUE)
+    return;
+  if (GetFileType(file) != FILE_TYPE_DISK) {
+    CloseHandle(file);
+    readWholeFile(std::fopen(fname, "rb"), iData, iSize);
+    return;
+  }
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(file, &size) || size.QuadPart > INT_MAX) {
+    CloseHandle(file);
+    return;
+  }
+  if (size.QuadPart == 0) {
+    CloseHandle(file);
+    iData = "";
+    return;
+  }
+  HANDLE mapping = CreateFileMappingA(file, 0, PAGE_READONLY, 0, 0, 0);
+  CloseHandle(file);
+  if (!mapping)
+    return;
+  void *p = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  if (!p) {
+    CloseHandle(mapping);
+    return;
+  }
+  iHandle = mapping;
+  iData = (const char *) p;
+  iSize = int(size.QuadPart);
+  iMapped = true;
+#else
+  int fd = open(fname, O_RDONLY);
+  if (fd < 0)
+    return;
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    return;
+  }
+  if (!S_ISREG(st.st_mode)) {
+    // a pipe cannot be opened a second time
+    std::FILE *file = fdopen(fd, "rb");
+    if (!file)
+      close(fd);
+    readWholeFile(file, iData, iSize);
+    return;
+  }
+  if (st.st_size > INT_MAX) {
+    close(fd);
+    return;
+  }
+  if (st.st_size == 0) {
+    close(fd);
+    iData = "";
+    return;
+  }
+  void *p = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (p == MAP_FAILED)
+    return;
+  iData = (const char *) p;
+  iSize = int(st.st_size);
+  iMapped = true;
+#endif
+}
+
+//! Unmap the file.
+MappedFileSource::~MappedFileSource()
+{
+  if (iSize == 0)
+    return;
+  if (!iMapped) {
+    std::free((void *) iData);
+    return;
+  }
+#ifdef WIN32
+  UnmapViewOfFile(iData);
+  CloseHandle((HANDLE) iHandle);
+#else
+  munmap((void *) iData, iSize);
+#endif
+}
+
+int MappedFileSource::getChar()
+{
+  if (iPos >= iSize)
+    return EOF;
+  return uchar(iData[iPos++]);
+}
+
+//! Returns the remaining contents of the file in a single block.
+int MappedFileSource::getBlock(const char *&data, char *, int)
+{
+  int n = iSize - iPos;
+  if (n <= 0)
+    return 0;
+  data = iData + iPos;
+  iPos = iSize;
+  return n;
+}
+
+// --------------------------------------------------------------------
+
+/*! \class ipe::ReadWriteLock
+  \ingroup base
+  \brief A lock that can be held by many readers or a single writer.
+
+  Used to protect data that is read often by several threads, but
+  changed only rarely.
+*/
+
+//! Create an unlocked lock.
+ReadWriteLock::ReadWriteLock()
+{
+#ifdef WIN32
+  SRWLOCK *lock = new SRWLOCK;
+  InitializeSRWLock(lock);
+#else
+  pthread_rwlock_t *lock = new pthread_rwlock_t;
+  pthread_rwlock_init(lock, 0);
+#endif
+  iHandle = lock;
+}
+
+ReadWriteLock::~ReadWriteLock()
+{
+#ifdef WIN32
+  delete (SRWLOCK *) iHandle;
+#else
+  pthread_rwlock_destroy((pthread_rwlock_t *) iHandle);
+  delete (pthread_rwlock_t *) iHandle;
+#endif
+}
+
+//! Acquire the lock for reading.
+void ReadWriteLock::lockRead()
+{
+#ifdef WIN32
+  AcquireSRWLockShared((SRWLOCK *) iHandle);
+#else
+  pthread_rwlock_rdlock((pthread_rwlock_t *) iHandle);
+#endif
+}
+
+//! Release the lock acquired with lockRead().
+void ReadWriteLock::unlockRead()
+{
+#ifdef WIN32
+  ReleaseSRWLockShared((SRWLOCK *) iHandle);
+#else
+  pthread_rwlock_unlock((pthread_rwlock_t *) iHandle);
+#endif
+}
+
+//! Acquire the lock exclusively, for writing.
+void ReadWriteLock::lockWrite()
+{
+#ifdef WIN32
+  AcquireSRWLockExclusive((SRWLOCK *) iHandle);
+#else
+  pthread_rwlock_wrlock((pthread_rwlock_t *) iHandle);
+#endif
+}
+
+//! Release the lock acquired with lockWrite().
+void ReadWriteLock::unlockWrite()
+{
+#ifdef WIN32
+  ReleaseSRWLockExclusive((SRWLOCK *) iHandle);
+#else
+  pthread_rwlock_unlock((pthread_rwlock_t *) iHandle);
+#endif
+}
+
+// --------------------------------------------------------------------
+
+/*! \class ipe::Thread
+  \ingroup base
+  \brief A thread of execution.
+
+  Derive from Thread and implement run().  The thread starts running
+  when start() is called, and wait() blocks until it has finished.
+  The Thread object must not be destroyed while the thread is running.
+*/
+
+//! Create a thread object (the thread is not started yet).
+Thread::Thread()
+{
+  iHandle = 0;
+}
+
+//! Destructor waits for the thread to finish.
+Thread::~Thread()
+{
+  wait();
+}
+
+#ifdef WIN32
+DWORD WINAPI Thread::entry(void *thread)
+#else
+void *Thread::entry(void *thread)
+#endif
+{
+  ((Thread *) thread)->run();
+  return 0;
+}
+
+//! Start executing run() in a new thread.
+/*! Returns false if the thread could not be created. */
+bool Thread::start()
+{
+  assert(iHandle == 0);
+#ifdef WIN32
+  HANDLE h = CreateThread(0, 0, &Thread::entry, this, 0, 0);
+  if (h == 0)
+    return false;
+  iHandle = h;
+#else
+  pthread_t *t = new pthread_t;
+  if (pthread_create(t, 0, &Thread::entry, this) != 0) {
+    delete t;
+    return false;
+  }
+  iHandle = t;
+#endif
+  return true;
+}
+
+//! Wait until the thread has finished.
+/*! Returns immediately if the thread was never started. */
+void Thread::wait()
+{
+  if (iHandle == 0)
+    return;
+#ifdef WIN32
+  WaitForSingleObject((HANDLE) iHandle, INFINITE);
+  CloseHandle((HANDLE) iHandle);
+#else
+  pthread_join(*(pthread_t *) iHandle, 0);
+  delete (pthread_t *) iHandle;
+#endif
+  iHandle = 0;
+}
+
+//! Return the number of threads that can usefully run in parallel.
+/*! This is the number of processors, unless the environment variable
+  IPETHREADS is set. */
+int Thread::idealCount()
+{
+  const char *p = getenv("IPETHREADS");
+  int n = p ? atoi(p) : 0;
+  if (n <= 0) {
+#ifdef WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    n = info.dwNumberOfProcessors;
+#else
+    n = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+  }
+  return n < 1 ? 1 : n;
+}
+
+// --------------------------------------------------------------------
+
 void ipeAssertionFailed(const char *file, int line, const char *assertion)
 {
   fprintf(stderr, "Assertion failed on line #%d (%s): '%s'\n",
@@ -358,6 +358,8 @@ bool PsWriter::createHeader(int pno, int view)
   iStream << "ipe begin\n";
 
   if (pool) {
+    CharacterFinder cf;
+    iDoc->findCharacters(cf, pno, pno);
     for (FontPool::const_iterator font = pool->begin();
 	 font != pool->end(); ++font) {
 
@@ -365,7 +367,12 @@ bool PsWriter::createHeader(int pno, int view)
 	iStream << "%%IncludeResource: font " << font->iName << "\n";
       } else {
 	iStream << "%%BeginResource: font " << font->iName << "\n";
-	embedFont(*font);
+	Font sub;
+	if (cf.complete(font->iLatexNumber)
+	    && font->subset(cf.iCodes[font->iLatexNumber], sub))
+	  embedFont(sub);
+	else
+	  embedFont(*font);
 	iStream << "%%EndResource\n";
       }
 
@@ -955,6 +955,100 @@ static Matrix getMatrix(std::vector<double> &args)
   return m;
 }
 
+// --------------------------------------------------------------------
+
+// Path data is either text, as in XML, or the binary encoding written
+// by XmlParser::compile.  The binary encoding starts with a zero byte,
+// followed by a sequence of
+//   - an operator letter,
+//   - 0x01, k, m: the number m / 10^k (k a byte, m a zigzag varint),
+//   - 0x02, d: the double d (8 bytes, little-endian).
+
+static inline bool isPathOperator(char ch)
+{
+  switch (ch) {
+  case 'h': case 'm': case 'l': case 'q': case 'c':
+  case 'a': case 's': case 'e': case 'u':
+    return true;
+  default:
+    return false;
+  }
+}
+
+// Returns the operators and numbers of path data.
+class PathReader {
+public:
+  PathReader(String data);
+  bool eos() const;
+  char next(double &num);
+private:
+  Lex iLex;
+  String iData;
+  bool iBinary;
+  int iPos;
+};
+
+PathReader::PathReader(String data)
+  : iLex(data), iData(data)
+{
+  iBinary = (data.size() > 0 && data[0] == '\0');
+  iPos = 1;
+}
+
+bool PathReader::eos() const
+{
+  return iBinary ? (iPos >= iData.size()) : iLex.eos();
+}
+
+// Returns the next operator, or zero if the next token is a number.
+char PathReader::next(double &num)
+{
+  if (!iBinary) {
+    Lex::Token tok = iLex.tokenView();
+    char op = 0;
+    if (tok.iSize == 1 && isPathOperator(tok.iData[0])) {
+      op = tok.iData[0];
+      iLex.nextTokenView(); // eat token
+    } else
+      iLex >> num;
+    iLex.skipWhitespace();
+    return op;
+  }
+
+  static const double pow10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9 };
+  const uchar *p = (const uchar *) iData.data();
+  int size = iData.size();
+  num = 0.0;
+  char op = char(p[iPos++]);
+  if (op == 1 && iPos < size) {
+    int k = p[iPos++];
+    unsigned long long m = 0;
+    int shift = 0;
+    while (iPos < size && (p[iPos] & 0x80)) {
+      m |= (unsigned long long)(p[iPos++] & 0x7f) << shift;
+      shift += 7;
+    }
+    if (iPos < size)
+      m |= (unsigned long long)(p[iPos++]) << shift;
+    long long v = (long long)(m >> 1) ^ -(long long)(m & 1);
+    if (k < 10)
+      num = double(v) / pow10[k];
+    return 0;
+  } else if (op == 2 && iPos + 8 <= size) {
+    unsigned long long bits = 0;
+    for (int i = 7; i >= 0; --i)
+      bits = (bits << 8) | p[iPos + i];
+    iPos += 8;
+    memcpy(&num, &bits, 8);
+    return 0;
+  } else if (!isPathOperator(op))
+    iPos = size; // invalid data
+  return op;
+}
+
+// --------------------------------------------------------------------
+
 //! Save Shape onto XML stream.
 void Shape::save(Stream &stream) const
 {
@@ -967,55 +1061,53 @@ void Shape::save(Stream &stream) const
   false if the path syntax is incorrect (the Shape will be in an
   inconsistent state and must be discarded).
 
+  \a data can also be the binary encoding of path data written by
+  XmlParser::compile.
+
   This method can only be used during construction of the Shape.  It
   will panic if the implementation has been shared. */
 bool Shape::load(String data)
 {
   assert(iImp->iRefCount == 1);
-  Lex stream(data);
-  String word;
-  String type;
+  PathReader stream(data);
   Curve *sp = 0;
   Vector org;
   std::vector<double> args;
-  do {
-    if (stream.token() == "h") { // closing path
+  while (!stream.eos()) {
+    double num;
+    char op = stream.next(num);
+    if (op == 'h') { // closing path
       if (!sp)
 	return false;
-      stream.nextToken(); // eat token
       sp->setClosed(true);
       sp = 0;
-    } else if (stream.token() == "m") {
+    } else if (op == 'm') {
       if (args.size() != 2)
 	return false;
-      stream.nextToken(); // eat token
       // begin new subpath
       sp = new Curve;
       appendSubPath(sp);
       org = getVector(args);
-    } else if (stream.token() == "l") {
+    } else if (op == 'l') {
       // assert(sp && args.size() > 0 && (args.size() % 2 == 0));
       if (!sp || args.size() != 2)
 	return false;
-      stream.nextToken(); // eat token
       while (!args.empty()) {
 	Vector v = getVector(args);
 	sp->appendSegment(org, v);
 	org = v;
       }
-    } else if (stream.token() == "q") {
+    } else if (op == 'q') {
       if (!sp || args.size() != 4)
 	return false;
-      stream.nextToken();
       Vector v1 = getVector(args);
       Vector v2 = getVector(args);
       sp->appendQuad(org, v1, v2);
       org = v2;
-    } else if (stream.token() == "c") {
+    } else if (op == 'c') {
       // assert(sp && args.size() >= 6 && (args.size() % 6 == 0));
       if (!sp || args.size() != 6)
 	return false;
-      stream.nextToken();
       while (!args.empty()) {
 	Vector v1 = getVector(args);
 	Vector v2 = getVector(args);
@@ -1023,48 +1115,42 @@ bool Shape::load(String data)
 	sp->appendBezier(org, v1, v2, v3);
 	org = v3;
       }
-    } else if (stream.token() == "a") {
+    } else if (op == 'a') {
       if (!sp || args.size() != 8)
 	return false;
-      stream.nextToken();
       Matrix m = getMatrix(args);
       Vector v1 = getVector(args);
       sp->appendArc(m, org, v1);
       org = v1;
-    } else if (stream.token() == "s") {
+    } else if (op == 's') {
       if (!sp || args.size() < 2 || (args.size() % 2 != 0))
 	return false;
-      stream.nextToken();
       std::vector<Vector> v;
       v.push_back(org);
       while (!args.empty())
 	v.push_back(getVector(args));
       sp->appendSpline(v);
       org = v.back();
-    } else if (stream.token() == "e") {
+    } else if (op == 'e') {
       if (args.size() != 6)
 	return false;
-      stream.nextToken();
       sp = 0;
       Ellipse *e = new Ellipse(getMatrix(args));
       appendSubPath(e);
-    } else if (stream.token() == "u") {
+    } else if (op == 'u') {
       if (args.size() < 6 || (args.size() % 2 != 0))
 	return false;
-      stream.nextToken();
       sp = 0;
       std::vector<Vector> v;
       while (!args.empty())
 	v.push_back(getVector(args));
       ClosedSpline *e = new ClosedSpline(v);
       appendSubPath(e);
-    } else { // must be a number
-      double num;
-      stream >> num;
+    } else if (op == 0) { // a number
       args.push_back(num);
-    }
-    stream.skipWhitespace();
-  } while (!stream.eos());
+    } else
+      return false;
+  }
   // sanity checks
   if (countSubPaths() == 0)
     return false;
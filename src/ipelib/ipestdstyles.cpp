@@ -1,5 +1,5 @@
 // --------------------------------------------------------------------
-// Standard Ipe style (embedded in Ipelib)
+// Standard Ipe style (embedded in Ipelib), loading style sheets
 // --------------------------------------------------------------------
 /*
 
@@ -95,3 +95,108 @@ StyleSheet *StyleSheet::standard()
 }
 
 // --------------------------------------------------------------------
+
+static const int cacheHeaderSize = 24;
+// number of entries kept in the cache
+static const int cacheSlots = 64;
+
+static void makeCacheHeader(char *header, int size, unsigned long long hash)
+{
+  memcpy(header, "IpeStyle", 8);
+  unsigned long long vals[2] = {
+    (unsigned long long)(uint(IPELIB_VERSION))
+    | ((unsigned long long)(uint(size)) << 32), hash };
+  for (int i = 0; i < 2; ++i) {
+    for (int j = 0; j < 8; ++j)
+      header[8 + 8 * i + j] = char((vals[i] >> (8 * j)) & 0xff);
+  }
+}
+
+// A cache entry consists of the header, identifying the style sheet
+// source by its size and 64-bit hash, and the binary XML.
+static StyleSheet *loadCached(String cacheName, const char *header)
+{
+  MappedFileSource cache(cacheName.z());
+  if (!cache.isOpen() || cache.size() < cacheHeaderSize ||
+      memcmp(cache.data(), header, cacheHeaderSize))
+    return 0;
+  cache.setPosition(cacheHeaderSize);
+  ImlParser parser(cache);
+  if (!parser.isBinary())
+    return 0;
+  return parser.parseStyleSheet();
+}
+
+static void saveCached(String cacheName, const char *header, String data)
+{
+  String tmpName = cacheName + ".tmp";
+  std::FILE *fd = std::fopen(tmpName.z(), "wb");
+  if (!fd)
+    return;
+  bool ok = (std::fwrite(header, 1, cacheHeaderSize, fd) == cacheHeaderSize
+	     && std::fwrite(data.data(), 1, data.size(), fd)
+	     == size_t(data.size()));
+  ok = (std::fclose(fd) == 0) && ok;
+  if (!ok || std::rename(tmpName.z(), cacheName.z()) != 0)
+    std::remove(tmpName.z());
+}
+
+//! Load a style sheet from a file.
+/*! Returns 0 if the file cannot be read or is not a valid style
+  sheet.  In the latter case, \a errorPos is set to the position of
+  the parsing error, otherwise it is set to -1.
+
+  Parsed style sheets are kept in binary XML form (see XmlParser) in
+  Platform::cacheDirectory().  An entry is identified by the size and
+  the 64-bit hash (Buffer::hash64) of the file contents.  If the cache
+  has an entry for the file, the style sheet is loaded from there
+  without parsing XML text.  Otherwise, or if the entry is damaged or
+  from a different version of Ipelib, the file is parsed and a new
+  entry is written.  The cache has a fixed number of slots, chosen by
+  the hash, and a new entry replaces the one in its slot.
+*/
+StyleSheet *StyleSheet::load(String fname, int &errorPos)
+{
+  errorPos = -1;
+  MappedFileSource source(fname.z());
+  if (!source.isOpen())
+    return 0;
+
+  String cacheDir = Platform::cacheDirectory();
+  if (!cacheDir.empty()) {
+    unsigned long long hash = Buffer::hash64(source.data(), source.size());
+    char header[cacheHeaderSize];
+    makeCacheHeader(header, source.size(), hash);
+    char name[20];
+    std::sprintf(name, "style-%02x.bin", int(hash % cacheSlots));
+    String cacheName = cacheDir + name;
+
+    StyleSheet *sheet = loadCached(cacheName, header);
+    if (sheet)
+      return sheet;
+
+    String data;
+    StringStream stream(data);
+    XmlParser compiler(source);
+    if (compiler.compile(stream)) {
+      Buffer buffer(data.data(), data.size());
+      BufferSource binary(buffer);
+      ImlParser parser(binary);
+      sheet = parser.parseStyleSheet();
+      if (sheet) {
+	saveCached(cacheName, header, data);
+	return sheet;
+      }
+    }
+    // parse the XML again to find position of error
+    source.setPosition(0);
+  }
+
+  ImlParser parser(source);
+  StyleSheet *sheet = parser.parseStyleSheet();
+  if (!sheet)
+    errorPos = parser.parsePosition();
+  return sheet;
+}
+
+// --------------------------------------------------------------------
@@ -112,10 +112,19 @@ Symbol::~Symbol()
 
 // --------------------------------------------------------------------
 
+//! Return a fresh modification stamp.
+/*! Stamps are unique across all style sheets. */
+static int newStamp()
+{
+  static int stamp = 0;
+  return ++stamp;
+}
+
 //! The default constructor creates an empty style sheet.
 StyleSheet::StyleSheet()
 {
   iStandard = false;
+  iStamp = 0;
   iTitleStyle.iDefined = false;
   iPageNumberStyle.iDefined = false;
   iTextPadding.iLeft = -1.0;
@@ -128,6 +137,7 @@ StyleSheet::StyleSheet()
 void StyleSheet::setLayout(const Layout &layout)
 {
   iLayout = layout;
+  iStamp = newStamp();
 }
 
 //! Return page layout (or 0 if none defined).
@@ -152,12 +162,14 @@ const TextPadding *StyleSheet::textPadding() const
 void StyleSheet::setTextPadding(const TextPadding &pad)
 {
   iTextPadding = pad;
+  iStamp = newStamp();
 }
 
 //! Set style of page titles.
 void StyleSheet::setTitleStyle(const TitleStyle &ts)
 {
   iTitleStyle = ts;
+  iStamp = newStamp();
 }
 
 //! Return title style (or 0 if none defined).
@@ -173,6 +185,7 @@ const StyleSheet::TitleStyle *StyleSheet::titleStyle() const
 void StyleSheet::setPageNumberStyle(const PageNumberStyle &pns)
 {
   iPageNumberStyle = pns;
+  iStamp = newStamp();
 }
 
 //! Return page number style.
@@ -189,6 +202,7 @@ void StyleSheet::addGradient(Attribute name, const Gradient &s)
 {
   assert(name.isSymbolic());
   iGradients[name.index()] = s;
+  iStamp = newStamp();
 }
 
 //! Find gradient in style sheet cascade.
@@ -208,6 +222,7 @@ void StyleSheet::addTiling(Attribute name, const Tiling &s)
 {
   assert(name.isSymbolic());
   iTilings[name.index()] = s;
+  iStamp = newStamp();
 }
 
 //! Find tiling in style sheet cascade.
@@ -226,6 +241,7 @@ void StyleSheet::addEffect(Attribute name, const Effect &e)
 {
   assert(name.isSymbolic());
   iEffects[name.index()] = e;
+  iStamp = newStamp();
 }
 
 const Effect *StyleSheet::findEffect(Attribute sym) const
@@ -245,18 +261,21 @@ const Effect *StyleSheet::findEffect(Attribute sym) const
 void StyleSheet::setLineCap(TLineCap s)
 {
   iLineCap = s;
+  iStamp = newStamp();
 }
 
 //! Set line join.
 void StyleSheet::setLineJoin(TLineJoin s)
 {
   iLineJoin = s;
+  iStamp = newStamp();
 }
 
 //! Set fill rule.
 void StyleSheet::setFillRule(TFillRule s)
 {
   iFillRule = s;
+  iStamp = newStamp();
 }
 
 // --------------------------------------------------------------------
@@ -279,6 +298,7 @@ void StyleSheet::addSymbol(Attribute name, const Symbol &symbol)
 {
   assert(name.isSymbolic());
   iSymbols[name.index()] = symbol;
+  iStamp = newStamp();
 }
 
 //! Find a symbol object with given name.
@@ -303,6 +323,7 @@ void StyleSheet::add(Kind kind, Attribute name, Attribute value)
   if (!name.isSymbolic())
     return;
   iMap[name.index() | (kind << SHIFT)] = value;
+  iStamp = newStamp();
 }
 
 //! Find a symbolic attribute.
@@ -569,13 +590,19 @@ void StyleSheet::saveAsXml(Stream &stream, bool saveBitmaps) const
   lookup is done from top to bottom, and returns as soon as a match is
   found. Ipe always appends the built-in "standard" style sheet at the
   bottom of the cascade.
+
+  To make lookups fast, the results of find(), findSymbol(),
+  findGradient(), findTiling(), findEffect() and findLayout() are taken
+  from flat tables that are built when they are first needed.  The
+  tables are discarded when a sheet is inserted or removed, or when one
+  of the style sheets has been modified.
 */
 
 //! Create an empty cascade.
 /*! This does not add the standard style sheet. */
 Cascade::Cascade()
 {
-  // nothing
+  iResolved = 0;
 }
 
 static void destruct_sheets(std::vector<StyleSheet *> &sheets)
@@ -590,6 +617,7 @@ static void destruct_sheets(std::vector<StyleSheet *> &sheets)
 //! Copy constructor.
 Cascade::Cascade(const Cascade &rhs)
 {
+  iResolved = 0;
   destruct_sheets(iSheets);
   for (int i = 0; i < rhs.count(); ++i)
     iSheets.push_back(new StyleSheet(*rhs.iSheets[i]));
@@ -599,6 +627,7 @@ Cascade::Cascade(const Cascade &rhs)
 Cascade &Cascade::operator=(const Cascade &rhs)
 {
   if (this != &rhs) {
+    invalidate();
     destruct_sheets(iSheets);
     for (int i = 0; i < rhs.count(); ++i)
       iSheets.push_back(new StyleSheet(*rhs.iSheets[i]));
@@ -609,6 +638,7 @@ Cascade &Cascade::operator=(const Cascade &rhs)
 //! Destructor.
 Cascade::~Cascade()
 {
+  invalidate();
   destruct_sheets(iSheets);
 }
 
@@ -616,6 +646,7 @@ Cascade::~Cascade()
 /*! Takes ownership of \a sheet. */
 void Cascade::insert(int index, StyleSheet *sheet)
 {
+  invalidate();
   iSheets.insert(iSheets.begin() + index, sheet);
 }
 
@@ -623,9 +654,108 @@ void Cascade::insert(int index, StyleSheet *sheet)
 /*! The old sheet is deleted. */
 void Cascade::remove(int index)
 {
+  invalidate();
   iSheets.erase(iSheets.begin() + index);
 }
 
+//! Discard the lookup tables.
+void Cascade::invalidate()
+{
+  delete iResolved;
+  iResolved = 0;
+}
+
+//! Build the lookup tables now.
+/*! Lookups build the tables when needed, so calling this is never
+  necessary.  However, building the tables is not thread-safe, while
+  lookups in existing tables are.  Call this before several threads
+  use the cascade at the same time. */
+void Cascade::resolve() const
+{
+  resolved();
+}
+
+template<class T>
+static void storeAt(std::vector<T> &table, int index, T value, T fill)
+{
+  if (index >= int(table.size()))
+    table.resize(index + 1, fill);
+  table[index] = value;
+}
+
+//! Return the lookup tables, building them if necessary.
+const Cascade::Resolved *Cascade::resolved() const
+{
+  if (iResolved) {
+    bool valid = (int(iResolved->iStamps.size()) == count());
+    for (int i = 0; valid && i < count(); ++i)
+      valid = (iResolved->iStamps[i] == iSheets[i]->stamp());
+    if (valid)
+      return iResolved;
+    delete iResolved;
+    iResolved = 0;
+  }
+
+  Resolved *r = new Resolved;
+  for (int i = 0; i < count(); ++i)
+    r->iStamps.push_back(iSheets[i]->stamp());
+
+  // go from bottom to top, so that definitions higher up win
+  AttributeSeq seq;
+  for (int i = count() - 1; i >= 0; --i) {
+    const StyleSheet *sheet = iSheets[i];
+    for (int kind = 0; kind <= EEffect; ++kind) {
+      seq.clear();
+      sheet->allNames(Kind(kind), seq);
+      for (int j = 0; j < int(seq.size()); ++j) {
+	Attribute a = sheet->find(Kind(kind), seq[j]);
+	if (a != Attribute::UNDEFINED())
+	  storeAt(r->iAttributes[kind], seq[j].index(), a,
+		  Attribute::UNDEFINED());
+      }
+    }
+    seq.clear();
+    sheet->allNames(ESymbol, seq);
+    for (int j = 0; j < int(seq.size()); ++j)
+      storeAt(r->iSymbols, seq[j].index(), sheet->findSymbol(seq[j]),
+	      (const Symbol *) 0);
+    seq.clear();
+    sheet->allNames(EGradient, seq);
+    for (int j = 0; j < int(seq.size()); ++j)
+      storeAt(r->iGradients, seq[j].index(), sheet->findGradient(seq[j]),
+	      (const Gradient *) 0);
+    seq.clear();
+    sheet->allNames(ETiling, seq);
+    for (int j = 0; j < int(seq.size()); ++j)
+      storeAt(r->iTilings, seq[j].index(), sheet->findTiling(seq[j]),
+	      (const Tiling *) 0);
+    seq.clear();
+    sheet->allNames(EEffect, seq);
+    for (int j = 0; j < int(seq.size()); ++j)
+      storeAt(r->iEffects, seq[j].index(), sheet->findEffect(seq[j]),
+	      (const Effect *) 0);
+  }
+
+  for (int kind = 0; kind <= EEffect; ++kind) {
+    r->iNormal[kind] = Attribute::UNDEFINED();
+    Attribute normal = Attribute::normal(Kind(kind));
+    for (int i = 0; i < count(); ++i) {
+      Attribute a = iSheets[i]->find(Kind(kind), normal);
+      if (a != Attribute::UNDEFINED()) {
+	r->iNormal[kind] = a;
+	break;
+      }
+    }
+  }
+
+  r->iLayout = 0;
+  for (int i = 0; i < count() && !r->iLayout; ++i)
+    r->iLayout = iSheets[i]->layout();
+
+  iResolved = r;
+  return r;
+}
+
 void Cascade::saveAsXml(Stream &stream) const
 {
   for (int i = count() - 1; i >= 0; --i) {
@@ -643,69 +773,56 @@ bool Cascade::has(Kind kind, Attribute sym) const
   return false;
 }
 
+template<class T>
+static inline T lookupIn(const std::vector<T> &table, Attribute sym)
+{
+  if (!sym.isSymbolic() || sym.index() >= int(table.size()))
+    return T();
+  return table[sym.index()];
+}
+
 Attribute Cascade::find(Kind kind, Attribute sym) const
 {
-  for (int i = 0; i < count(); ++i) {
-    Attribute a = iSheets[i]->find(kind, sym);
-    if (a != Attribute::UNDEFINED())
-      return a;
-  }
-  Attribute normal = Attribute::normal(kind);
-  for (int i = 0; i < count(); ++i) {
-    Attribute a = iSheets[i]->find(kind, normal);
+  if (!sym.isSymbolic())
+    return count() > 0 ? sym : Attribute::UNDEFINED();
+  const Resolved *r = resolved();
+  const std::vector<Attribute> &table = r->iAttributes[kind];
+  if (sym.index() < int(table.size())) {
+    Attribute a = table[sym.index()];
     if (a != Attribute::UNDEFINED())
       return a;
   }
-  // this shouldn't happen
-  return Attribute::UNDEFINED();
+  // this should not be undefined
+  return r->iNormal[kind];
 }
 
 const Symbol *Cascade::findSymbol(Attribute sym) const
 {
-  for (int i = 0; i < count(); ++i) {
-    const Symbol *s = iSheets[i]->findSymbol(sym);
-    if (s) return s;
-  }
-  return 0;
+  return lookupIn(resolved()->iSymbols, sym);
 }
 
 const Gradient *Cascade::findGradient(Attribute sym) const
 {
-  for (int i = 0; i < count(); ++i) {
-    const Gradient *s = iSheets[i]->findGradient(sym);
-    if (s) return s;
-  }
-  return 0;
+  return lookupIn(resolved()->iGradients, sym);
 }
 
 const Tiling *Cascade::findTiling(Attribute sym) const
 {
-  for (int i = 0; i < count(); ++i) {
-    const Tiling *s = iSheets[i]->findTiling(sym);
-    if (s) return s;
-  }
-  return 0;
+  return lookupIn(resolved()->iTilings, sym);
 }
 
 const Effect *Cascade::findEffect(Attribute sym) const
 {
-  for (int i = 0; i < count(); ++i) {
-    const Effect *s = iSheets[i]->findEffect(sym);
-    if (s) return s;
-  }
-  return 0;
+  return lookupIn(resolved()->iEffects, sym);
 }
 
 //! Find page layout (such as text margins).
 const Layout *Cascade::findLayout() const
 {
-  for (int i = 0; i < count(); ++i) {
-    const Layout *l = iSheets[i]->layout();
-    if (l) return l;
-  }
+  const Layout *l = resolved()->iLayout;
   // must never happen
-  assert(false);
-  return 0;
+  assert(l);
+  return l;
 }
 
 //! Find text padding (for text bbox computation).
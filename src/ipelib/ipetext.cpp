@@ -583,6 +583,33 @@ void Text::setXForm(XForm *xform) const
   }
 }
 
+// --------------------------------------------------------------------
+
+/*! \class ipe::Text::MRenderData
+  \ingroup obj
+  \brief Abstract base class for XForm data stored by a client.
+*/
+
+Text::MRenderData::~MRenderData()
+{
+  // nothing
+}
+
+//! Create an empty XForm.
+Text::XForm::XForm()
+{
+  iRefCount = 0;
+  iRender = 0;
+}
+
+//! Destroy XForm and the data cached by a client.
+Text::XForm::~XForm()
+{
+  delete iRender;
+}
+
+// --------------------------------------------------------------------
+
 //! Return position of reference point in text box coordinate system.
 /*! Assume a coordinate system where the text box has corners (0,0)
   and (Width(), TotalHeight()).  This function returns the coordinates
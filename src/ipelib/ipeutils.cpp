@@ -35,8 +35,13 @@
 #include "ipeimage.h"
 #include "ipetext.h"
 #include "ipelet.h"
+#include "ipepdfparser.h"
 
 #include <zlib.h>
+#include <climits>
+#ifdef IPE_USE_LIBDEFLATE
+#include <libdeflate.h>
+#endif
 
 using namespace ipe;
 
@@ -45,6 +50,10 @@ using namespace ipe;
 /*! \class ipe::BitmapFinder
   \ingroup high
   \brief A visitor that recursively scans objects and collects all bitmaps.
+
+  Each bitmap is collected only once, even if several images share it.
+  Bitmaps with equal contents that do not share their data are all
+  collected.
 */
 
 void BitmapFinder::scanPage(const Page *page)
@@ -61,7 +70,115 @@ void BitmapFinder::visitGroup(const Group *obj)
 
 void BitmapFinder::visitImage(const Image *obj)
 {
-  iBitmaps.push_back(obj->bitmap());
+  if (iFound.insert(obj->bitmap()).second)
+    iBitmaps.push_back(obj->bitmap());
+}
+
+// --------------------------------------------------------------------
+
+/*! \class ipe::CharacterFinder
+  \ingroup high
+  \brief A visitor that collects the character codes used by text objects.
+
+  The codes are found in the PDF code that Pdflatex created for each
+  text object, so Latex must have been run.  They are used to create
+  subsets of the embedded fonts.
+
+  Strings in hexadecimal form are not decoded, and XObjects drawn by a
+  text object are not scanned.  A font may only be subset if
+  complete() returns true for it.
+*/
+
+CharacterFinder::CharacterFinder()
+{
+  iXObject = false;
+}
+
+//! Have all character codes used with \a font been found?
+bool CharacterFinder::complete(int font) const
+{
+  return !iXObject && !iIncomplete.count(font);
+}
+
+//! Scan the objects and the title of the page.
+void CharacterFinder::scanPage(const Page *page)
+{
+  const Text *title = page->titleText();
+  if (title)
+    visitText(title);
+  for (int i = 0; i < page->count(); ++i)
+    page->object(i)->accept(*this);
+}
+
+void CharacterFinder::visitGroup(const Group *obj)
+{
+  for (Group::const_iterator it = obj->begin(); it != obj->end(); ++it)
+    (*it)->accept(*this);
+}
+
+// Returns false if a string is binary, and its codes are not known.
+static bool markCodes(std::vector<bool> &codes, const PdfObj *obj)
+{
+  if (obj->string()) {
+    if (obj->string()->binary())
+      return false;
+    String s = obj->string()->value();
+    for (int i = 0; i < s.size(); ++i)
+      codes[uchar(s[i])] = true;
+  } else if (obj->array()) {
+    bool ok = true;
+    for (int i = 0; i < obj->array()->count(); ++i)
+      ok = markCodes(codes, obj->array()->obj(i, 0)) && ok;
+    return ok;
+  }
+  return true;
+}
+
+void CharacterFinder::visitText(const Text *obj)
+{
+  const Text::XForm *xf = obj->getXForm();
+  if (!xf)
+    return;
+  BufferSource source(xf->iStream);
+  PdfParser parser(source);
+  std::vector<bool> *codes = 0;
+  int font = -1;
+  std::vector<const PdfObj *> args;
+  // eos() is already true for the last token if nothing follows it
+  while (parser.token().iType != PdfToken::EErr) {
+    PdfToken tok = parser.token();
+    if (tok.iType != PdfToken::EOp) {
+      const PdfObj *arg = parser.getObject();
+      if (!arg)
+	break;
+      args.push_back(arg);
+      continue;
+    }
+    parser.getToken();
+    if (tok.iString == "Tf" && args.size() == 2 && args[0]->name()) {
+      String name = args[0]->name()->value();
+      font = Lex(name.substr(1)).getInt();
+      std::vector<bool> &c = iCodes[font];
+      c.resize(0x100);
+      codes = &c;
+    } else if (codes && (tok.iString == "TJ" || tok.iString == "Tj"
+			 || tok.iString == "'" || tok.iString == "\"")) {
+      for (uint i = 0; i < args.size(); ++i) {
+	if (!markCodes(*codes, args[i]))
+	  iIncomplete.insert(font);
+      }
+    } else if (tok.iString == "Do") {
+      iXObject = true;
+    }
+    while (!args.empty()) {
+      delete args.back();
+      args.pop_back();
+    }
+  }
+  while (!args.empty()) {
+    delete args.back();
+    args.pop_back();
+  }
 }
 
 // --------------------------------------------------------------------
@@ -286,6 +403,40 @@ void Base64Stream::putChar(char ch)
   }
 }
 
+//! Encode a block of data.
+/*! Complete groups of three bytes are encoded directly into a local
+  buffer, avoiding a call to putChar() for every byte. */
+void Base64Stream::putRaw(const char *data, int size)
+{
+  const char *fin = data + size;
+  // complete a group started by putChar
+  while (iN > 0 && data < fin)
+    putChar(*data++);
+  char buf[0x1000];
+  char *q = buf;
+  while (fin - data >= 3) {
+    uint w = base64word((const uchar *) data);
+    data += 3;
+    q[3] = base64letter[w & 0x3f];
+    q[2] = base64letter[(w >> 6) & 0x3f];
+    q[1] = base64letter[(w >> 12) & 0x3f];
+    q[0] = base64letter[(w >> 18) & 0x3f];
+    q += 4;
+    iCol += 4;
+    if (iCol > 70) {
+      *q++ = '\n';
+      iCol = 0;
+    }
+    if (q - buf > int(sizeof(buf)) - 8) {
+      iStream.putRaw(buf, q - buf);
+      q = buf;
+    }
+  }
+  iStream.putRaw(buf, q - buf);
+  while (data < fin)
+    putChar(*data++);
+}
+
 void Base64Stream::close()
 {
   if (iN) {
@@ -449,65 +600,446 @@ int Base64Source::getChar()
   return iBuf[0];
 };
 
+//! Decode a block of Base64 data.
+/*! Decodes up to \a length bytes from the \a size characters at \a
+  data into \a out, and returns the number of bytes decoded.  Like
+  getChar(), this skips whitespace and stops at the first character
+  that is not part of the Base64 alphabet.  Groups of four letters are
+  decoded directly, so this is much faster than reading the data
+  through a Base64Source. */
+int Base64Source::decode(const char *data, int size, char *out, int length)
+{
+  const uchar *p = (const uchar *) data;
+  const uchar *fin = p + size;
+  char *q = out;
+  char *qfin = out + length;
+  while (q < qfin) {
+    // fast path: four letters and no padding
+    if (fin - p >= 4 && qfin - q >= 3
+	&& !base64illegal(p[0]) && !base64illegal(p[1])
+	&& !base64illegal(p[2]) && !base64illegal(p[3])
+	&& p[2] != '=' && p[3] != '=') {
+      uint w = (base64value(p[0]) << 18) | (base64value(p[1]) << 12)
+	| (base64value(p[2]) << 6) | base64value(p[3]);
+      q[0] = char(w >> 16);
+      q[1] = char(w >> 8);
+      q[2] = char(w);
+      q += 3;
+      p += 4;
+      continue;
+    }
+    // slow path: whitespace, padding, end of data
+    uchar buf[4];
+    for (int i = 0; i < 4; ++i) {
+      int ch;
+      do {
+	if (p == fin)
+	  return q - out;
+	ch = *p++;
+      } while (ch == '\n' || ch == '\r' || ch == ' ');
+      if (base64illegal(ch))
+	return q - out;
+      buf[i] = ch;
+    }
+    uint w = (base64value(buf[0]) << 18) | (base64value(buf[1]) << 12)
+      | (base64value(buf[2]) << 6) | base64value(buf[3]);
+    int n = 3;
+    if (buf[3] == '=') {
+      --n;
+      if (buf[2] == '=')
+	--n;
+    }
+    for (int i = 0; i < n && q < qfin; ++i)
+      *q++ = char(w >> (16 - 8 * i));
+  }
+  return q - out;
+}
+
 // --------------------------------------------------------------------
 
-/*! \class ipe::DeflateStream
+/*! \class ipe::Compression
   \ingroup high
-  \brief Filter stream adding flate compression.
+  \brief Interface to an implementation of flate compression.
+
+  DeflateStream, InflateSource, and PdfDict::inflate() do not call a
+  compression library themselves, but use the backend returned by
+  backend().
+
+  Ipelib always contains a backend using zlib.  zlib-ng can be used
+  instead in its zlib compatible form.  If Ipe has been compiled with
+  IPE_USE_LIBDEFLATE, there is a second backend, which is then the
+  default.  It uses libdeflate to compress and decompress data that
+  is entirely in memory, which is considerably faster than zlib.
+  libdeflate cannot work incrementally, so the filters of this
+  backend are those of zlib.
+
+  Compression levels range from 1 (fastest) to 12 (smallest).  zlib
+  treats levels above 9 as 9.
 */
 
-struct DeflateStream::Private {
+/*! \class ipe::Compression::Filter
+  \ingroup high
+  \brief Incremental compression or decompression of one stream.
+
+  The caller points the filter to its input and output buffers, and
+  calls run() until all input has been consumed.  When compressing,
+  run() is then called with \a finish set until it returns
+  EStreamEnd.
+*/
+
+Compression::Filter::~Filter()
+{
+  // nothing
+}
+
+Compression::~Compression()
+{
+  // nothing
+}
+
+//! \fn const char *Compression::name() const
+//! Return the name of the backend.
+
+//! \fn Compression::Filter *Compression::deflater(int level) const
+//! Create a filter compressing at \a level, or 0 if this fails.
+
+//! \fn Compression::Filter *Compression::inflater() const
+//! Create a filter decompressing a stream, or 0 if this fails.
+
+// Run a filter over the input, and collect its output.
+static Buffer runFilter(Compression::Filter *filter, const char *data,
+			int size, bool finish, int &outSize)
+{
+  String out;
+  if (filter) {
+    char buf[0x4000];
+    filter->iNextIn = data;
+    filter->iAvailIn = size;
+    Compression::Filter::TStatus status;
+    do {
+      filter->iNextOut = buf;
+      filter->iAvailOut = sizeof(buf);
+      status = filter->run(finish);
+      out.append(buf, filter->iNextOut - buf);
+    } while (status == Compression::Filter::EOk);
+    delete filter;
+  }
+  outSize = out.size();
+  return Buffer(out.data(), out.size());
+}
+
+//! Compress a buffer in a single run.
+/*! The returned buffer may be larger than necessary: \a deflatedSize
+  is set to the number of bytes actually used.  The default
+  implementation uses deflater(). */
+Buffer Compression::deflate(const char *data, int size,
+			    int &deflatedSize, int level) const
+{
+  return runFilter(deflater(level), data, size, true, deflatedSize);
+}
+
+//! Decompress a buffer in a single run.
+/*! If the data is damaged, returns what can be decompressed.  The
+  default implementation uses inflater(). */
+Buffer Compression::inflate(const char *data, int size) const
+{
+  int n;
+  return runFilter(inflater(), data, size, false, n);
+}
+
+//! Is deflate() faster than compressing through a DeflateStream?
+/*! If so, PdfWriter paints content streams into memory and compresses
+  them in a single run.  The default implementation returns false. */
+bool Compression::prefersBuffers() const
+{
+  return false;
+}
+
+// --------------------------------------------------------------------
+
+// Compression level understood by zlib.
+static int zlibLevel(int level)
+{
+  return (level > Z_BEST_COMPRESSION) ? Z_BEST_COMPRESSION : level;
+}
+
+class ZlibFilter : public Compression::Filter {
+public:
+  ZlibFilter(bool deflate);
+  virtual ~ZlibFilter();
+  bool init(int level);
+  virtual TStatus run(bool finish);
+private:
+  bool iDeflate;
+  bool iInit;
   z_stream iFlate;
 };
 
-DeflateStream::DeflateStream(Stream &stream, int level)
-  : iStream(stream), iIn(0x400), iOut(0x400) // create buffers
+ZlibFilter::ZlibFilter(bool deflate)
+  : iDeflate(deflate), iInit(false)
+{
+  iNextIn = 0;
+  iAvailIn = 0;
+  iNextOut = 0;
+  iAvailOut = 0;
+  iFlate.zalloc = Z_NULL;
+  iFlate.zfree = Z_NULL;
+  iFlate.opaque = Z_NULL;
+  iFlate.next_in = Z_NULL;
+  iFlate.avail_in = 0;
+}
+
+ZlibFilter::~ZlibFilter()
+{
+  if (iInit) {
+    if (iDeflate)
+      ::deflateEnd(&iFlate);
+    else
+      ::inflateEnd(&iFlate);
+  }
+}
+
+bool ZlibFilter::init(int level)
+{
+  int err = iDeflate ? ::deflateInit(&iFlate, zlibLevel(level))
+    : ::inflateInit(&iFlate);
+  if (err != Z_OK) {
+    ipeDebug("%s returns error %d",
+	     iDeflate ? "deflateInit" : "inflateInit", err);
+    return false;
+  }
+  iInit = true;
+  return true;
+}
+
+Compression::Filter::TStatus ZlibFilter::run(bool finish)
+{
+  iFlate.next_in = (Bytef *) iNextIn;
+  iFlate.avail_in = iAvailIn;
+  iFlate.next_out = (Bytef *) iNextOut;
+  iFlate.avail_out = iAvailOut;
+  int flush = finish ? Z_FINISH : Z_NO_FLUSH;
+  int err = iDeflate ? ::deflate(&iFlate, flush) : ::inflate(&iFlate, flush);
+  iNextIn = (const char *) iFlate.next_in;
+  iAvailIn = iFlate.avail_in;
+  iNextOut = (char *) iFlate.next_out;
+  iAvailOut = iFlate.avail_out;
+  if (err == Z_OK)
+    return EOk;
+  if (err == Z_STREAM_END)
+    return EStreamEnd;
+  ipeDebug("%s returns error %d", iDeflate ? "deflate" : "inflate", err);
+  return EError;
+}
+
+class ZlibCompression : public Compression {
+public:
+  virtual const char *name() const;
+  virtual Filter *deflater(int level) const;
+  virtual Filter *inflater() const;
+  virtual Buffer deflate(const char *data, int size,
+			 int &deflatedSize, int level) const;
+};
+
+const char *ZlibCompression::name() const
 {
-  iPriv = new Private;
-  z_streamp z = &iPriv->iFlate;
+  return "zlib";
+}
 
-  z->zalloc = 0;
-  z->zfree = 0;
-  z->opaque = 0;
+Compression::Filter *ZlibCompression::deflater(int level) const
+{
+  ZlibFilter *filter = new ZlibFilter(true);
+  if (!filter->init(level)) {
+    delete filter;
+    return 0;
+  }
+  return filter;
+}
+
+Compression::Filter *ZlibCompression::inflater() const
+{
+  ZlibFilter *filter = new ZlibFilter(false);
+  if (!filter->init(0)) {
+    delete filter;
+    return 0;
+  }
+  return filter;
+}
 
-  int err = ::deflateInit(z, level);
+Buffer ZlibCompression::deflate(const char *data, int size,
+				int &deflatedSize, int level) const
+{
+  uLong dfsize = ::compressBound(size);
+  Buffer deflatedData(dfsize);
+  int err = ::compress2((Bytef *) deflatedData.data(), &dfsize,
+			(const Bytef *) data, size, zlibLevel(level));
   if (err != Z_OK) {
-    ipeDebug("deflateInit returns error %d", err);
+    ipeDebug("Zlib compress2 returns errror %d", err);
     assert(false);
   }
+  deflatedSize = dfsize;
+  return deflatedData;
+}
+
+#ifdef IPE_USE_LIBDEFLATE
+class LibdeflateCompression : public ZlibCompression {
+public:
+  virtual const char *name() const;
+  virtual Buffer deflate(const char *data, int size,
+			 int &deflatedSize, int level) const;
+  virtual Buffer inflate(const char *data, int size) const;
+  virtual bool prefersBuffers() const;
+};
+
+const char *LibdeflateCompression::name() const
+{
+  return "libdeflate";
+}
+
+Buffer LibdeflateCompression::deflate(const char *data, int size,
+				      int &deflatedSize, int level) const
+{
+  libdeflate_compressor *c = libdeflate_alloc_compressor(level);
+  if (c) {
+    Buffer out(int(libdeflate_zlib_compress_bound(c, size)));
+    size_t n = libdeflate_zlib_compress(c, data, size, out.data(), out.size());
+    libdeflate_free_compressor(c);
+    if (n > 0) {
+      deflatedSize = int(n);
+      return out;
+    }
+  }
+  ipeDebug("libdeflate failed, using zlib");
+  return ZlibCompression::deflate(data, size, deflatedSize, level);
+}
 
+Buffer LibdeflateCompression::inflate(const char *data, int size) const
+{
+  libdeflate_decompressor *d = libdeflate_alloc_decompressor();
+  if (d) {
+    // the size of the result is not known, so try larger buffers
+    int n = (size < INT_MAX / 8) ? 4 * size + 0x1000 : INT_MAX / 2;
+    for (;;) {
+      Buffer out(n);
+      size_t actual;
+      libdeflate_result res =
+	libdeflate_zlib_decompress(d, data, size, out.data(), n, &actual);
+      if (res == LIBDEFLATE_SUCCESS) {
+	libdeflate_free_decompressor(d);
+	return Buffer(out.data(), int(actual));
+      }
+      if (res != LIBDEFLATE_INSUFFICIENT_SPACE || n > INT_MAX / 2)
+	break;
+      n *= 2;
+    }
+    libdeflate_free_decompressor(d);
+  }
+  // zlib returns what can be decompressed from damaged data
+  return ZlibCompression::inflate(data, size);
+}
+
+bool LibdeflateCompression::prefersBuffers() const
+{
+  return true;
+}
+#endif
+
+static const Compression *currentBackend = 0;
+
+//! Return the backend used by Ipelib.
+/*! This is the one set using setBackend(), or libdeflate() if Ipe has
+  been compiled with it, otherwise zlib(). */
+const Compression *Compression::backend()
+{
+  if (currentBackend)
+    return currentBackend;
+  const Compression *c = libdeflate();
+  return c ? c : zlib();
+}
+
+//! Set the backend used by Ipelib.
+/*! This must be done before the backend is used, in particular
+  before any document is loaded or saved.  Setting 0 restores the
+  default. */
+void Compression::setBackend(const Compression *backend)
+{
+  currentBackend = backend;
+}
+
+//! Return the backend using zlib.
+const Compression *Compression::zlib()
+{
+  static ZlibCompression backend;
+  return &backend;
+}
+
+//! Return the backend using libdeflate.
+/*! Returns 0 if Ipe has not been compiled with IPE_USE_LIBDEFLATE. */
+const Compression *Compression::libdeflate()
+{
+#ifdef IPE_USE_LIBDEFLATE
+  static LibdeflateCompression backend;
+  return &backend;
+#else
+  return 0;
+#endif
+}
+
+// --------------------------------------------------------------------
+
+/*! \class ipe::DeflateStream
+  \ingroup high
+  \brief Filter stream adding flate compression.
+
+  The stream uses a filter of Compression::backend().  Data that is
+  entirely in memory can be compressed faster using deflate().
+*/
+
+DeflateStream::DeflateStream(Stream &stream, int level)
+  : iStream(stream), iIn(0x400), iOut(0x400) // create buffers
+{
+  iFilter = Compression::backend()->deflater(level);
+  assert(iFilter);
   iN = 0;
 }
 
 DeflateStream::~DeflateStream()
 {
-  if (iPriv) {
-    z_streamp z = &iPriv->iFlate;
-    ::deflateEnd(z);
-    delete iPriv;
-  }
+  delete iFilter;
 }
 
 void DeflateStream::putChar(char ch)
 {
   iIn[iN++] = ch;
-  if (iN < iIn.size())
-    return;
+  if (iN == iIn.size())
+    flushInput();
+}
+
+void DeflateStream::putRaw(const char *data, int size)
+{
+  while (size > 0) {
+    int k = std::min(size, iIn.size() - iN);
+    memcpy(iIn.data() + iN, data, k);
+    iN += k;
+    data += k;
+    size -= k;
+    if (iN == iIn.size())
+      flushInput();
+  }
+}
 
-  // compress and write
-  z_streamp z = &iPriv->iFlate;
-  z->next_in = (Bytef *) iIn.data();
-  z->avail_in = iIn.size();
-  while (z->avail_in) {
-    z->next_out = (Bytef *) iOut.data();
-    z->avail_out = iOut.size();
-    int err = ::deflate(z, Z_NO_FLUSH);
-    if (err != Z_OK) {
-      ipeDebug("deflate returns error %d", err);
+//! Compress and write the full input buffer.
+void DeflateStream::flushInput()
+{
+  iFilter->iNextIn = iIn.data();
+  iFilter->iAvailIn = iIn.size();
+  while (iFilter->iAvailIn) {
+    iFilter->iNextOut = iOut.data();
+    iFilter->iAvailOut = iOut.size();
+    if (iFilter->run(false) != Compression::Filter::EOk)
       assert(false);
-    }
     // save output
-    iStream.putRaw(iOut.data(), z->next_out - (Bytef *) iOut.data());
+    iStream.putRaw(iOut.data(), iFilter->iNextOut - iOut.data());
   }
   iN = 0;
 }
@@ -515,49 +1047,101 @@ void DeflateStream::putChar(char ch)
 void DeflateStream::close()
 {
   // compress and write remaining data
-  z_streamp z = &iPriv->iFlate;
-  z->next_in = (Bytef *) iIn.data();
-  z->avail_in = iN;
+  iFilter->iNextIn = iIn.data();
+  iFilter->iAvailIn = iN;
 
-  int err;
+  Compression::Filter::TStatus status;
   do {
-    z->next_out = (Bytef *) iOut.data();
-    z->avail_out = iOut.size();
-    err = ::deflate(z, Z_FINISH);
-    if (err != Z_OK && err != Z_STREAM_END) {
-      ipeDebug("deflate returns error %d", err);
-      assert(false);
-    }
-    iStream.putRaw(iOut.data(), z->next_out - (Bytef *) iOut.data());
-  } while (err == Z_OK);
-
-  err = ::deflateEnd(z);
-  if (err != Z_OK) {
-    ipeDebug("deflateEnd returns error %d", err);
-    assert(false);
-  }
-
-  delete iPriv;
-  iPriv = 0; // make sure no more writing possible
+    iFilter->iNextOut = iOut.data();
+    iFilter->iAvailOut = iOut.size();
+    status = iFilter->run(true);
+    assert(status != Compression::Filter::EError);
+    iStream.putRaw(iOut.data(), iFilter->iNextOut - iOut.data());
+  } while (status == Compression::Filter::EOk);
+
+  delete iFilter;
+  iFilter = 0; // make sure no more writing possible
   iStream.close();
 }
 
 //! Deflate a buffer in a single run.
 /*! The returned buffer may be larger than necessary: \a deflatedSize
-  is set to the number of bytes actually used. */
+  is set to the number of bytes actually used.  See
+  Compression::deflate(). */
 Buffer DeflateStream::deflate(const char *data, int size,
 			      int &deflatedSize, int compressLevel)
 {
-  uLong dfsize = uLong(size * 1.001 + 13);
-  Buffer deflatedData(dfsize);
-  int err = ::compress2((Bytef *) deflatedData.data(), &dfsize,
-			(const Bytef *) data, size, compressLevel);
-  if (err != Z_OK) {
-    ipeDebug("Zlib compress2 returns errror %d", err);
+  return Compression::backend()->deflate(data, size, deflatedSize,
+					 compressLevel);
+}
+
+static void putUInt32(String &s, uLong v)
+{
+  for (int i = 24; i >= 0; i -= 8)
+    s.append(char((v >> i) & 0xff));
+}
+
+static uLong getUInt32(const String &s, int i)
+{
+  uLong v = 0;
+  for (int k = 0; k < 4; ++k)
+    v = (v << 8) | uchar(s[i + k]);
+  return v;
+}
+
+//! Deflate a buffer as a piece of a stream written by writePieces().
+/*! The piece is compressed independently of the data before and
+  after it, so it can be cached and reused in a stream whose other
+  pieces have changed.  The result starts with the Adler-32 checksum
+  and the length of \a data, followed by raw deflate data ending on a
+  byte boundary.  Pieces are always compressed using zlib. */
+String DeflateStream::deflatePiece(const char *data, int size,
+				   int compressLevel)
+{
+  String piece;
+  putUInt32(piece, ::adler32(::adler32(0, Z_NULL, 0),
+			     (const Bytef *) data, size));
+  putUInt32(piece, uLong(size));
+  z_stream flate;
+  flate.zalloc = Z_NULL;
+  flate.zfree = Z_NULL;
+  flate.opaque = Z_NULL;
+  if (::deflateInit2(&flate, zlibLevel(compressLevel), Z_DEFLATED, -15, 8,
+		     Z_DEFAULT_STRATEGY) != Z_OK)
     assert(false);
+  flate.next_in = (Bytef *) data;
+  flate.avail_in = size;
+  char buf[0x4000];
+  do {
+    flate.next_out = (Bytef *) buf;
+    flate.avail_out = sizeof(buf);
+    ::deflate(&flate, Z_SYNC_FLUSH);
+    piece.append(buf, (char *) flate.next_out - buf);
+  } while (flate.avail_out == 0);
+  ::deflateEnd(&flate);
+  return piece;
+}
+
+//! Write a complete zlib stream consisting of \a pieces.
+/*! The pieces must have been created by deflatePiece(). */
+void DeflateStream::writePieces(Stream &stream,
+				const std::vector<String> &pieces)
+{
+  stream.putChar(char(0x78));
+  stream.putChar(char(0x9c));
+  uLong adler = ::adler32(0, Z_NULL, 0);
+  for (uint i = 0; i < pieces.size(); ++i) {
+    const String &piece = pieces[i];
+    adler = ::adler32_combine(adler, getUInt32(piece, 0),
+			      z_off_t(getUInt32(piece, 4)));
+    stream.putRaw(piece.data() + 8, piece.size() - 8);
   }
-  deflatedSize = dfsize;
-  return deflatedData;
+  // an empty final block
+  stream.putChar(char(0x03));
+  stream.putChar(char(0x00));
+  String trailer;
+  putUInt32(trailer, adler);
+  stream << trailer;
 }
 
 // --------------------------------------------------------------------
@@ -565,100 +1149,83 @@ Buffer DeflateStream::deflate(const char *data, int size,
 /*! \class ipe::InflateSource
   \ingroup high
   \brief Filter source adding flate decompression.
-*/
 
-struct InflateSource::Private {
-  z_stream iFlate;
-};
+  The source uses a filter of Compression::backend().
+*/
 
 InflateSource::InflateSource(DataSource &source)
-  : iSource(source), iIn(0x400), iOut(0x400)
+  : iSource(source), iIn(0x4000), iOut(0x4000)
 {
-  iPriv = new Private;
-  z_streamp z = &iPriv->iFlate;
-
-  z->zalloc = Z_NULL;
-  z->zfree = Z_NULL;
-  z->opaque = Z_NULL;
+  iP = iOut.data();
+  iFilter = Compression::backend()->inflater();
+  if (!iFilter)
+    return; // set EOF
 
   fillBuffer();
-
-  int err = ::inflateInit(z);
-  if (err != Z_OK) {
-    ipeDebug("inflateInit returns error %d", err);
-    delete iPriv;
-    iPriv = 0;  // set EOF
-    return;
-  }
-
-  iP = iOut.data();
-  z->next_out = (Bytef *) iP;
+  iFilter->iNextOut = iP;
+  iFilter->iAvailOut = 0;
 }
 
 InflateSource::~InflateSource()
 {
-  if (iPriv) {
-    z_streamp z = &iPriv->iFlate;
-    ::inflateEnd(z);
-    delete iPriv;
-  }
+  delete iFilter;
 }
 
 void InflateSource::fillBuffer()
 {
-  char *p = iIn.data();
-  char *p1 = iIn.data() + iIn.size();
-  z_streamp z = &iPriv->iFlate;
-  z->next_in = (Bytef *) p;
-  z->avail_in = 0;
-  while (p < p1) {
-    int ch = iSource.getChar();
-    if (ch == EOF)
-      return;
-    *p++ = char(ch);
-    z->avail_in++;
-  }
+  // sources holding their data in memory hand it over without copying
+  const char *data;
+  int n = iSource.getBlock(data, iIn.data(), iIn.size());
+  iFilter->iNextIn = data;
+  iFilter->iAvailIn = (n > 0) ? n : 0;
 }
 
 //! Get one more character, or EOF.
 int InflateSource::getChar()
 {
-  if (!iPriv)
+  if (!iFilter)
     return EOF;
 
-  z_streamp z = &iPriv->iFlate;
-  if (iP < (char *) z->next_out)
-    return *iP++;
+  if (iP < iFilter->iNextOut)
+    return uchar(*iP++);
 
   // next to decompress some data
-  if (z->avail_in == 0)
+  if (iFilter->iAvailIn == 0)
     fillBuffer();
 
-  if (z->avail_in > 0) {
+  if (iFilter->iAvailIn > 0) {
     // data is available
-    z->next_out = (Bytef *) iOut.data();
-    z->avail_out = iOut.size();
-    int err = ::inflate(z, Z_NO_FLUSH);
-    if (err != Z_OK && err != Z_STREAM_END) {
-      ipeDebug("inflate returns error %d", err);
-      ::inflateEnd(z);
-      delete iPriv;
-      iPriv = 0;  // set EOF
+    iFilter->iNextOut = iOut.data();
+    iFilter->iAvailOut = iOut.size();
+    if (iFilter->run(false) == Compression::Filter::EError) {
+      delete iFilter;
+      iFilter = 0;  // set EOF
       return EOF;
     }
     iP = iOut.data();
-    if (iP < (char *) z->next_out)
-      return *iP++;
+    if (iP < iFilter->iNextOut)
+      return uchar(*iP++);
     // didn't get any new data, must be EOF
   }
 
   // fillBuffer didn't get any data, must be EOF, so we are done
-  ::inflateEnd(z);
-  delete iPriv;
-  iPriv = 0;
+  delete iFilter;
+  iFilter = 0;
   return EOF;
 }
 
+//! Return the decompressed data available in the output buffer.
+int InflateSource::getBlock(const char *&data, char *, int)
+{
+  // getChar() decompresses more data if necessary
+  if (getChar() == EOF)
+    return 0;
+  data = iP - 1;
+  int n = iFilter->iNextOut - data;
+  iP += n - 1;
+  return n;
+}
+
 // --------------------------------------------------------------------
 
 /*! \defgroup ipelet The Ipelet interface
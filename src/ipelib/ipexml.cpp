@@ -37,8 +37,54 @@ using namespace ipe;
 /*! \class ipe::XmlAttributes
   \ingroup base
   \brief Stores attributes of an XML tag.
+
+  The attributes are kept in a small vector, sorted by key.  Keys that
+  are attribute names used by Ipe are not copied, but point into a
+  fixed table of names.  clear() keeps the allocated memory, so the
+  same XmlAttributes can be reused for many tags without allocating.
+
+  begin() and end() iterate over the (key, value) pairs in order of
+  the keys, like the std::map used by earlier versions.
 */
 
+// Attribute names used in Ipe files, sorted as by strcmp
+static const char * const knownKeys[] = {
+  "BitsPerComponent", "ColorKey", "ColorSpace", "Filter", "active",
+  "angle", "arrow", "author", "begin", "bitmap", "bottom", "cap",
+  "clip", "color", "coords", "created", "creator", "crop", "dash",
+  "depth", "duration", "edit", "effect", "encoding", "end", "extend",
+  "fill", "fillrule", "font", "frame", "gradient", "halign", "height",
+  "id", "join", "keywords", "layer", "layers", "left", "length",
+  "marked", "matrix", "modified", "name", "numberpages", "offset",
+  "opacity", "origin", "pagemode", "paper", "pdfObject", "pen", "pin",
+  "pos", "rarrow", "rect", "right", "section", "size", "skip", "step",
+  "stroke", "style", "subject", "subsection", "tiling", "title", "top",
+  "transformations", "transition", "type", "valign", "value",
+  "version", "width", "xform" };
+
+static const int numKnownKeys = sizeof(knownKeys) / sizeof(knownKeys[0]);
+
+//! Find \a key in the table of known keys, return 0 if not found.
+static const char *knownKey(const char *key, int len)
+{
+  int lo = 0;
+  int hi = numKnownKeys;
+  while (lo < hi) {
+    int mid = (lo + hi) / 2;
+    int cmp = strncmp(knownKeys[mid], key, len);
+    if (cmp == 0) {
+      if (knownKeys[mid][len] == '\0')
+	return knownKeys[mid];
+      cmp = 1;  // key is a proper prefix of table entry
+    }
+    if (cmp < 0)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return 0;
+}
+
 //! Constructor for an empty collection.
 XmlAttributes::XmlAttributes()
 {
@@ -46,44 +92,88 @@ XmlAttributes::XmlAttributes()
 }
 
 //! Remove all attributes.
+/*! The memory used is kept for the next tag. */
 void XmlAttributes::clear()
 {
   iSlash = false;
-  iMap.clear();
+  iEntries.clear();
+  iOwnKeys.clear();
+}
+
+//! Return index of attribute with \a key, or -1.
+int XmlAttributes::find(const char *key) const
+{
+  for (int i = 0; i < int(iEntries.size()); ++i) {
+    if (!strcmp(iEntries[i].iKey, key))
+      return i;
+  }
+  return -1;
 }
 
 //! Return attribute with given key.
 /*! Returns an empty string if no attribute with this key exists. */
-String XmlAttributes::operator[](String str) const
+String XmlAttributes::operator[](const char *key) const
 {
-  std::map<String, String>::const_iterator it = iMap.find(str);
-  if (it == iMap.end())
+  int i = find(key);
+  if (i < 0)
     return String();
-  else
-    return it->second;
+  return iEntries[i].iValue;
+}
+
+//! Return attribute with given key.
+String XmlAttributes::operator[](String key) const
+{
+  return (*this)[key.z()];
 }
 
 //! Add a new attribute.
+/*! An attribute with the same key is replaced. */
 void XmlAttributes::add(String key, String val)
 {
-  iMap[key] = val;
+  const char *k = knownKey(key.data(), key.size());
+  if (!k) {
+    iOwnKeys.push_back(key);
+    k = iOwnKeys.back().z();
+  }
+  int i = 0;
+  while (i < int(iEntries.size()) && strcmp(iEntries[i].iKey, k) < 0)
+    ++i;
+  if (i < int(iEntries.size()) && !strcmp(iEntries[i].iKey, k)) {
+    iEntries[i].iValue = val;
+    return;
+  }
+  Entry e;
+  e.iKey = k;
+  e.iValue = val;
+  iEntries.insert(iEntries.begin() + i, e);
 }
 
 //! Check whether attribute exists, set \c val if so.
-bool XmlAttributes::has(String str, String &val) const
+bool XmlAttributes::has(const char *key, String &val) const
 {
-  std::map<String, String>::const_iterator it = iMap.find(str);
-  if (it != iMap.end()) {
-    val = it->second;
-    return true;
-  }
-  return false;
+  int i = find(key);
+  if (i < 0)
+    return false;
+  val = iEntries[i].iValue;
+  return true;
+}
+
+//! Check whether attribute exists, set \c val if so.
+bool XmlAttributes::has(String key, String &val) const
+{
+  return has(key.z(), val);
 }
 
 //! Check whether attribute exists.
-bool XmlAttributes::has(String str) const
+bool XmlAttributes::has(const char *key) const
 {
-  return (iMap.find(str) != iMap.end());
+  return (find(key) >= 0);
+}
+
+//! Check whether attribute exists.
+bool XmlAttributes::has(String key) const
+{
+  return (find(key.z()) >= 0);
 }
 
 // --------------------------------------------------------------------
@@ -101,14 +191,53 @@ bool XmlAttributes::has(String str) const
  Tag names and attribute names must consist of ASCII letters only.
  Only entities for '&', '<', and '>' are recognized.
 
+ The parser can also read "binary XML", a compact precompiled form of
+ an XML stream created by compile().  It is recognized automatically
+ by its first bytes.  Tags, attributes, and PCDATA are then read
+ directly, without scanning characters or decoding entities, and
+ derived classes work unchanged.  Comments and the \<!DOCTYPE\> tag
+ are not preserved in binary XML.
+
+ Binary XML consists of the 8-byte header "\033IPEXML1", followed by
+ records.  Numbers are stored in 7-bit groups, least significant
+ first, with the high bit set on all but the last byte.  A name is
+ stored as a number \e k.  If \e k is zero, the name is new, and its
+ length and its bytes follow.  Otherwise, it is the name that was
+ introduced as the <em>k</em>th new name.  The records are:
+
+ - 'S', name, number of attributes \e n, \e n times (key name, length,
+   value bytes), and a byte that is 1 if the tag ended with a slash:
+   an opening tag.
+ - 'E', name: a closing tag (the name includes the slash).
+ - 'T', length, bytes: PCDATA of the element just opened.
+
+ The PCDATA of a \c path element is stored in a binary form with the
+ numbers already parsed.  It starts with a zero byte, and is
+ understood by Shape::load.
 */
 
+static const char binaryMagic[] = "\033IPEXML1";
+
 //! Construct with a data source.
+/*! The parser reads the source in blocks, using
+  DataSource::getBlock(), so it may read ahead of the current parse
+  position. */
 XmlParser::XmlParser(DataSource &source)
-  : iSource(source)
+  : iSource(source), iBuffer(0x2000)
 {
   iPos = 0;
+  iP = iFin = 0;
+  iBinary = false;
+  iPendingAttributes = false;
   getChar(); // init iCh
+  if (iCh == binaryMagic[0]) {
+    int i = 0;
+    while (i < 8 && iCh == uchar(binaryMagic[i])) {
+      getChar();
+      ++i;
+    }
+    iBinary = (i == 8);
+  }
 }
 
 //! Virtual destructor, so one can destroy through pointer.
@@ -117,10 +246,71 @@ XmlParser::~XmlParser()
   // nothing
 }
 
+//! Get the next block of data from the source.
+/*! Returns false if the source is exhausted. */
+bool XmlParser::fillBuffer()
+{
+  int n = iSource.getBlock(iP, iBuffer.data(), iBuffer.size());
+  if (n <= 0) {
+    iP = iFin = 0;
+    return false;
+  }
+  iFin = iP + n;
+  return true;
+}
+
+// The current character iCh is always the character at iP[-1] (unless
+// we are at the end of the input).  The functions below use this to
+// process runs of characters inside the current block at once.
+
+//! Make the character at \a q the current character.
+/*! \a q must lie between the current character and the end of the
+  current block.  If \a q is the end of the block, the next block is
+  read. */
+void XmlParser::skipTo(const char *q)
+{
+  iPos += (q - iP);
+  iP = q;
+  getChar();
+}
+
 void XmlParser::skipWhitespace()
 {
-  while (iCh <= ' ' && !eos())
-    getChar();
+  while (iCh <= ' ' && !eos()) {
+    const char *q = iP;
+    while (q < iFin && uchar(*q) <= ' ')
+      ++q;
+    skipTo(q);
+  }
+}
+
+//! Append characters to \a s until the character \a stop.
+/*! Starts with the current character, and stops at the end of the
+  input or when \a stop is the current character.  Uses memchr to
+  find \a stop in large blocks. */
+void XmlParser::takeUntil(String &s, char stop)
+{
+  while (!eos() && iCh != stop) {
+    const char *p = iP - 1;
+    const char *q = (const char *) memchr(p, stop, iFin - p);
+    if (!q)
+      q = iFin;
+    s.append(p, q - p);
+    skipTo(q);
+  }
+}
+
+//! Append characters to \a s as long as they are tag characters.
+void XmlParser::takeTagChars(String &s)
+{
+  while (isTagChar(iCh)) {
+    const char *p = iP - 1;
+    const char *q = iP;
+    while (q < iFin && isTagChar(uchar(*q)))
+      ++q;
+    s.append(p, q - p);
+    skipTo(q);
+  }
 }
 
 //! Parse whitespace and the name of a tag.
@@ -132,43 +322,44 @@ void XmlParser::skipWhitespace()
 
 String XmlParser::parseToTagX()
 {
-  bool comment_found;
-  do {
-    skipWhitespace();
-    if (iCh != '<')
-      return String();
+  skipWhitespace();
+  if (iCh != '<')
+    return String();
+  getChar();
+  return parseTagName();
+}
+
+//! Parse the name of a tag, starting just after the \<.
+/*! Like parseToTagX, this skips comments and <!TAG .. >. */
+String XmlParser::parseTagName()
+{
+  // <!DOCTYPE ... >
+  // <!-- comment -->
+  if (iCh == '!') {
     getChar();
-    // <!DOCTYPE ... >
-    // <!-- comment -->
-    comment_found = (iCh == '!');
-    if (comment_found) {
-      getChar();
-      if (iCh == '-') {
-	int last[2] = { ' ', ' ' };
-	while (!eos() && (iCh != '>' || last[0] != '-' || last[1] != '-')) {
-	  last[0] = last[1];
-	  last[1] = iCh;
-	  getChar();
-	}
-      } else {
-	// skip to end of tag
-	while (!eos() && iCh != '>')
-	  getChar();
+    if (iCh == '-') {
+      int last[2] = { ' ', ' ' };
+      while (!eos() && (iCh != '>' || last[0] != '-' || last[1] != '-')) {
+	last[0] = last[1];
+	last[1] = iCh;
+	getChar();
       }
-      getChar();
-      if (eos())
-	return String();
+    } else {
+      // skip to end of tag
+      while (!eos() && iCh != '>')
+	getChar();
     }
-  } while (comment_found);
-  String tagname;
-  if (iCh == '?' || iCh == '/') {
-    tagname += char(iCh);
     getChar();
+    if (eos())
+      return String();
+    return parseToTagX();
   }
-  while (isTagChar(iCh)) {
+  String tagname;
+  if (iCh == '?' || iCh == '/') {
     tagname += char(iCh);
     getChar();
   }
+  takeTagChars(tagname);
   if (tagname[0] == '/') {
     skipWhitespace();
     if (iCh != '>')
@@ -184,6 +375,8 @@ String XmlParser::parseToTagX()
   starts with "x-" */
 String XmlParser::parseToTag()
 {
+  if (iBinary)
+    return binaryToTag();
   for (;;) {
     String s = parseToTagX();
     if (s.size() < 3 ||
@@ -200,6 +393,8 @@ String XmlParser::parseToTag()
 
 static String fromXml(String source)
 {
+  if (!memchr(source.data(), '&', source.size()))
+    return source;
   String s;
   for (int i = 0; i < source.size(); ) {
     if (source[i] == '&') {
@@ -238,15 +433,15 @@ static String fromXml(String source)
 */
 bool XmlParser::parseAttributes(XmlAttributes &attr, bool qm)
 {
+  if (iBinary)
+    return binaryAttributes(attr);
   // looking at char after tagname
   attr.clear();
   skipWhitespace();
+  String attname;
   while (iCh != '>' && iCh != '/' && iCh != '?') {
-    String attname;
-    while (isTagChar(iCh)) {
-      attname += char(iCh);
-      getChar();
-    }
+    attname.erase();
+    takeTagChars(attname);
     // XML allows whitespace before and after the '='
     skipWhitespace();
     if (attname.empty() || iCh != '=')
@@ -259,10 +454,7 @@ bool XmlParser::parseAttributes(XmlAttributes &attr, bool qm)
       return false;
     getChar();
     String val;
-    while (!eos() && iCh != quote) {
-      val += char(iCh);
-      getChar();
-    }
+    takeUntil(val, char(quote));
     if (iCh != quote)
       return false;
     getChar();
@@ -287,37 +479,346 @@ bool XmlParser::parseAttributes(XmlAttributes &attr, bool qm)
   with stream past the \>. */
 bool XmlParser::parsePCDATA(String tag, String &pcdata)
 {
+  if (iBinary)
+    return binaryPCDATA(tag, pcdata);
   String s;
-  bool haveEntity = false;
+  takeUntil(s, '<');
+  if (eos())
+    return false;
+  getChar();
+  if (iCh != '/')
+    return false;
+  getChar();
+  for (int i = 0; i < tag.size(); i++) {
+    if (iCh != tag[i])
+      return false;
+    getChar();
+  }
+  skipWhitespace();
+  if (iCh != '>')
+    return false;
+  getChar();
+  pcdata = fromXml(s);
+  return true;
+}
+
+//! Copy the text of an element without parsing it.
+/*! On calling, stream must be just past the name \a tag.  Sets \a
+  text to the raw XML text of the element, from the \c \<tag to the
+  matching \c \</tag\>, and returns with stream past the \>.  The
+  element must not contain another element with the same name.
+
+  Returns false at the end of input, and for binary XML. */
+bool XmlParser::takeElement(String tag, String &text)
+{
+  if (iBinary)
+    return false;
+  text.erase();
+  text += '<';
+  text += tag;
+  String name;
   for (;;) {
+    takeUntil(text, '<');
     if (eos())
       return false;
-    if (iCh == '<') {
-      getChar();
-      if (iCh != '/')
-	return false;
+    text += '<';
+    getChar();
+    if (iCh == '/') {
+      text += '/';
       getChar();
-      for (int i = 0; i < tag.size(); i++) {
-	if (iCh != tag[i])
+      name.erase();
+      takeTagChars(name);
+      text += name;
+      if (name == tag) {
+	skipWhitespace();
+	if (iCh != '>')
 	  return false;
+	text += '>';
 	getChar();
+	return true;
       }
-      skipWhitespace();
-      if (iCh != '>')
-	return false;
+    }
+  }
+}
+
+// --------------------------------------------------------------------
+
+//! Read a number from binary XML.
+/*! Returns -1 if the number is longer than five bytes or does not fit
+  into an int. */
+int XmlParser::getNumber()
+{
+  uint val = 0;
+  int shift = 0;
+  while (!eos() && (iCh & 0x80)) {
+    if (shift > 21)
+      return -1;
+    val |= uint(iCh & 0x7f) << shift;
+    shift += 7;
+    getChar();
+  }
+  if (shift == 28 && (iCh & 0x78))
+    return -1;
+  val |= uint(iCh & 0x7f) << shift;
+  getChar();
+  return int(val);
+}
+
+//! Read \a n bytes from binary XML.
+String XmlParser::getBytes(int n)
+{
+  String s;
+  if (n <= 0 || eos())
+    return s;
+  s.append(char(iCh));
+  --n;
+  while (n > 0 && (iP < iFin || fillBuffer())) {
+    int k = std::min(n, int(iFin - iP));
+    s.append(iP, k);
+    iP += k;
+    iPos += k;
+    n -= k;
+  }
+  getChar();
+  return s;
+}
+
+//! Read a name from binary XML.
+String XmlParser::getName()
+{
+  int k = getNumber();
+  if (k == 0) {
+    iNames.push_back(getBytes(getNumber()));
+    return iNames.back();
+  }
+  if (k < 0 || k > int(iNames.size()))
+    return String();
+  return iNames[k - 1];
+}
+
+//! Binary XML version of parseToTag.
+String XmlParser::binaryToTag()
+{
+  XmlAttributes attr;
+  for (;;) {
+    if (iPendingAttributes)
+      binaryAttributes(attr);
+    int rec = iCh;
+    getChar();
+    if (rec == 'S') {
+      String s = getName();
+      iPendingAttributes = true;
+      if (s.size() < 3 || s[0] != 'x' || s[1] != '-')
+	return s;
+    } else if (rec == 'E') {
+      String s = getName();
+      if (s.size() < 3 || s[1] != 'x' || s[2] != '-')
+	return s;
+    } else if (rec == 'T') {
+      // PCDATA where a tag is expected: skip it
+      getBytes(getNumber());
+    } else
+      return String();
+  }
+}
+
+//! Binary XML version of parseAttributes.
+bool XmlParser::binaryAttributes(XmlAttributes &attr)
+{
+  attr.clear();
+  if (!iPendingAttributes)
+    return false;
+  iPendingAttributes = false;
+  int n = getNumber();
+  for (int i = 0; i < n && !eos(); ++i) {
+    String key = getName();
+    String val = getBytes(getNumber());
+    attr.add(key, val);
+  }
+  if (eos())
+    return false;
+  if (iCh == 1)
+    attr.setSlash();
+  getChar();
+  return true;
+}
+
+//! Binary XML version of parsePCDATA.
+bool XmlParser::binaryPCDATA(String tag, String &pcdata)
+{
+  pcdata = String();
+  if (iCh == 'T') {
+    getChar();
+    pcdata = getBytes(getNumber());
+  }
+  if (iCh != 'E')
+    return false;
+  getChar();
+  String s = getName();
+  return (s.size() == tag.size() + 1 && s[0] == '/' &&
+	  s.substr(1) == tag);
+}
+
+// --------------------------------------------------------------------
+
+static void putNumber(Stream &stream, int val)
+{
+  while (val >= 0x80) {
+    stream.putChar(char(0x80 | (val & 0x7f)));
+    val >>= 7;
+  }
+  stream.putChar(char(val));
+}
+
+static void putBytes(Stream &stream, String s)
+{
+  putNumber(stream, s.size());
+  stream.putRaw(s.data(), s.size());
+}
+
+static void putName(Stream &stream, std::map<String, int> &names, String s)
+{
+  std::map<String, int>::const_iterator it = names.find(s);
+  if (it != names.end()) {
+    putNumber(stream, it->second);
+  } else {
+    int k = names.size() + 1;
+    names[s] = k;
+    putNumber(stream, 0);
+    putBytes(stream, s);
+  }
+}
+
+// Encode the contents of a <path> element in the binary form
+// understood by Shape::load, so that numbers need not be parsed when
+// reading it.  Returns false if the data contains anything but
+// operators and numbers.
+static bool encodePath(String data, String &out)
+{
+  static const double pow10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9 };
+  out = String();
+  out.append('\0');
+  Lex lex(data);
+  lex.skipWhitespace();
+  while (!lex.eos()) {
+    Lex::Token tok = lex.nextTokenView();
+    lex.skipWhitespace();
+    if (tok.iSize == 1 && strchr("hmlqcaseu", tok.iData[0])) {
+      out.append(tok.iData[0]);
+      continue;
+    }
+    double v;
+    if (Lex::parseDouble(tok.iData, tok.iData + tok.iSize, v)
+	!= tok.iData + tok.iSize)
+      return false;
+    // find decimal representation that gives exactly the same double
+    int k = 0;
+    long long m = 0;
+    while (k < 10) {
+      double w = v * pow10[k];
+      if (!(w < 1e15 && w > -1e15)) {  // also catches NaN
+	k = 10;
+	break;
+      }
+      m = (long long) (w < 0 ? w - 0.5 : w + 0.5);
+      double d = double(m) / pow10[k];
+      if (memcmp(&d, &v, sizeof(double)) == 0)
+	break;
+      ++k;
+    }
+    if (k < 10) {
+      out.append(char(1));
+      out.append(char(k));
+      unsigned long long z = (m < 0) ? ((~(unsigned long long) m) << 1) | 1
+	: ((unsigned long long) m << 1);
+      while (z >= 0x80) {
+	out.append(char(0x80 | (z & 0x7f)));
+	z >>= 7;
+      }
+      out.append(char(z));
+    } else {
+      unsigned long long bits;
+      memcpy(&bits, &v, sizeof(double));
+      out.append(char(2));
+      for (int i = 0; i < 8; ++i) {
+	out.append(char(bits & 0xff));
+	bits >>= 8;
+      }
+    }
+  }
+  return true;
+}
+
+//! Convert the XML input to binary XML.
+/*! Reads the entire remaining input and writes it to \a stream in
+  binary XML format.  Returns false if the input is not well-formed
+  XML in the sense of this parser.
+
+  An element whose contents is not another element is taken to
+  contain PCDATA.  Whitespace between elements is dropped.  The
+  contents of \c path elements is stored with the numbers already
+  parsed (see Shape::load).
+*/
+bool XmlParser::compile(Stream &stream)
+{
+  if (iBinary)
+    return false;
+  stream.putRaw(binaryMagic, 8);
+  std::map<String, int> names;
+  String tag = parseToTagX();
+  while (!tag.empty()) {
+    if (tag[0] == '/') {
+      stream.putChar('E');
+      putName(stream, names, tag);
+      tag = parseToTagX();
+      continue;
+    }
+    XmlAttributes attr;
+    if (!parseAttributes(attr, tag[0] == '?'))
+      return false;
+    stream.putChar('S');
+    putName(stream, names, tag);
+    putNumber(stream, attr.count());
+    for (int i = 0; i < attr.count(); ++i) {
+      putName(stream, names, attr.key(i));
+      putBytes(stream, attr.value(i));
+    }
+    stream.putChar(attr.slash() ? 1 : 0);
+    if (attr.slash()) {
+      tag = parseToTagX();
+      continue;
+    }
+    // does the element contain PCDATA or elements?
+    String ws;
+    while (!eos() && iCh <= ' ') {
+      ws += char(iCh);
       getChar();
-      if (haveEntity)
-	pcdata = fromXml(s);
+    }
+    String end = String("/") + tag;
+    if (iCh != '<') {
+      String pcdata;
+      if (!parsePCDATA(tag, pcdata))
+	return false;
+      String path;
+      stream.putChar('T');
+      if (tag == "path" && encodePath(pcdata, path))
+	putBytes(stream, path);
       else
-	pcdata = s;
-      return true;
-    } else {
-      if (iCh == '&')
-	haveEntity = true;
-      s += char(iCh);
+	putBytes(stream, ws + pcdata);
+      stream.putChar('E');
+      putName(stream, names, end);
+      tag = parseToTagX();
+      continue;
     }
     getChar();
+    tag = parseTagName();
+    if (tag == end) {
+      stream.putChar('T');
+      putBytes(stream, ws);
+    }
   }
+  return eos();
 }
 
 // --------------------------------------------------------------------
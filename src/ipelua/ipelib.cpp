@@ -39,7 +39,7 @@ using namespace ipelua;
 // --------------------------------------------------------------------
 
 static const char * const format_name[] =
-  { "xml", "pdf", "eps", "ipe5", "unknown" };
+  { "xml", "pdf", "eps", "ipe5", "ipeb", "unknown" };
 
 void ipelua::make_metatable(lua_State *L, const char *name,
 			    const struct luaL_Reg *methods)
@@ -193,7 +193,8 @@ static int document_pages(lua_State *L)
   return 3;
 }
 
-// "export", "nozip", "markedview", "nocolor"
+// "export", "nozip", "markedview", "nocolor", "append", "layerforms",
+// and the compression level "compress"
 static uint check_flags(lua_State *L, int index)
 {
   if (lua_isnoneornil(L, index))
@@ -216,6 +217,22 @@ static uint check_flags(lua_State *L, int index)
   if (lua_toboolean(L, -1))
     flags |= Document::ENoColor;
   lua_pop(L, 1);
+  lua_getfield(L, index, "append");
+  if (lua_toboolean(L, -1))
+    flags |= Document::EAppend;
+  lua_pop(L, 1);
+  lua_getfield(L, index, "layerforms");
+  if (lua_toboolean(L, -1))
+    flags |= Document::ELayerForms;
+  lua_pop(L, 1);
+  lua_getfield(L, index, "compress");
+  if (lua_isnumber(L, -1)) {
+    int level = lua_tointeger(L, -1);
+    luaL_argcheck(L, 1 <= level && level <= 12, index,
+		  "compression level must be between 1 and 12");
+    flags |= level * Document::ECompress;
+  }
+  lua_pop(L, 1);
   return flags;
 }
 
@@ -229,7 +246,15 @@ static int document_save(lua_State *L)
   else
     format = luaL_checkoption(L, 3, 0, format_name);
   uint flags = check_flags(L, 4);
-  bool result = (*d)->save(fname.z(), Document::TFormat(format), flags);
+  double garbage = 0.5;
+  if (flags & Document::EAppend) {
+    lua_getfield(L, 4, "garbage");
+    if (lua_isnumber(L, -1))
+      garbage = lua_tonumber(L, -1);
+    lua_pop(L, 1);
+  }
+  bool result = (*d)->save(fname.z(), Document::TFormat(format), flags,
+			   garbage);
   lua_pushboolean(L, result);
   return 1;
 }
@@ -47,7 +47,7 @@ void ipelua::push_page(lua_State *L, Page *page, bool owned)
   p->page = page;
 }
 
-static int check_objno(lua_State *L, int i, Page *p, int extra = 0)
+static int check_objno(lua_State *L, int i, const Page *p, int extra = 0)
 {
   int n = luaL_checkint(L, i);
   luaL_argcheck(L, 1 <= n && n <= p->count() + extra,
@@ -100,12 +100,13 @@ static int page_destructor(lua_State *L)
   return 0;
 }
 
+// Objects modified in place require a call to page:invalidateBBox().
 static int page_index(lua_State *L)
 {
-  Page *p = check_page(L, 1)->page;
+  const Page *p = check_page(L, 1)->page;
   if (lua_type(L, 2) == LUA_TNUMBER) {
     int n = check_objno(L, 2, p);
-    push_object(L, p->object(n), false);
+    push_object(L, const_cast<Object *>(p->object(n)), false);
   } else {
     const char *key = luaL_checkstring(L, 2);
     if (!luaL_getmetafield(L, 1, key))
@@ -162,12 +163,12 @@ static TSelect check_select(lua_State *L, int index)
 // arguments: page, counter
 static int page_object_iterator(lua_State *L)
 {
-  Page *p = check_page(L, 1)->page;
+  const Page *p = check_page(L, 1)->page;
   int i = luaL_checkint(L, 2);
   i = i + 1;
   if (i <= p->count()) {
     lua_pushnumber(L, i);                            // new counter
-    push_object(L, p->object(i-1), false);           // object
+    push_object(L, const_cast<Object *>(p->object(i-1)), false); // object
     push_select(L, p->select(i-1));
     push_string(L, p->layer(p->layerOf(i-1)));       // layer
     return 4;
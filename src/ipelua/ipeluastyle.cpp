@@ -72,19 +72,18 @@ int ipelua::sheet_constructor(lua_State *L)
 {
   if (lua_type(L, 1) == LUA_TSTRING) {
     String fname = check_filename(L, 1);
-    FILE *fd = fopen(fname.z(), "rb");
-    if (!fd) {
+    int errorPos;
+    errno = 0;
+    StyleSheet *sheet = StyleSheet::load(fname, errorPos);
+    if (!sheet && errorPos < 0) {
       lua_pushnil(L);
-      lua_pushfstring(L, "fopen error: %s", strerror(errno));
+      lua_pushfstring(L, "cannot read file '%s': %s", fname.z(),
+		      errno ? strerror(errno) : "unknown error");
       return 2;
     }
-    FileSource source(fd);
-    ImlParser parser(source);
-    StyleSheet *sheet = parser.parseStyleSheet();
-    fclose(fd);
     if (!sheet) {
       lua_pushnil(L);
-      lua_pushfstring(L, "Parsing error at %d", parser.parsePosition());
+      lua_pushfstring(L, "Parsing error at %d", errorPos);
       return 2;
     }
     push_sheet(L, sheet);
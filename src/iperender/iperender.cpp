@@ -50,6 +50,8 @@ enum TargetFormat { ESVG, EPNG, EPS, EPDF };
 
 using ipe::Document;
 using ipe::Page;
+using ipe::String;
+using ipe::StyleSheet;
 
 // --------------------------------------------------------------------
 
@@ -130,13 +132,30 @@ static void render(TargetFormat fm, const char *dst, const Document *doc,
 
 static int renderPage(TargetFormat fm, const char *src, const char *dst,
 		      int pageNum, int viewNum, double zoom,
-		      bool transparent, bool nocrop)
+		      bool transparent, bool nocrop,
+		      const std::vector<String> &sheets)
 {
-  Document *doc = Document::loadWithErrorReport(src);
+  // only the page to be rendered needs to be parsed
+  Document *doc = Document::loadWithErrorReport(src, Document::ELoadLazy);
 
   if (!doc)
     return 1;
 
+  for (unsigned int k = 0; k < sheets.size(); ++k) {
+    int errorPos;
+    StyleSheet *sheet = StyleSheet::load(sheets[k], errorPos);
+    if (!sheet) {
+      if (errorPos >= 0)
+	fprintf(stderr, "Style sheet %s has an error at position %d.\n",
+		sheets[k].z(), errorPos);
+      else
+	fprintf(stderr, "Cannot read style sheet %s.\n", sheets[k].z());
+      delete doc;
+      return 1;
+    }
+    doc->cascade()->insert(0, sheet);
+  }
+
   if (pageNum < 1 || pageNum > doc->countPages()) {
     fprintf(stderr,
 	    "The document contains %d pages, cannot convert page %d.\n",
@@ -145,7 +164,7 @@ static int renderPage(TargetFormat fm, const char *src, const char *dst,
     return 1;
   }
 
-  if (doc->runLatex()) {
+  if (doc->runLatex(pageNum - 1, pageNum - 1)) {
     delete doc;
     return 1;
   }
@@ -163,13 +182,14 @@ static void usage()
   fprintf(stderr,
 	  "Usage: iperender [ -svg | -png ] "
 	  "[ -page <page> ] [ -view <view> ] [ -resolution <dpi> ] "
-	  "infile outfile\n"
+	  "[ -sheet <file> ] infile outfile\n"
 	  "Iperender saves a single page of the Ipe document in some formats.\n"
 	  " -page       : page to save (default 1).\n"
 	  " -view       : view to save (default 1).\n"
 	  " -resolution : resolution for png format (default 72.0 ppi).\n"
 	  " -transparent: use transparent background in png format.\n"
 	  " -nocrop     : do not crop page.\n"
+	  " -sheet      : add style sheet on top of the document's.\n"
 	  );
   exit(1);
 }
@@ -230,6 +250,12 @@ int main(int argc, char *argv[])
     ++i;
   }
 
+  std::vector<String> sheets;
+  while (i + 1 < argc && !strcmp(argv[i], "-sheet")) {
+    sheets.push_back(argv[i+1]);
+    i += 2;
+  }
+
   // remaining arguments must be two filenames
   if (argc != i + 2)
     usage();
@@ -238,7 +264,7 @@ int main(int argc, char *argv[])
   const char *dst = argv[i+1];
 
   return renderPage(fm, src, dst, page, view, dpi / 72.0,
-		    transparent, nocrop);
+		    transparent, nocrop, sheets);
 }
 
 // --------------------------------------------------------------------
@@ -33,11 +33,22 @@
 
 using ipe::Document;
 using ipe::String;
+using ipe::StyleSheet;
 
 static int topdforps(Document *doc, String src, String dst,
 		     Document::TFormat fm, uint flags,
 		     int fromPage = -1, int toPage = -1, int viewNo = -1)
 {
+  // only the pages that are exported need to be processed by Latex
+  int firstPage = 0;
+  int lastPage = -1;
+  if (viewNo >= 0)
+    firstPage = lastPage = fromPage;
+  else if (toPage >= 0) {
+    firstPage = fromPage;
+    lastPage = toPage;
+  }
+
   if (fm == Document::EEps) {
     if (viewNo < 0 && doc->countTotalViews() > 1) {
       fprintf(stderr, "The document contains %d views, "
@@ -49,7 +60,7 @@ static int topdforps(Document *doc, String src, String dst,
     bool grad = doc->hasGradients();
 
     if (!trans && !grad) {
-      int res = doc->runLatex();
+      int res = doc->runLatex(firstPage, lastPage);
       if (res)
 	return res;
     }
@@ -71,7 +82,7 @@ static int topdforps(Document *doc, String src, String dst,
       return 1;
     }
   } else {
-    int res = doc->runLatex();
+    int res = doc->runLatex(firstPage, lastPage);
     if (res) return res;
   }
 
@@ -97,9 +108,11 @@ static int topdforps(Document *doc, String src, String dst,
 static void usage()
 {
   fprintf(stderr,
-	  "Usage: ipetoipe ( -xml | -eps | -pdf ) <options> "
+	  "Usage: ipetoipe ( -xml | -eps | -pdf | -ipeb ) <options> "
 	  "infile [ outfile ]\n"
 	  "Ipetoipe converts between the different Ipe file formats.\n"
+	  "The binary -ipeb format is only meant for caches, not for "
+	  "interchange.\n"
 	  " -export      : output contains no Ipe markup.\n"
 	  " -pages <n-m> : export only these pages (implies -export).\n"
 	  " -view <p-v>  : export only this view (implies -export).\n"
@@ -108,6 +121,11 @@ static void usage()
 	  " -runlatex    : run Latex even for XML output.\n"
 	  " -nocolor     : avoid any color commands in EPS output.\n"
 	  " -nozip:      : do not compress PDF streams.\n"
+	  " -compress <n>: compression level from 1 (fastest) "
+	  "to 12 (smallest).\n"
+	  " -layerforms  : paint layers shared by several views only once.\n"
+	  " -threads <n> : number of threads creating PDF pages.\n"
+	  " -sheet <file>: add style sheet on top of the document's.\n"
 	  );
   exit(1);
 }
@@ -127,6 +145,8 @@ int main(int argc, char *argv[])
     frm = Document::EEps;
   else if (!strcmp(argv[1], "-pdf"))
     frm = Document::EPdf;
+  else if (!strcmp(argv[1], "-ipeb"))
+    frm = Document::EBinary;
 
   if (frm == Document::EUnknown)
     usage();
@@ -140,6 +160,7 @@ int main(int argc, char *argv[])
 
   String infile;
   String outfile;
+  std::vector<String> sheets;
 
   while (i < argc) {
 
@@ -169,6 +190,28 @@ int main(int argc, char *argv[])
     } else if (!strcmp(argv[i], "-nozip")) {
       flags |= Document::ENoZip;
       ++i;
+    } else if (!strcmp(argv[i], "-compress")) {
+      int n;
+      if (i + 1 >= argc || sscanf(argv[i+1], "%d", &n) != 1
+	  || n < 1 || n > 12)
+	usage();
+      flags |= n * Document::ECompress;
+      i += 2;
+    } else if (!strcmp(argv[i], "-layerforms")) {
+      flags |= Document::ELayerForms;
+      ++i;
+    } else if (!strcmp(argv[i], "-threads")) {
+      int n;
+      if (i + 1 >= argc || sscanf(argv[i+1], "%d", &n) != 1
+	  || n < 1 || n > 255)
+	usage();
+      flags |= n * Document::EThreads;
+      i += 2;
+    } else if (!strcmp(argv[i], "-sheet")) {
+      if (i + 1 >= argc)
+	usage();
+      sheets.push_back(argv[i+1]);
+      i += 2;
     } else {
       // last one or two arguments must be filenames
       infile = argv[i];
@@ -185,7 +228,8 @@ int main(int argc, char *argv[])
   if (infile.empty())
     usage();
 
-  if ((flags & Document::EExport) && frm == Document::EXml) {
+  if ((flags & Document::EExport) &&
+      (frm == Document::EXml || frm == Document::EBinary)) {
     fprintf(stderr, "-export only available with -pdf and -eps.\n");
     exit(1);
   }
@@ -205,6 +249,8 @@ int main(int argc, char *argv[])
     String ext = infile.right(4);
     if (ext == ".ipe" || ext == ".pdf" || ext == ".xml" || ext == ".eps")
       outfile = infile.left(infile.size() - 4);
+    else if (infile.right(5) == ".ipeb")
+      outfile = infile.left(infile.size() - 5);
     switch (frm) {
     case Document::EXml:
       outfile += ".ipe";
@@ -214,6 +260,9 @@ int main(int argc, char *argv[])
       break;
     case Document::EEps:
       outfile += ".eps";
+      break;
+    case Document::EBinary:
+      outfile += ".ipeb";
     default:
       break;
     }
@@ -223,13 +272,36 @@ int main(int argc, char *argv[])
     }
   }
 
-  IpeAutoPtr<Document> doc(Document::loadWithErrorReport(infile.z()));
+  // when exporting some pages only, parse only those pages
+  bool lazy = (fromPage >= 0);
+  IpeAutoPtr<Document>
+    doc(Document::loadWithErrorReport(infile.z(), lazy ?
+				      Document::ELoadLazy :
+				      Document::ELoadNormal));
 
   if (!doc.ptr())
     return 1;
 
-  fprintf(stderr, "Document %s has %d pages (%d views)\n",
-	  infile.z(), doc->countPages(), doc->countTotalViews());
+  for (uint k = 0; k < sheets.size(); ++k) {
+    int errorPos;
+    StyleSheet *sheet = StyleSheet::load(sheets[k], errorPos);
+    if (!sheet) {
+      if (errorPos >= 0)
+	fprintf(stderr, "Style sheet %s has an error at position %d.\n",
+		sheets[k].z(), errorPos);
+      else
+	fprintf(stderr, "Cannot read style sheet %s.\n", sheets[k].z());
+      return 1;
+    }
+    doc->cascade()->insert(0, sheet);
+  }
+
+  if (lazy)
+    fprintf(stderr, "Document %s has %d pages\n",
+	    infile.z(), doc->countPages());
+  else
+    fprintf(stderr, "Document %s has %d pages (%d views)\n",
+	    infile.z(), doc->countPages(), doc->countTotalViews());
 
   // check frompage, topage, viewno
   if (toPage >= 0) {
@@ -267,6 +339,13 @@ int main(int argc, char *argv[])
   default:
     return 0;
 
+  case Document::EBinary:
+    if (!doc->save(outfile.z(), Document::EBinary, Document::ESaveNormal)) {
+      fprintf(stderr, "Failed to save document!\n");
+      return 1;
+    }
+    return 0;
+
   case Document::EPdf:
     return topdforps(doc.ptr(), infile, outfile, Document::EPdf,
 		     flags, fromPage, toPage, viewNo);